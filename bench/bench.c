@@ -0,0 +1,425 @@
+#include "db.h"
+#include "db_config.h"
+#include "generic-row.h"
+#include "paged-model.h"
+#include "result-model.h"
+#include "result_sort.h"
+
+#include <gio/gio.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+
+/* Headless benchmark of the fetch and materialization path. Builds
+ * synthetic tables in the configured database, then times each stage of
+ * getting them into a model and reading every cell back the way the grid
+ * does. Prints one JSON object per stage so runs can be diffed. */
+
+#define BENCH_TABLE_PREFIX "pgbrowsr_bench_"
+
+/* Counts allocation calls by interposing the glibc allocator */
+#ifdef __GLIBC__
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t n, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static guint64 alloc_count;
+static guint64 alloc_bytes;
+
+void *
+malloc (size_t size)
+{
+  __atomic_add_fetch (&alloc_count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&alloc_bytes, size, __ATOMIC_RELAXED);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  __atomic_add_fetch (&alloc_count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&alloc_bytes, n * size, __ATOMIC_RELAXED);
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  __atomic_add_fetch (&alloc_count, 1, __ATOMIC_RELAXED);
+  __atomic_add_fetch (&alloc_bytes, size, __ATOMIC_RELAXED);
+  return __libc_realloc (ptr, size);
+}
+#endif
+
+typedef struct
+{
+  const char *name;
+  const char *columns;
+  guint max_rows;
+} Shape;
+
+typedef struct
+{
+  const char *table;
+  guint rows;
+  gint64 start;
+  guint64 allocs;
+  guint64 bytes;
+} Stage;
+
+typedef struct
+{
+  GMainLoop *loop;
+  GAsyncResult *result;
+  gint64 first_rows;
+} Wait;
+
+static const Shape shapes[] = {
+  { "narrow", "g AS id, 'name ' || g AS name", G_MAXUINT },
+  { "wide",
+    "g AS id, g * 2 AS i1, g * 3 AS i2, g * 5 AS i3, g * 7 AS i4, "
+    "g / 3.0 AS n1, g / 7.0 AS n2, (g / 11.0)::float8 AS f1, (g / 13.0)::float4 AS f2, "
+    "'text ' || g AS t1, md5 (g::text) AS t2, 'row ' || g || ' of the wide table' AS t3, "
+    "g % 2 = 0 AS b1, date '2000-01-01' + g % 10000 AS d1, "
+    "timestamp '2000-01-01' + g * interval '1 second' AS ts1, "
+    "timestamptz '2000-01-01 00:00+00' + g * interval '1 minute' AS tz1",
+    G_MAXUINT },
+  /* About 1 KiB per row, so it stops short of the largest size */
+  { "long", "g AS id, repeat (md5 (g::text), 32) AS body", 1000000 },
+};
+
+static const guint row_counts[] = { 1000, 100000, 1000000, 10000000 };
+
+static gint max_rows = 1000000;
+static gboolean cleanup = FALSE;
+static gboolean binary = FALSE;
+
+static GOptionEntry options[] = {
+  { "max-rows", 'n', 0, G_OPTION_ARG_INT, &max_rows, "Largest table to benchmark", "ROWS" },
+  { "cleanup", 0, 0, G_OPTION_ARG_NONE, &cleanup, "Drop the benchmark tables afterwards", NULL },
+  { NULL }
+};
+
+/* Peak RSS since the last reset, in KiB. Writing 5 to clear_refs resets
+ * the high water mark on Linux; elsewhere it is the process peak. */
+static void
+reset_peak_rss (void)
+{
+  FILE *f = fopen ("/proc/self/clear_refs", "w");
+
+  if (!f)
+    return;
+
+  fputs ("5", f);
+  fclose (f);
+}
+
+static long
+read_peak_rss (void)
+{
+  FILE *f = fopen ("/proc/self/status", "r");
+  char line[256];
+  long kb = -1;
+
+  if (f)
+    {
+      while (fgets (line, sizeof (line), f))
+        if (sscanf (line, "VmHWM: %ld kB", &kb) == 1)
+          break;
+
+      fclose (f);
+    }
+
+  if (kb < 0)
+    {
+      struct rusage usage;
+
+      getrusage (RUSAGE_SELF, &usage);
+      kb = usage.ru_maxrss;
+    }
+
+  return kb;
+}
+
+static void
+stage_begin (Stage *stage, const char *table, guint rows)
+{
+  stage->table = table;
+  stage->rows = rows;
+
+  reset_peak_rss ();
+
+#ifdef __GLIBC__
+  stage->allocs = __atomic_load_n (&alloc_count, __ATOMIC_RELAXED);
+  stage->bytes = __atomic_load_n (&alloc_bytes, __ATOMIC_RELAXED);
+#endif
+
+  stage->start = g_get_monotonic_time ();
+}
+
+static void
+stage_end (Stage *stage, const char *name, int columns, gint64 end)
+{
+  if (end == 0)
+    end = g_get_monotonic_time ();
+
+  guint64 allocs = 0;
+  guint64 bytes = 0;
+
+#ifdef __GLIBC__
+  allocs = __atomic_load_n (&alloc_count, __ATOMIC_RELAXED) - stage->allocs;
+  bytes = __atomic_load_n (&alloc_bytes, __ATOMIC_RELAXED) - stage->bytes;
+#endif
+
+  printf ("{\"table\": \"%s\", \"rows\": %u, \"columns\": %d, \"binary\": %s, "
+          "\"stage\": \"%s\", \"ms\": %.3f, \"allocs\": %" G_GUINT64_FORMAT ", "
+          "\"alloc_bytes\": %" G_GUINT64_FORMAT ", \"peak_rss_kb\": %ld}\n",
+          stage->table, stage->rows, columns, binary ? "true" : "false", name,
+          (end - stage->start) / 1000.0, allocs, bytes, read_peak_rss ());
+  fflush (stdout);
+}
+
+static void
+on_done (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  Wait *wait = user_data;
+
+  wait->result = g_object_ref (result);
+  g_main_loop_quit (wait->loop);
+}
+
+static GAsyncResult *
+wait_run (Wait *wait)
+{
+  g_main_loop_run (wait->loop);
+
+  return wait->result;
+}
+
+static void
+on_first_rows (GListModel *list, guint position, guint removed, guint added, gpointer user_data)
+{
+  (void) list;
+  (void) position;
+  (void) removed;
+
+  Wait *wait = user_data;
+
+  if (added > 0 && wait->first_rows == 0)
+    wait->first_rows = g_get_monotonic_time ();
+}
+
+static gboolean
+ensure_table (PGconn *pg, const Shape *shape, guint rows, const char *table)
+{
+  char *sql = g_strdup_printf ("CREATE TABLE IF NOT EXISTS %s AS "
+                               "SELECT %s FROM generate_series (1, %u) g; "
+                               "ANALYZE %s",
+                               table, shape->columns, rows, table);
+  PGresult *res = PQexec (pg, sql);
+  gboolean ok = PQresultStatus (res) == PGRES_COMMAND_OK;
+
+  if (!ok)
+    g_printerr ("Creating %s failed: %s", table, PQresultErrorMessage (res));
+
+  PQclear (res);
+  g_free (sql);
+
+  return ok;
+}
+
+static void
+drop_table (PGconn *pg, const char *table)
+{
+  char *sql = g_strdup_printf ("DROP TABLE IF EXISTS %s", table);
+
+  PQclear (PQexec (pg, sql));
+  g_free (sql);
+}
+
+/* The grid formats every visible cell through generic_row_get_value, so
+ * reading each cell once is the cost of scrolling through the result */
+static void
+read_all_cells (GListModel *list)
+{
+  guint n = g_list_model_get_n_items (list);
+  gsize total = 0;
+
+  for (guint i = 0; i < n; i++)
+    {
+      GenericRow *row = g_list_model_get_item (list, i);
+      int columns = generic_row_get_n_columns (row);
+
+      for (int c = 0; c < columns; c++)
+        total += strlen (generic_row_get_value (row, c));
+
+      g_object_unref (row);
+    }
+
+  /* Keep the loop from being optimized away */
+  if (total == 0 && n > 0)
+    g_printerr ("No cell data read\n");
+}
+
+static void
+bench_query (const char *table, guint rows)
+{
+  Wait wait = { g_main_loop_new (NULL, FALSE), NULL, 0 };
+  Stage stage;
+
+  char *sql = g_strdup_printf ("SELECT * FROM %s", table);
+  ResultModel *model = result_model_new ();
+  GError *error = NULL;
+
+  g_signal_connect (model, "items-changed", G_CALLBACK (on_first_rows), &wait);
+
+  stage_begin (&stage, table, rows);
+  db_run_query_async (sql, model, TRUE, NULL, on_done, &wait);
+
+  if (!db_run_query_finish (wait_run (&wait), NULL, &error))
+    {
+      g_printerr ("Query on %s failed: %s\n", table, error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      int columns = result_model_get_n_columns (model);
+
+      stage_end (&stage, "query_first_rows", columns, wait.first_rows);
+      stage_end (&stage, "query", columns, 0);
+
+      stage_begin (&stage, table, rows);
+      read_all_cells (G_LIST_MODEL (model));
+      stage_end (&stage, "query_read_cells", columns, 0);
+
+      /* Descending on the second column, so every row moves; it holds text
+       * in the narrow and long shapes */
+      guint n_sorted = 0;
+
+      g_clear_object (&wait.result);
+      stage_begin (&stage, table, rows);
+      result_sort_async (result_model_get_result_set (model), MIN (columns - 1, 1), TRUE, NULL,
+                         on_done, &wait);
+      result_model_set_order (model, result_sort_finish (wait_run (&wait), &n_sorted, NULL),
+                              n_sorted);
+      stage_end (&stage, "query_sort", columns, 0);
+    }
+
+  stage_begin (&stage, table, rows);
+  g_object_unref (model);
+  stage_end (&stage, "query_free", 0, 0);
+
+  g_clear_object (&wait.result);
+  g_main_loop_unref (wait.loop);
+  g_free (sql);
+}
+
+static void
+bench_browse (const char *table, guint rows)
+{
+  Wait wait = { g_main_loop_new (NULL, FALSE), NULL, 0 };
+  Stage stage;
+
+  GError *error = NULL;
+
+  /* The browse cursor selects the columns the catalog lists */
+  db_fetch_catalog_async (NULL, on_done, &wait);
+
+  Catalog *catalog = db_fetch_catalog_finish (wait_run (&wait), &error);
+  char *full_name = g_strconcat ("public.", table, NULL);
+  const CatalogTable *info = catalog ? catalog_lookup (catalog, full_name) : NULL;
+
+  g_free (full_name);
+
+  g_clear_object (&wait.result);
+
+  if (!info)
+    {
+      g_printerr ("Browsing %s failed: %s\n", table, error ? error->message : "not in catalog");
+      g_clear_error (&error);
+      catalog_free (catalog);
+      g_main_loop_unref (wait.loop);
+      return;
+    }
+
+  PagedModel *model = paged_model_new ();
+
+  stage_begin (&stage, table, rows);
+  paged_model_open_async (model, info, NULL, NULL, FALSE, TRUE, NULL, on_done, &wait);
+
+  if (!paged_model_open_finish (model, wait_run (&wait), &error))
+    {
+      g_printerr ("Browsing %s failed: %s\n", table, error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      const char *const *names = paged_model_get_column_names (model);
+
+      stage_end (&stage, "browse_open", g_strv_length ((char **) names), 0);
+    }
+
+  paged_model_close (model);
+  g_object_unref (model);
+  catalog_free (catalog);
+
+  g_clear_object (&wait.result);
+  g_main_loop_unref (wait.loop);
+}
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context = g_option_context_new ("- benchmark the data path");
+  GError *error = NULL;
+  DbConfig config = { 0 };
+
+  g_option_context_add_main_entries (context, options, NULL);
+
+  if (!g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  g_option_context_free (context);
+
+  if (!load_db_config ("config.yaml", &config) || !db_connect ())
+    return 1;
+
+  binary = config.binary_results;
+
+  /* Table setup runs on a connection of its own, outside the pool */
+  PGconn *setup = db_connect_from_config (&config);
+
+  for (guint s = 0; s < G_N_ELEMENTS (shapes); s++)
+    {
+      for (guint r = 0; r < G_N_ELEMENTS (row_counts); r++)
+        {
+          guint rows = row_counts[r];
+
+          if (rows > (guint) max_rows || rows > shapes[s].max_rows)
+            continue;
+
+          char *table = g_strdup_printf (BENCH_TABLE_PREFIX "%s_%u", shapes[s].name, rows);
+
+          if (ensure_table (setup, &shapes[s], rows, table))
+            {
+              bench_query (table, rows);
+              bench_browse (table, rows);
+            }
+
+          if (cleanup)
+            drop_table (setup, table);
+
+          g_free (table);
+        }
+    }
+
+  PQfinish (setup);
+  db_disconnect ();
+
+  return 0;
+}
\ No newline at end of file
@@ -0,0 +1,441 @@
+#include "catalog.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CACHE_MAGIC "PGBCAT03"
+
+/* Cache file layout, native byte order: a header, the table and column
+ * records, then a blob of NUL terminated strings the records point into
+ * by offset. Loading maps the file and uses the strings in place. */
+typedef struct
+{
+  char magic[8];
+  guint32 n_tables;
+  guint32 n_columns;
+  guint32 strings_len;
+  char fingerprint[36];
+} CacheHeader;
+
+typedef struct
+{
+  guint32 oid;
+  guint32 schema;
+  guint32 name;
+  guint32 full_name;
+  guint32 first_column;
+  guint32 n_columns;
+  guint32 kind;
+} CacheTable;
+
+typedef struct
+{
+  guint32 name;
+  guint32 type;
+  guint32 not_null;
+} CacheColumn;
+
+struct _Catalog
+{
+  /* Strings live in the chunk when fetched, in the mapping when loaded */
+  GStringChunk *strings;
+  GMappedFile *file;
+  char *fingerprint;
+
+  GArray *tables;
+  GArray *columns;
+
+  GHashTable *by_name;
+  GHashTable *by_oid;
+};
+
+/* Every schema but the system ones, whose names pg_ is reserved for */
+#define USER_SCHEMA(n) n ".nspname <> 'information_schema' AND " n ".nspname !~ '^pg_'"
+
+/* One row per column, ordered so each table's columns are contiguous.
+ * Tables without columns still get a row with a NULL attname. */
+const char *
+catalog_query (void)
+{
+  return "SELECT c.oid, c.relname, a.attname, "
+         "format_type (a.atttypid, a.atttypmod), a.attnotnull, c.relkind, n.nspname "
+         "FROM pg_catalog.pg_class c "
+         "JOIN pg_catalog.pg_namespace n ON n.oid = c.relnamespace "
+         "LEFT JOIN pg_catalog.pg_attribute a "
+         "ON a.attrelid = c.oid AND a.attnum > 0 AND NOT a.attisdropped "
+         "WHERE " USER_SCHEMA ("n") " AND c.relkind IN ('r', 'p', 'v', 'm', 'f') "
+         "ORDER BY n.nspname, c.relname, a.attnum";
+}
+
+/* Changes whenever a table in the schema is created, altered or dropped,
+ * or one of its columns changes. Much cheaper than the catalog itself. */
+const char *
+catalog_fingerprint_query (void)
+{
+  return "SELECT md5 (string_agg (c.oid::text || ':' || c.xmin::text, ',' ORDER BY c.oid) "
+         "|| (SELECT count(*) || ':' || coalesce (sum (a.xmin::text::bigint), 0) "
+         "FROM pg_catalog.pg_attribute a "
+         "JOIN pg_catalog.pg_class ac ON ac.oid = a.attrelid "
+         "JOIN pg_catalog.pg_namespace an ON an.oid = ac.relnamespace "
+         "WHERE " USER_SCHEMA ("an") ")) "
+         "FROM pg_catalog.pg_class c "
+         "JOIN pg_catalog.pg_namespace n ON n.oid = c.relnamespace "
+         "WHERE " USER_SCHEMA ("n");
+}
+
+/* Figures for every table with storage, from what the server already
+ * tracks, so nothing is ever counted. Not part of the cached catalog: they
+ * change with every write. */
+const char *
+catalog_stats_query (void)
+{
+  return "SELECT c.oid, CASE WHEN c.reltuples < 0 THEN -1 ELSE c.reltuples::bigint END, "
+         "coalesce (pg_total_relation_size (c.oid), 0), "
+         "coalesce (extract (epoch FROM greatest (s.last_vacuum, s.last_autovacuum))::bigint, 0), "
+         "coalesce (extract (epoch FROM greatest (s.last_analyze, s.last_autoanalyze))::bigint, 0) "
+         "FROM pg_catalog.pg_class c "
+         "JOIN pg_catalog.pg_namespace n ON n.oid = c.relnamespace "
+         "LEFT JOIN pg_catalog.pg_stat_user_tables s ON s.relid = c.oid "
+         "WHERE " USER_SCHEMA ("n") " AND c.relkind IN ('r', 'p', 'm')";
+}
+
+/* Maps each table's oid to its TableStats, taking ownership of res */
+GHashTable *
+catalog_stats_new (PGresult *res)
+{
+  GHashTable *stats = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+  int rows = PQntuples (res);
+
+  for (int i = 0; i < rows; i++)
+    {
+      TableStats *table = g_new (TableStats, 1);
+      Oid oid = strtoul (PQgetvalue (res, i, 0), NULL, 10);
+
+      table->estimated_rows = g_ascii_strtoll (PQgetvalue (res, i, 1), NULL, 10);
+      table->total_bytes = g_ascii_strtoll (PQgetvalue (res, i, 2), NULL, 10);
+      table->last_vacuum = g_ascii_strtoll (PQgetvalue (res, i, 3), NULL, 10);
+      table->last_analyze = g_ascii_strtoll (PQgetvalue (res, i, 4), NULL, 10);
+
+      g_hash_table_insert (stats, GUINT_TO_POINTER (oid), table);
+    }
+
+  PQclear (res);
+
+  return stats;
+}
+
+static Catalog *
+catalog_alloc (void)
+{
+  Catalog *catalog = g_new0 (Catalog, 1);
+
+  catalog->tables = g_array_new (FALSE, FALSE, sizeof (CatalogTable));
+  catalog->columns = g_array_new (FALSE, FALSE, sizeof (CatalogColumn));
+
+  return catalog;
+}
+
+/* Tables hold their first column index in the columns pointer until the
+ * column array stops growing */
+static void
+catalog_index (Catalog *catalog)
+{
+  catalog->by_name = g_hash_table_new (g_str_hash, g_str_equal);
+  catalog->by_oid = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (guint i = 0; i < catalog->tables->len; i++)
+    {
+      CatalogTable *table = &g_array_index (catalog->tables, CatalogTable, i);
+      guint first = GPOINTER_TO_UINT (table->columns);
+
+      table->columns = &g_array_index (catalog->columns, CatalogColumn, first);
+
+      g_hash_table_insert (catalog->by_name, (gpointer) table->full_name, table);
+      g_hash_table_insert (catalog->by_oid, GUINT_TO_POINTER (table->oid), table);
+    }
+}
+
+Catalog *
+catalog_new (PGresult *res)
+{
+  Catalog *catalog = catalog_alloc ();
+
+  catalog->strings = g_string_chunk_new (64 * 1024);
+
+  int rows = PQntuples (res);
+  Oid last = InvalidOid;
+
+  for (int i = 0; i < rows; i++)
+    {
+      Oid oid = strtoul (PQgetvalue (res, i, 0), NULL, 10);
+
+      if (oid != last)
+        {
+          CatalogTable table = { 0 };
+
+          char *full_name = g_strdup_printf ("%s.%s", PQgetvalue (res, i, 6),
+                                             PQgetvalue (res, i, 1));
+
+          table.oid = oid;
+          table.schema = g_string_chunk_insert_const (catalog->strings, PQgetvalue (res, i, 6));
+          table.name = g_string_chunk_insert (catalog->strings, PQgetvalue (res, i, 1));
+          table.full_name = g_string_chunk_insert (catalog->strings, full_name);
+          table.kind = PQgetvalue (res, i, 5)[0];
+          table.columns = GUINT_TO_POINTER (catalog->columns->len);
+
+          g_array_append_val (catalog->tables, table);
+          g_free (full_name);
+          last = oid;
+        }
+
+      if (PQgetisnull (res, i, 2))
+        continue;
+
+      CatalogColumn column;
+
+      column.name = g_string_chunk_insert (catalog->strings, PQgetvalue (res, i, 2));
+      column.type = g_string_chunk_insert_const (catalog->strings, PQgetvalue (res, i, 3));
+      column.not_null = PQgetvalue (res, i, 4)[0] == 't';
+
+      g_array_append_val (catalog->columns, column);
+      g_array_index (catalog->tables, CatalogTable, catalog->tables->len - 1).n_columns++;
+    }
+
+  PQclear (res);
+
+  catalog_index (catalog);
+
+  return catalog;
+}
+
+void
+catalog_free (Catalog *catalog)
+{
+  if (!catalog)
+    return;
+
+  g_hash_table_destroy (catalog->by_name);
+  g_hash_table_destroy (catalog->by_oid);
+  g_array_free (catalog->tables, TRUE);
+  g_array_free (catalog->columns, TRUE);
+  g_clear_pointer (&catalog->strings, g_string_chunk_free);
+  g_clear_pointer (&catalog->file, g_mapped_file_unref);
+  g_free (catalog->fingerprint);
+  g_free (catalog);
+}
+
+const char *
+catalog_get_fingerprint (Catalog *catalog)
+{
+  return catalog->fingerprint;
+}
+
+void
+catalog_set_fingerprint (Catalog *catalog, const char *fingerprint)
+{
+  g_free (catalog->fingerprint);
+  catalog->fingerprint = g_strdup (fingerprint);
+}
+
+static const char *
+cache_string (const char *strings, guint32 len, guint32 offset)
+{
+  return offset < len ? strings + offset : NULL;
+}
+
+/* Returns NULL if the file is missing, from another version or damaged */
+Catalog *
+catalog_load (const char *path)
+{
+  GMappedFile *file = g_mapped_file_new (path, FALSE, NULL);
+
+  if (!file)
+    return NULL;
+
+  const char *data = g_mapped_file_get_contents (file);
+  gsize size = g_mapped_file_get_length (file);
+  const CacheHeader *header = (const CacheHeader *) data;
+
+  if (size < sizeof (CacheHeader) || memcmp (header->magic, CACHE_MAGIC, 8) != 0)
+    {
+      g_mapped_file_unref (file);
+      return NULL;
+    }
+
+  gsize records = sizeof (CacheHeader) + (gsize) header->n_tables * sizeof (CacheTable)
+                  + (gsize) header->n_columns * sizeof (CacheColumn);
+
+  /* The blob must end in a NUL so no string can run off the mapping */
+  if (size != records + header->strings_len
+      || (header->strings_len > 0 && data[size - 1] != '\0'))
+    {
+      g_mapped_file_unref (file);
+      return NULL;
+    }
+
+  const CacheTable *tables = (const CacheTable *) (header + 1);
+  const CacheColumn *columns = (const CacheColumn *) (tables + header->n_tables);
+  const char *strings = data + records;
+  guint32 len = header->strings_len;
+
+  Catalog *catalog = catalog_alloc ();
+
+  catalog->file = file;
+  catalog->fingerprint = g_strndup (header->fingerprint, sizeof (header->fingerprint));
+
+  for (guint32 i = 0; i < header->n_columns; i++)
+    {
+      CatalogColumn column;
+
+      column.name = cache_string (strings, len, columns[i].name);
+      column.type = cache_string (strings, len, columns[i].type);
+      column.not_null = columns[i].not_null != 0;
+
+      if (!column.name || !column.type)
+        goto damaged;
+
+      g_array_append_val (catalog->columns, column);
+    }
+
+  for (guint32 i = 0; i < header->n_tables; i++)
+    {
+      CatalogTable table;
+
+      table.oid = tables[i].oid;
+      table.schema = cache_string (strings, len, tables[i].schema);
+      table.name = cache_string (strings, len, tables[i].name);
+      table.full_name = cache_string (strings, len, tables[i].full_name);
+      table.kind = (char) tables[i].kind;
+      table.n_columns = tables[i].n_columns;
+      table.columns = GUINT_TO_POINTER (tables[i].first_column);
+
+      if (!table.schema || !table.name || !table.full_name
+          || tables[i].first_column > header->n_columns
+          || table.n_columns > header->n_columns - tables[i].first_column)
+        goto damaged;
+
+      g_array_append_val (catalog->tables, table);
+    }
+
+  catalog_index (catalog);
+
+  return catalog;
+
+damaged:
+  catalog_free (catalog);
+  return NULL;
+}
+
+static guint32
+cache_add_string (GByteArray *strings, GHashTable *offsets, const char *str)
+{
+  gpointer offset;
+
+  /* Type names repeat a lot, store each once */
+  if (g_hash_table_lookup_extended (offsets, str, NULL, &offset))
+    return GPOINTER_TO_UINT (offset);
+
+  guint32 start = strings->len;
+
+  g_byte_array_append (strings, (const guint8 *) str, strlen (str) + 1);
+  g_hash_table_insert (offsets, (gpointer) str, GUINT_TO_POINTER (start));
+
+  return start;
+}
+
+/* Replaces the cache file atomically, so a mapping held by a running
+ * instance keeps seeing the old contents */
+gboolean
+catalog_save (Catalog *catalog, const char *path, GError **error)
+{
+  CacheHeader header = { 0 };
+  GByteArray *out = g_byte_array_new ();
+  GByteArray *strings = g_byte_array_new ();
+  GHashTable *offsets = g_hash_table_new (g_str_hash, g_str_equal);
+
+  memcpy (header.magic, CACHE_MAGIC, 8);
+  header.n_tables = catalog->tables->len;
+  header.n_columns = catalog->columns->len;
+
+  if (catalog->fingerprint)
+    strncpy (header.fingerprint, catalog->fingerprint, sizeof (header.fingerprint));
+
+  g_byte_array_append (out, (const guint8 *) &header, sizeof (header));
+
+  const CatalogColumn *first = (const CatalogColumn *) catalog->columns->data;
+
+  for (guint i = 0; i < catalog->tables->len; i++)
+    {
+      const CatalogTable *table = &g_array_index (catalog->tables, CatalogTable, i);
+      CacheTable record;
+
+      record.oid = table->oid;
+      record.schema = cache_add_string (strings, offsets, table->schema);
+      record.name = cache_add_string (strings, offsets, table->name);
+      record.full_name = cache_add_string (strings, offsets, table->full_name);
+      record.first_column = table->columns - first;
+      record.n_columns = table->n_columns;
+      record.kind = (guchar) table->kind;
+
+      g_byte_array_append (out, (const guint8 *) &record, sizeof (record));
+    }
+
+  for (guint i = 0; i < catalog->columns->len; i++)
+    {
+      const CatalogColumn *column = &g_array_index (catalog->columns, CatalogColumn, i);
+      CacheColumn record;
+
+      record.name = cache_add_string (strings, offsets, column->name);
+      record.type = cache_add_string (strings, offsets, column->type);
+      record.not_null = column->not_null;
+
+      g_byte_array_append (out, (const guint8 *) &record, sizeof (record));
+    }
+
+  ((CacheHeader *) out->data)->strings_len = strings->len;
+  g_byte_array_append (out, strings->data, strings->len);
+
+  char *dir = g_path_get_dirname (path);
+  gboolean ok = FALSE;
+
+  if (g_mkdir_with_parents (dir, 0700) != 0)
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno), "Cannot create %s: %s",
+                 dir, g_strerror (errno));
+  else
+    ok = g_file_set_contents (path, (const char *) out->data, out->len, error);
+
+  g_free (dir);
+  g_hash_table_destroy (offsets);
+  g_byte_array_unref (strings);
+  g_byte_array_unref (out);
+
+  return ok;
+}
+
+guint
+catalog_get_n_tables (Catalog *catalog)
+{
+  return catalog->tables->len;
+}
+
+const CatalogTable *
+catalog_get_table (Catalog *catalog, guint index)
+{
+  g_return_val_if_fail (index < catalog->tables->len, NULL);
+
+  return &g_array_index (catalog->tables, CatalogTable, index);
+}
+
+/* Looks a table up by its schema qualified name */
+const CatalogTable *
+catalog_lookup (Catalog *catalog, const char *full_name)
+{
+  return g_hash_table_lookup (catalog->by_name, full_name);
+}
+
+const CatalogTable *
+catalog_lookup_oid (Catalog *catalog, Oid oid)
+{
+  return g_hash_table_lookup (catalog->by_oid, GUINT_TO_POINTER (oid));
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <glib.h>
+#include <libpq-fe.h>
+
+typedef struct
+{
+  const char *name;
+  const char *type;
+  gboolean not_null;
+} CatalogColumn;
+
+typedef struct
+{
+  Oid oid;
+  const char *schema;
+  const char *name;
+  /* schema.name, which tables are shown and looked up by */
+  const char *full_name;
+  /* pg_class.relkind: 'r'elation, 'p'artitioned, 'v'iew, 'm'aterialized
+   * view or 'f'oreign table */
+  char kind;
+
+  guint n_columns;
+  const CatalogColumn *columns;
+} CatalogTable;
+
+/* Size and planner figures of one table */
+typedef struct
+{
+  /* reltuples, -1 when the table was never vacuumed or analyzed */
+  gint64 estimated_rows;
+  /* Including indexes and TOAST */
+  gint64 total_bytes;
+  /* Unix times of the last manual or automatic run, 0 for never */
+  gint64 last_vacuum;
+  gint64 last_analyze;
+} TableStats;
+
+/* Every table and its columns, loaded with one query so selecting a table
+ * never goes back to the server. Read-only once built. */
+typedef struct _Catalog Catalog;
+
+Catalog *catalog_new (PGresult *res);
+void catalog_free (Catalog *catalog);
+
+const char *catalog_query (void);
+const char *catalog_fingerprint_query (void);
+
+const char *catalog_stats_query (void);
+GHashTable *catalog_stats_new (PGresult *res);
+
+const char *catalog_get_fingerprint (Catalog *catalog);
+void catalog_set_fingerprint (Catalog *catalog, const char *fingerprint);
+
+Catalog *catalog_load (const char *path);
+gboolean catalog_save (Catalog *catalog, const char *path, GError **error);
+
+guint catalog_get_n_tables (Catalog *catalog);
+const CatalogTable *catalog_get_table (Catalog *catalog, guint index);
+
+const CatalogTable *catalog_lookup (Catalog *catalog, const char *full_name);
+const CatalogTable *catalog_lookup_oid (Catalog *catalog, Oid oid);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,825 @@
+#include "data-grid.h"
+#include "generic-row.h"
+
+#include <string.h>
+
+/* Grid view of a GListModel of GenericRow. Only the cells inside the
+ * visible rectangle are laid out and drawn, so a frame costs the same
+ * with a hundred rows and columns as with millions. Layouts of drawn
+ * cells are kept while they stay on screen. */
+
+#define CELL_PAD_X 8
+#define CELL_PAD_Y 3
+#define MIN_COLUMN_WIDTH 60
+#define MAX_COLUMN_WIDTH 320
+#define SAMPLE_ROWS 10
+
+/* Cached layouts beyond this many are dropped if not drawn last frame */
+#define MIN_CACHED_LAYOUTS 512
+
+typedef struct
+{
+  PangoLayout *layout;
+  guint frame;
+} CachedLayout;
+
+typedef struct
+{
+  char *name;
+  Oid type;
+
+  int width;
+  /* Width fits sampled rows, not just the header */
+  gboolean sized;
+
+  PangoLayout *header;
+} GridColumn;
+
+struct _DataGrid
+{
+  GtkWidget parent_instance;
+
+  GListModel *model;
+
+  GArray *columns;
+  int n_columns;
+
+  /* Left edge of every column, followed by the total width */
+  int *column_x;
+
+  int row_height;
+
+  GHashTable *layouts;
+  guint frame;
+
+  guint selected;
+
+  /* -1 when the rows are shown as the model has them */
+  int sort_column;
+  gboolean sort_descending;
+
+  GtkAdjustment *hadjustment;
+  GtkAdjustment *vadjustment;
+  GtkScrollablePolicy hscroll_policy;
+  GtkScrollablePolicy vscroll_policy;
+};
+
+enum
+{
+  PROP_0,
+  PROP_HADJUSTMENT,
+  PROP_VADJUSTMENT,
+  PROP_HSCROLL_POLICY,
+  PROP_VSCROLL_POLICY
+};
+
+enum
+{
+  SORT_CHANGED,
+  CELL_ACTIVATED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+G_DEFINE_TYPE_WITH_CODE (DataGrid,
+                         data_grid,
+                         GTK_TYPE_WIDGET,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_SCROLLABLE, NULL))
+
+static void
+cached_layout_free (gpointer data)
+{
+  CachedLayout *cached = data;
+
+  g_object_unref (cached->layout);
+  g_free (cached);
+}
+
+static void
+data_grid_clear_layouts (DataGrid *grid)
+{
+  g_hash_table_remove_all (grid->layouts);
+}
+
+static void
+grid_column_clear (gpointer data)
+{
+  GridColumn *column = data;
+
+  g_free (column->name);
+  g_clear_object (&column->header);
+}
+
+static GridColumn *
+data_grid_column (DataGrid *grid, int index)
+{
+  return &g_array_index (grid->columns, GridColumn, index);
+}
+
+static void
+data_grid_ensure_metrics (DataGrid *grid)
+{
+  if (grid->row_height > 0)
+    return;
+
+  PangoLayout *layout = gtk_widget_create_pango_layout (GTK_WIDGET (grid), "Ag");
+  int height;
+
+  pango_layout_get_pixel_size (layout, NULL, &height);
+  g_object_unref (layout);
+
+  grid->row_height = height + 2 * CELL_PAD_Y;
+}
+
+static int
+data_grid_text_width (PangoLayout *scratch, const char *text)
+{
+  int width;
+
+  pango_layout_set_text (scratch, text, -1);
+  pango_layout_get_pixel_size (scratch, &width, NULL);
+
+  return width + 2 * CELL_PAD_X;
+}
+
+static void
+data_grid_update_column_x (DataGrid *grid)
+{
+  g_free (grid->column_x);
+  grid->column_x = g_new0 (int, grid->n_columns + 1);
+
+  for (int c = 0; c < grid->n_columns; c++)
+    grid->column_x[c + 1] = grid->column_x[c] + data_grid_column (grid, c)->width;
+}
+
+/* Sizes columns that haven't seen any rows yet to fit their header and
+ * the first few rows. Columns kept from an earlier result keep their
+ * width. */
+static void
+data_grid_measure_columns (DataGrid *grid)
+{
+  guint n_items = grid->model ? g_list_model_get_n_items (grid->model) : 0;
+  guint samples = MIN (n_items, SAMPLE_ROWS);
+  GenericRow **rows = g_new0 (GenericRow *, samples + 1);
+  PangoLayout *scratch = gtk_widget_create_pango_layout (GTK_WIDGET (grid), NULL);
+  gboolean changed = FALSE;
+
+  pango_layout_set_single_paragraph_mode (scratch, TRUE);
+
+  for (guint r = 0; r < samples; r++)
+    rows[r] = g_list_model_get_item (grid->model, r);
+
+  for (int c = 0; c < grid->n_columns; c++)
+    {
+      GridColumn *column = data_grid_column (grid, c);
+
+      if (column->sized)
+        continue;
+
+      int width = data_grid_text_width (scratch, column->name);
+
+      for (guint r = 0; r < samples; r++)
+        if (rows[r])
+          width = MAX (width, data_grid_text_width (scratch, generic_row_get_value (rows[r], c)));
+
+      column->width = CLAMP (width, MIN_COLUMN_WIDTH, MAX_COLUMN_WIDTH);
+      column->sized = samples > 0;
+      g_clear_object (&column->header);
+
+      changed = TRUE;
+    }
+
+  for (guint r = 0; r < samples; r++)
+    g_clear_object (&rows[r]);
+
+  g_free (rows);
+  g_object_unref (scratch);
+
+  data_grid_update_column_x (grid);
+
+  /* Cell layouts are ellipsized to the old widths */
+  if (changed)
+    data_grid_clear_layouts (grid);
+}
+
+static gboolean
+data_grid_needs_sizing (DataGrid *grid)
+{
+  for (int c = 0; c < grid->n_columns; c++)
+    if (!data_grid_column (grid, c)->sized)
+      return TRUE;
+
+  return FALSE;
+}
+
+static int
+data_grid_total_width (DataGrid *grid)
+{
+  return grid->column_x ? grid->column_x[grid->n_columns] : 0;
+}
+
+/* Index of the column under content x, by binary search over the edges */
+static int
+data_grid_column_at (DataGrid *grid, double x)
+{
+  int lo = 0;
+  int hi = grid->n_columns - 1;
+
+  while (lo < hi)
+    {
+      int mid = (lo + hi + 1) / 2;
+
+      if (grid->column_x[mid] <= x)
+        lo = mid;
+      else
+        hi = mid - 1;
+    }
+
+  return lo;
+}
+
+static PangoLayout *
+data_grid_cell_layout (DataGrid *grid, GenericRow *row, guint index, int column)
+{
+  gint64 key = ((gint64) index << 32) | (guint32) column;
+  CachedLayout *cached = g_hash_table_lookup (grid->layouts, &key);
+
+  if (!cached)
+    {
+      int width = grid->column_x[column + 1] - grid->column_x[column] - 2 * CELL_PAD_X;
+
+      cached = g_new0 (CachedLayout, 1);
+      cached->layout = gtk_widget_create_pango_layout (GTK_WIDGET (grid),
+                                                       generic_row_get_value (row, column));
+
+      pango_layout_set_single_paragraph_mode (cached->layout, TRUE);
+      pango_layout_set_ellipsize (cached->layout, PANGO_ELLIPSIZE_END);
+      pango_layout_set_width (cached->layout, MAX (width, 1) * PANGO_SCALE);
+
+      g_hash_table_insert (grid->layouts, g_memdup2 (&key, sizeof (key)), cached);
+    }
+
+  cached->frame = grid->frame;
+
+  return cached->layout;
+}
+
+static PangoLayout *
+data_grid_header_layout (DataGrid *grid, int index)
+{
+  GridColumn *column = data_grid_column (grid, index);
+
+  if (!column->header)
+    {
+      int width = column->width - 2 * CELL_PAD_X;
+      const char *arrow = grid->sort_descending ? " \u25BC" : " \u25B2";
+      char *text = g_strconcat (column->name, index == grid->sort_column ? arrow : NULL, NULL);
+      PangoLayout *layout = gtk_widget_create_pango_layout (GTK_WIDGET (grid), text);
+      PangoAttrList *attrs = pango_attr_list_new ();
+
+      g_free (text);
+
+      pango_attr_list_insert (attrs, pango_attr_weight_new (PANGO_WEIGHT_BOLD));
+      pango_layout_set_attributes (layout, attrs);
+      pango_attr_list_unref (attrs);
+
+      pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+      pango_layout_set_width (layout, MAX (width, 1) * PANGO_SCALE);
+
+      column->header = layout;
+    }
+
+  return column->header;
+}
+
+static gboolean
+is_stale_layout (gpointer key, gpointer value, gpointer user_data)
+{
+  (void) key;
+
+  CachedLayout *cached = value;
+
+  return cached->frame != GPOINTER_TO_UINT (user_data);
+}
+
+void
+data_grid_get_visible_rows (DataGrid *grid, guint *first, guint *last)
+{
+  guint n_items = grid->model ? g_list_model_get_n_items (grid->model) : 0;
+  double top = gtk_adjustment_get_value (grid->vadjustment);
+  double page = gtk_adjustment_get_page_size (grid->vadjustment);
+
+  data_grid_ensure_metrics (grid);
+
+  *first = (guint) (top / grid->row_height);
+  *last = (guint) ((top + page) / grid->row_height);
+
+  if (n_items == 0)
+    *first = *last = 0;
+  else
+    *last = MIN (*last, n_items - 1);
+}
+
+static void
+data_grid_snapshot (GtkWidget *widget, GtkSnapshot *snapshot)
+{
+  DataGrid *grid = DATA_GRID (widget);
+  int width = gtk_widget_get_width (widget);
+  int height = gtk_widget_get_height (widget);
+
+  if (grid->n_columns == 0 || !grid->column_x)
+    return;
+
+  data_grid_ensure_metrics (grid);
+
+  int row_h = grid->row_height;
+  double x_off = gtk_adjustment_get_value (grid->hadjustment);
+  double y_off = gtk_adjustment_get_value (grid->vadjustment);
+  guint n_items = grid->model ? g_list_model_get_n_items (grid->model) : 0;
+
+  GdkRGBA fg;
+  gtk_widget_get_color (widget, &fg);
+
+  GdkRGBA line = fg;
+  line.alpha = 0.12;
+
+  GdkRGBA header_bg = fg;
+  header_bg.alpha = 0.06;
+
+  GdkRGBA selected_bg = { 0.21, 0.52, 0.89, 0.3 };
+
+  int first_col = data_grid_column_at (grid, x_off);
+  int last_col = data_grid_column_at (grid, x_off + width);
+  guint first_row = (guint) (y_off / row_h);
+  guint end_row = MIN (n_items, (guint) ((y_off + height) / row_h) + 1);
+
+  grid->frame++;
+
+  gtk_snapshot_push_clip (snapshot, &GRAPHENE_RECT_INIT (0, row_h, width, MAX (height - row_h, 0)));
+
+  for (guint r = first_row; r < end_row; r++)
+    {
+      GenericRow *row = g_list_model_get_item (grid->model, r);
+      double y = row_h + (double) r * row_h - y_off;
+
+      if (!row)
+        continue;
+
+      if (r == grid->selected)
+        gtk_snapshot_append_color (snapshot, &selected_bg,
+                                   &GRAPHENE_RECT_INIT (0, y, width, row_h));
+
+      for (int c = first_col; c <= last_col; c++)
+        {
+          PangoLayout *layout = data_grid_cell_layout (grid, row, r, c);
+
+          gtk_snapshot_save (snapshot);
+          gtk_snapshot_translate (snapshot,
+                                  &GRAPHENE_POINT_INIT (grid->column_x[c] - x_off + CELL_PAD_X,
+                                                        y + CELL_PAD_Y));
+          gtk_snapshot_append_layout (snapshot, layout, &fg);
+          gtk_snapshot_restore (snapshot);
+        }
+
+      g_object_unref (row);
+    }
+
+  gtk_snapshot_pop (snapshot);
+
+  gtk_snapshot_append_color (snapshot, &header_bg, &GRAPHENE_RECT_INIT (0, 0, width, row_h));
+  gtk_snapshot_append_color (snapshot, &line, &GRAPHENE_RECT_INIT (0, row_h - 1, width, 1));
+
+  for (int c = first_col; c <= last_col; c++)
+    {
+      double x = grid->column_x[c] - x_off;
+      double right = grid->column_x[c + 1] - x_off;
+
+      gtk_snapshot_save (snapshot);
+      gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (x + CELL_PAD_X, CELL_PAD_Y));
+      gtk_snapshot_append_layout (snapshot, data_grid_header_layout (grid, c), &fg);
+      gtk_snapshot_restore (snapshot);
+
+      gtk_snapshot_append_color (snapshot, &line, &GRAPHENE_RECT_INIT (right - 1, 0, 1, height));
+    }
+
+  /* Keep what is on screen, drop the rest once the cache grows */
+  guint visible = (end_row - first_row) * (last_col - first_col + 1);
+
+  if (g_hash_table_size (grid->layouts) > MAX (2 * visible, MIN_CACHED_LAYOUTS))
+    g_hash_table_foreach_remove (grid->layouts, is_stale_layout, GUINT_TO_POINTER (grid->frame));
+}
+
+static void
+data_grid_measure (GtkWidget *widget,
+                   GtkOrientation orientation,
+                   int for_size,
+                   int *minimum,
+                   int *natural,
+                   int *minimum_baseline,
+                   int *natural_baseline)
+{
+  (void) for_size;
+  (void) minimum_baseline;
+  (void) natural_baseline;
+
+  DataGrid *grid = DATA_GRID (widget);
+
+  data_grid_ensure_metrics (grid);
+
+  *minimum = 0;
+
+  if (orientation == GTK_ORIENTATION_HORIZONTAL)
+    *natural = data_grid_total_width (grid);
+  else
+    *natural = grid->row_height * 10;
+}
+
+static void
+data_grid_size_allocate (GtkWidget *widget, int width, int height, int baseline)
+{
+  (void) baseline;
+
+  DataGrid *grid = DATA_GRID (widget);
+  guint n_items = grid->model ? g_list_model_get_n_items (grid->model) : 0;
+
+  data_grid_ensure_metrics (grid);
+
+  double total_width = data_grid_total_width (grid);
+  double total_height = (double) grid->row_height * (n_items + 1);
+
+  gtk_adjustment_configure (grid->hadjustment,
+                            CLAMP (gtk_adjustment_get_value (grid->hadjustment), 0,
+                                   MAX (total_width - width, 0)),
+                            0, MAX (total_width, width), width * 0.1, width * 0.9, width);
+
+  gtk_adjustment_configure (grid->vadjustment,
+                            CLAMP (gtk_adjustment_get_value (grid->vadjustment), 0,
+                                   MAX (total_height - height, 0)),
+                            0, MAX (total_height, height), grid->row_height, height * 0.9, height);
+}
+
+/* Moves the indicator without telling anyone, the header layouts that
+ * show it are rebuilt */
+static void
+data_grid_update_sort (DataGrid *grid, int column, gboolean descending)
+{
+  if (grid->sort_column >= 0 && grid->sort_column < grid->n_columns)
+    g_clear_object (&data_grid_column (grid, grid->sort_column)->header);
+
+  grid->sort_column = column;
+  grid->sort_descending = descending;
+
+  if (column >= 0 && column < grid->n_columns)
+    g_clear_object (&data_grid_column (grid, column)->header);
+
+  gtk_widget_queue_draw (GTK_WIDGET (grid));
+}
+
+/* Clicking a header sorts ascending, then descending, then not at all */
+static void
+data_grid_header_clicked (DataGrid *grid, double x)
+{
+  double content_x = x + gtk_adjustment_get_value (grid->hadjustment);
+
+  if (grid->n_columns == 0 || content_x >= data_grid_total_width (grid))
+    return;
+
+  int column = data_grid_column_at (grid, content_x);
+
+  if (column != grid->sort_column)
+    data_grid_update_sort (grid, column, FALSE);
+  else if (!grid->sort_descending)
+    data_grid_update_sort (grid, column, TRUE);
+  else
+    data_grid_update_sort (grid, -1, FALSE);
+
+  g_signal_emit (grid, signals[SORT_CHANGED], 0);
+}
+
+/* A double click opens the cell under the pointer */
+static void
+on_pressed (GtkGestureClick *gesture, int n_press, double x, double y, gpointer user_data)
+{
+  (void) gesture;
+
+  DataGrid *grid = user_data;
+  guint n_items = grid->model ? g_list_model_get_n_items (grid->model) : 0;
+
+  if (y < grid->row_height)
+    {
+      data_grid_header_clicked (grid, x);
+      return;
+    }
+
+  double top = gtk_adjustment_get_value (grid->vadjustment);
+  guint row = (guint) ((y - grid->row_height + top) / grid->row_height);
+
+  grid->selected = row < n_items ? row : G_MAXUINT;
+
+  gtk_widget_queue_draw (GTK_WIDGET (grid));
+
+  double content_x = x + gtk_adjustment_get_value (grid->hadjustment);
+
+  if (n_press == 2 && grid->selected != G_MAXUINT && content_x < data_grid_total_width (grid))
+    g_signal_emit (grid, signals[CELL_ACTIVATED], 0, row, data_grid_column_at (grid, content_x));
+}
+
+static void
+on_items_changed (GListModel *model, guint position, guint removed, guint added, gpointer user_data)
+{
+  DataGrid *grid = user_data;
+  guint n_items = g_list_model_get_n_items (model);
+
+  /* Appending leaves every drawn row where it was */
+  if (removed > 0 || position + added != n_items)
+    data_grid_clear_layouts (grid);
+
+  if (removed > 0 && grid->selected != G_MAXUINT && grid->selected >= position)
+    grid->selected = G_MAXUINT;
+
+  if (n_items > 0 && data_grid_needs_sizing (grid))
+    data_grid_measure_columns (grid);
+
+  gtk_widget_queue_allocate (GTK_WIDGET (grid));
+  gtk_widget_queue_draw (GTK_WIDGET (grid));
+}
+
+static void
+data_grid_set_adjustment (DataGrid *grid, GtkAdjustment **slot, GtkAdjustment *adjustment)
+{
+  if (adjustment && *slot == adjustment)
+    return;
+
+  if (*slot)
+    {
+      g_signal_handlers_disconnect_by_data (*slot, grid);
+      g_object_unref (*slot);
+    }
+
+  if (!adjustment)
+    adjustment = gtk_adjustment_new (0, 0, 0, 0, 0, 0);
+
+  *slot = g_object_ref_sink (adjustment);
+
+  g_signal_connect_swapped (adjustment, "value-changed", G_CALLBACK (gtk_widget_queue_draw), grid);
+
+  gtk_widget_queue_allocate (GTK_WIDGET (grid));
+}
+
+static void
+data_grid_set_property (GObject *object, guint prop_id, const GValue *value, GParamSpec *pspec)
+{
+  DataGrid *grid = DATA_GRID (object);
+
+  switch (prop_id)
+    {
+    case PROP_HADJUSTMENT:
+      data_grid_set_adjustment (grid, &grid->hadjustment, g_value_get_object (value));
+      break;
+    case PROP_VADJUSTMENT:
+      data_grid_set_adjustment (grid, &grid->vadjustment, g_value_get_object (value));
+      break;
+    case PROP_HSCROLL_POLICY:
+      grid->hscroll_policy = g_value_get_enum (value);
+      break;
+    case PROP_VSCROLL_POLICY:
+      grid->vscroll_policy = g_value_get_enum (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+data_grid_get_property (GObject *object, guint prop_id, GValue *value, GParamSpec *pspec)
+{
+  DataGrid *grid = DATA_GRID (object);
+
+  switch (prop_id)
+    {
+    case PROP_HADJUSTMENT:
+      g_value_set_object (value, grid->hadjustment);
+      break;
+    case PROP_VADJUSTMENT:
+      g_value_set_object (value, grid->vadjustment);
+      break;
+    case PROP_HSCROLL_POLICY:
+      g_value_set_enum (value, grid->hscroll_policy);
+      break;
+    case PROP_VSCROLL_POLICY:
+      g_value_set_enum (value, grid->vscroll_policy);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+data_grid_dispose (GObject *object)
+{
+  DataGrid *grid = DATA_GRID (object);
+
+  if (grid->model)
+    g_signal_handlers_disconnect_by_data (grid->model, grid);
+
+  g_clear_object (&grid->model);
+  g_clear_pointer (&grid->layouts, g_hash_table_destroy);
+
+  if (grid->hadjustment)
+    g_signal_handlers_disconnect_by_data (grid->hadjustment, grid);
+
+  if (grid->vadjustment)
+    g_signal_handlers_disconnect_by_data (grid->vadjustment, grid);
+
+  g_clear_object (&grid->hadjustment);
+  g_clear_object (&grid->vadjustment);
+
+  G_OBJECT_CLASS (data_grid_parent_class)->dispose (object);
+}
+
+static void
+data_grid_finalize (GObject *object)
+{
+  DataGrid *grid = DATA_GRID (object);
+
+  g_array_unref (grid->columns);
+  g_free (grid->column_x);
+
+  G_OBJECT_CLASS (data_grid_parent_class)->finalize (object);
+}
+
+static void
+data_grid_class_init (DataGridClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  object_class->set_property = data_grid_set_property;
+  object_class->get_property = data_grid_get_property;
+  object_class->dispose = data_grid_dispose;
+  object_class->finalize = data_grid_finalize;
+
+  widget_class->snapshot = data_grid_snapshot;
+  widget_class->measure = data_grid_measure;
+  widget_class->size_allocate = data_grid_size_allocate;
+
+  g_object_class_override_property (object_class, PROP_HADJUSTMENT, "hadjustment");
+  g_object_class_override_property (object_class, PROP_VADJUSTMENT, "vadjustment");
+  g_object_class_override_property (object_class, PROP_HSCROLL_POLICY, "hscroll-policy");
+  g_object_class_override_property (object_class, PROP_VSCROLL_POLICY, "vscroll-policy");
+
+  signals[SORT_CHANGED] = g_signal_new ("sort-changed", G_TYPE_FROM_CLASS (klass),
+                                        G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                                        G_TYPE_NONE, 0);
+
+  signals[CELL_ACTIVATED] = g_signal_new ("cell-activated", G_TYPE_FROM_CLASS (klass),
+                                          G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                                          G_TYPE_NONE, 2, G_TYPE_UINT, G_TYPE_INT);
+}
+
+static void
+data_grid_init (DataGrid *self)
+{
+  self->layouts = g_hash_table_new_full (g_int64_hash, g_int64_equal, g_free, cached_layout_free);
+  self->columns = g_array_new (FALSE, TRUE, sizeof (GridColumn));
+  g_array_set_clear_func (self->columns, grid_column_clear);
+  self->selected = G_MAXUINT;
+  self->sort_column = -1;
+
+  data_grid_set_adjustment (self, &self->hadjustment, NULL);
+  data_grid_set_adjustment (self, &self->vadjustment, NULL);
+
+  GtkGesture *click = gtk_gesture_click_new ();
+
+  g_signal_connect (click, "pressed", G_CALLBACK (on_pressed), self);
+  gtk_widget_add_controller (GTK_WIDGET (self), GTK_EVENT_CONTROLLER (click));
+
+  gtk_widget_set_overflow (GTK_WIDGET (self), GTK_OVERFLOW_HIDDEN);
+  gtk_widget_set_focusable (GTK_WIDGET (self), TRUE);
+}
+
+GtkWidget *
+data_grid_new (void)
+{
+  return g_object_new (TYPE_DATA_GRID, NULL);
+}
+
+void
+data_grid_set_model (DataGrid *grid, GListModel *model)
+{
+  if (grid->model == model)
+    return;
+
+  if (grid->model)
+    {
+      g_signal_handlers_disconnect_by_data (grid->model, grid);
+      g_clear_object (&grid->model);
+    }
+
+  if (model)
+    {
+      grid->model = g_object_ref (model);
+      g_signal_connect (model, "items-changed", G_CALLBACK (on_items_changed), grid);
+    }
+
+  grid->selected = G_MAXUINT;
+  data_grid_clear_layouts (grid);
+
+  if (data_grid_needs_sizing (grid))
+    data_grid_measure_columns (grid);
+
+  gtk_adjustment_set_value (grid->vadjustment, 0);
+  gtk_widget_queue_allocate (GTK_WIDGET (grid));
+  gtk_widget_queue_draw (GTK_WIDGET (grid));
+}
+
+/* Replaces the columns, diffing them against the current ones: columns
+ * with the same name and type keep their width, so re-running a query
+ * with the same shape only swaps rows. names may be NULL to show nothing;
+ * types may be NULL when unknown. */
+void
+data_grid_set_columns (DataGrid *grid, const char *const *names, const Oid *types)
+{
+  int n = names ? g_strv_length ((char **) names) : 0;
+  gboolean same = n == grid->n_columns;
+
+  for (int c = 0; same && c < n; c++)
+    same = strcmp (names[c], data_grid_column (grid, c)->name) == 0
+           && data_grid_column (grid, c)->type == (types ? types[c] : InvalidOid);
+
+  if (same)
+    return;
+
+  GArray *columns = g_array_new (FALSE, TRUE, sizeof (GridColumn));
+  GHashTable *old = g_hash_table_new (g_str_hash, g_str_equal);
+  gboolean kept = FALSE;
+
+  g_array_set_clear_func (columns, grid_column_clear);
+
+  /* Later duplicates don't replace the first column of a name */
+  for (int c = grid->n_columns - 1; c >= 0; c--)
+    g_hash_table_insert (old, data_grid_column (grid, c)->name, data_grid_column (grid, c));
+
+  for (int c = 0; c < n; c++)
+    {
+      GridColumn column = { 0 };
+      GridColumn *match = g_hash_table_lookup (old, names[c]);
+      Oid type = types ? types[c] : InvalidOid;
+
+      if (match && match->type == type)
+        {
+          /* Take over the width, the name is reused. The header layout is
+           * rebuilt, as it may show a sort arrow the new columns lack. */
+          column = *match;
+          column.header = NULL;
+          match->name = NULL;
+          g_hash_table_remove (old, names[c]);
+          kept = TRUE;
+        }
+
+      if (!column.name)
+        {
+          column.name = g_strdup (names[c]);
+          column.type = type;
+        }
+
+      g_array_append_val (columns, column);
+    }
+
+  g_hash_table_destroy (old);
+
+  g_array_unref (grid->columns);
+  grid->columns = columns;
+  grid->n_columns = n;
+  grid->sort_column = -1;
+
+  data_grid_clear_layouts (grid);
+  data_grid_measure_columns (grid);
+
+  if (!kept)
+    gtk_adjustment_set_value (grid->hadjustment, 0);
+
+  gtk_widget_queue_allocate (GTK_WIDGET (grid));
+  gtk_widget_queue_draw (GTK_WIDGET (grid));
+}
+
+guint
+data_grid_get_selected (DataGrid *grid)
+{
+  return grid->selected;
+}
+
+/* column is -1 when the grid isn't sorted */
+void
+data_grid_get_sort (DataGrid *grid, int *column, gboolean *descending)
+{
+  *column = grid->sort_column;
+  *descending = grid->sort_descending;
+}
+
+void
+data_grid_set_sort (DataGrid *grid, int column, gboolean descending)
+{
+  data_grid_update_sort (grid, column, descending);
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef DATA_GRID_H
+#define DATA_GRID_H
+
+#include <gtk/gtk.h>
+#include <libpq-fe.h>
+
+#define TYPE_DATA_GRID (data_grid_get_type ())
+G_DECLARE_FINAL_TYPE (DataGrid, data_grid, DATA, GRID, GtkWidget)
+
+GtkWidget *data_grid_new (void);
+
+void data_grid_set_model (DataGrid *grid, GListModel *model);
+void data_grid_set_columns (DataGrid *grid, const char *const *names, const Oid *types);
+
+void data_grid_get_visible_rows (DataGrid *grid, guint *first, guint *last);
+guint data_grid_get_selected (DataGrid *grid);
+
+void data_grid_get_sort (DataGrid *grid, int *column, gboolean *descending);
+void data_grid_set_sort (DataGrid *grid, int column, gboolean descending);
+
+#endif
\ No newline at end of file
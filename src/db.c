@@ -1,145 +1,1008 @@
 #include "db.h"
 #include "db_config.h"
-#include "generic-row.h"
+#include "db_conn.h"
+#include "db_copy.h"
+#include "db_pool.h"
+#include "explain_plan.h"
 #include "gio/gio.h"
-#include "schema-row.h"
+#include "result-model.h"
+#include "result_cache.h"
+#include "sql_text.h"
 
-static PGconn *db_conn = NULL;
+#define BROWSE_CURSOR "pgbrowsr_browse"
+
+/* A ctid is only unique within one heap, so the row id also names the
+ * table the row is in: a partition or inheriting child when browsing its
+ * parent. Outside the cursor's snapshot a ctid may have been reused by
+ * another row, which the inserting transaction in xmin tells apart. */
+#define BROWSE_ROW_ID "tableoid::text || ' ' || ctid::text || ' ' || xmin::text"
+
+/* Every statement in the cursor's transaction shares the snapshot it was
+ * declared in, so values fetched by row id are those of the rows shown */
+#define BROWSE_BEGIN "BEGIN ISOLATION LEVEL REPEATABLE READ READ ONLY"
+
+/* Longest part of a wide value fetched for the grid */
+#define BROWSE_PREFIX_BYTES 256
+
+#define DEFAULT_CACHE_MB 64
+
+/* An open cursor holds a snapshot and a lock on the table, so it is
+ * closed once browsing pauses for this long */
+#define BROWSE_IDLE_SECONDS 30
+
+#define EXPLAIN_SAVEPOINT "pgbrowsr_explain"
+
+static DbConfig db_config;
+static DbPool *db_pool = NULL;
+
+/* Editor statements share one session, so BEGIN, SET and temporary
+ * tables carry over from one run to the next */
+static DbConn *editor_conn = NULL;
+
+/* Browsing keeps a cursor open inside a transaction, so it pins a pool
+ * connection instead of wrapping editor queries in that transaction */
+static DbConn *browse_conn = NULL;
+static gboolean browse_in_transaction = FALSE;
+/* Declares the cursor again when a fetch follows a close */
+static char *browse_declare = NULL;
+static guint browse_idle_id = 0;
+
+/* Editor results and first pages of browsed tables, keyed by the
+ * connection and the normalized statement */
+static ResultCache *result_cache = NULL;
 
 gboolean
 db_connect (void)
 {
-  DbConfig config;
-
-  if (!load_db_config ("config.yaml", &config))
+  if (!load_db_config ("config.yaml", &db_config))
     {
       return FALSE;
     }
 
-  db_conn = db_connect_from_config (&config);
-  if (db_conn == NULL)
+  db_pool = db_pool_new (&db_config);
+
+  /* The pool opens the interactive connection up front so a bad config
+   * shows at startup; the rest connect on first use */
+  PGconn *pg = db_conn_get_pg (db_pool_get (db_pool, DB_LANE_INTERACTIVE));
+  if (pg == NULL)
     {
+      g_clear_pointer (&db_pool, db_pool_free);
       return FALSE;
     }
 
+  int cache_mb = db_config.cache_size_mb < 0 ? DEFAULT_CACHE_MB : db_config.cache_size_mb;
+
+  result_cache = result_cache_new ((gsize) cache_mb * 1024 * 1024,
+                                   (gint64) db_config.cache_ttl * G_USEC_PER_SEC);
+
   return TRUE;
 }
 
 void
 db_disconnect (void)
 {
-  if (db_conn)
-    PQfinish (db_conn);
+  if (editor_conn)
+    db_pool_release (db_pool, editor_conn);
+
+  editor_conn = NULL;
+
+  if (browse_conn)
+    db_pool_release (db_pool, browse_conn);
+
+  browse_conn = NULL;
+  browse_in_transaction = FALSE;
+  g_clear_pointer (&browse_declare, g_free);
+
+  if (browse_idle_id)
+    g_source_remove (browse_idle_id);
+
+  browse_idle_id = 0;
+  g_clear_pointer (&db_pool, db_pool_free);
+  g_clear_pointer (&result_cache, result_cache_free);
+}
+
+/* Different servers, databases or users may see different rows for the
+ * same statement */
+static char *
+cache_key (const char *kind, const char *sql)
+{
+  char *normalized = sql_text_normalize (sql);
+  char *key = g_strdup_printf ("%s@%s:%s/%s\n%s\n%s", db_config.user, db_config.host,
+                               db_config.port, db_config.dbname, kind, normalized);
+
+  g_free (normalized);
+
+  return key;
+}
+
+/* Single plain reads, whose result can be served again. Anything else may
+ * write, so it empties the cache instead. A read followed by any other
+ * statement doesn't count, nor does SELECT ... FOR UPDATE or SHARE, which
+ * locks rows, or SELECT ... INTO, which creates a table. Neither do reads
+ * calling functions that act on the server, such as pg_cancel_backend,
+ * pg_advisory_lock or set_config, or whose result changes from one run to
+ * the next, such as now or random: serving those again would silently
+ * skip the call. Functions the user wrote can't be told apart by name. */
+static gboolean
+is_cacheable (const char *sql)
+{
+  static const char *const writes = "\\b(INSERT|UPDATE|DELETE|MERGE|INTO|SHARE|NEXTVAL|SETVAL)\\b";
+  static const char *const volatile_calls =
+      "\\b(pg_\\w+|set_config|txid_\\w+|lo_\\w+|random|setseed|gen_random_uuid|now"
+      "|clock_timestamp|statement_timestamp|transaction_timestamp|timeofday)\\s*\\("
+      "|\\b(current_date|current_time|current_timestamp|localtime|localtimestamp)\\b";
+
+  return sql_text_count_statements (sql) == 1
+         && g_regex_match_simple ("^\\s*(SELECT|WITH|VALUES|TABLE)\\b", sql, G_REGEX_CASELESS, 0)
+         && !g_regex_match_simple (writes, sql, G_REGEX_CASELESS, 0)
+         && !g_regex_match_simple (volatile_calls, sql, G_REGEX_CASELESS, 0);
+}
+
+/* Called after anything that may have changed rows */
+void
+db_clear_cache (void)
+{
+  if (result_cache)
+    result_cache_clear (result_cache);
+}
+
+static DbConn *
+db_editor_conn (void)
+{
+  if (!editor_conn)
+    editor_conn = db_pool_acquire (db_pool);
+
+  return editor_conn;
+}
+
+static DbConn *
+db_browse_conn (void)
+{
+  if (!browse_conn)
+    browse_conn = db_pool_acquire (db_pool);
+
+  return browse_conn;
+}
+
+static gboolean
+on_browse_idle (gpointer user_data)
+{
+  (void) user_data;
+
+  browse_idle_id = 0;
+  db_browse_close ();
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Restarts the countdown to closing the cursor */
+static void
+db_browse_touch (void)
+{
+  if (browse_idle_id)
+    g_source_remove (browse_idle_id);
+
+  browse_idle_id = g_timeout_add_seconds (BROWSE_IDLE_SECONDS, on_browse_idle, NULL);
+}
+
+static gpointer
+catalog_from_result (PGresult *res)
+{
+  return catalog_new (res);
+}
+
+/* Loads every table with its columns in one round trip, replacing the
+ * per-table information_schema lookups */
+void
+db_fetch_catalog_async (GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
+{
+  db_conn_exec_prepared_async (db_pool_get (db_pool, DB_LANE_INTERACTIVE), "pgbrowsr_catalog",
+                               catalog_query (), 0, NULL, catalog_from_result,
+                               (GDestroyNotify) catalog_free, cancellable, callback, user_data);
+}
+
+Catalog *
+db_fetch_catalog_finish (GAsyncResult *result, GError **error)
+{
+  return db_conn_exec_finish (result, error);
+}
+
+static gpointer
+fingerprint_from_result (PGresult *res)
+{
+  char *fingerprint = g_strdup (PQntuples (res) > 0 ? PQgetvalue (res, 0, 0) : "");
+
+  PQclear (res);
+  return fingerprint;
+}
+
+void
+db_fetch_catalog_fingerprint_async (GCancellable *cancellable,
+                                    GAsyncReadyCallback callback,
+                                    gpointer user_data)
+{
+  db_conn_exec_prepared_async (db_pool_get (db_pool, DB_LANE_INTERACTIVE),
+                               "pgbrowsr_catalog_fingerprint", catalog_fingerprint_query (), 0,
+                               NULL, fingerprint_from_result, g_free, cancellable, callback,
+                               user_data);
+}
+
+char *
+db_fetch_catalog_fingerprint_finish (GAsyncResult *result, GError **error)
+{
+  return db_conn_exec_finish (result, error);
+}
+
+static gpointer
+stats_from_result (PGresult *res)
+{
+  return catalog_stats_new (res);
 }
 
-GPtrArray *
-db_fetch_table_names (void)
+/* Runs on the background lane: sizing thousands of tables takes a while
+ * and shouldn't hold up browsing */
+void
+db_fetch_table_stats_async (GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data)
+{
+  db_conn_exec_prepared_async (db_pool_get (db_pool, DB_LANE_BACKGROUND), "pgbrowsr_table_stats",
+                               catalog_stats_query (), 0, NULL, stats_from_result,
+                               (GDestroyNotify) g_hash_table_unref, cancellable, callback,
+                               user_data);
+}
+
+GHashTable *
+db_fetch_table_stats_finish (GAsyncResult *result, GError **error)
+{
+  return db_conn_exec_finish (result, error);
+}
+
+/* One cache file per database, named by a hash so any host or database
+ * name makes a valid file name */
+char *
+db_catalog_cache_path (void)
 {
-  const char *query = "SELECT table_name "
-                      "FROM information_schema.tables "
-                      "WHERE table_schema = 'public'";
+  char *key = g_strdup_printf ("%s:%s/%s", db_config.host, db_config.port, db_config.dbname);
+  char *hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+  char *name = g_strconcat (hash, ".catalog", NULL);
+  char *path = g_build_filename (g_get_user_cache_dir (), "pgbrowsr", name, NULL);
 
-  PGresult *res = PQexec (db_conn, query);
+  g_free (name);
+  g_free (hash);
+  g_free (key);
 
-  if (PQresultStatus (res) != PGRES_TUPLES_OK)
+  return path;
+}
+
+static void
+append_rows (PGresult *batch, gpointer user_data)
+{
+  ResultModel *model = user_data;
+
+  if (batch)
+    result_model_append (model, batch);
+  else
+    result_model_reset (model);
+}
+
+typedef struct
+{
+  ResultModel *model;
+  /* Set for statements whose result may be cached */
+  char *key;
+  QueryStats stats;
+} RunQuery;
+
+static void
+run_query_free (gpointer data)
+{
+  RunQuery *run = data;
+
+  g_object_unref (run->model);
+  g_free (run->key);
+  g_free (run);
+}
+
+static void
+on_query_streamed (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  GTask *task = user_data;
+  RunQuery *run = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  gboolean ok = db_conn_stream_finish (result, &run->stats, &error);
+
+  /* A failed script may still have written before it failed */
+  if (!run->key)
+    db_clear_cache ();
+  else if (ok)
+    result_cache_insert (result_cache, run->key, result_model_get_result_set (run->model), -1);
+
+  if (ok)
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+
+  g_object_unref (task);
+}
+
+/* Streams rows into model as they arrive instead of waiting for the
+ * whole result. A read run before is shown from the cache instead, unless
+ * bypass_cache is set. */
+void
+db_run_query_async (const char *query,
+                    ResultModel *model,
+                    gboolean bypass_cache,
+                    GCancellable *cancellable,
+                    GAsyncReadyCallback callback,
+                    gpointer user_data)
+{
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+  RunQuery *run = g_new0 (RunQuery, 1);
+
+  run->model = g_object_ref (model);
+  run->key = is_cacheable (query) ? cache_key ("query", query) : NULL;
+  g_task_set_task_data (task, run, run_query_free);
+
+  ResultSet *cached = run->key && !bypass_cache
+                          ? result_cache_lookup (result_cache, run->key, NULL,
+                                                 &run->stats.cached_at)
+                          : NULL;
+
+  if (cached)
     {
-      g_printerr ("Table query failed: %s\n", PQerrorMessage (db_conn));
-      PQclear (res);
-      return NULL;
+      gint64 now = g_get_monotonic_time ();
+
+      result_model_set_result_set (model, cached);
+
+      run->stats.queued = run->stats.sent = run->stats.first_byte = run->stats.last_row = now;
+      run->stats.rows = result_set_get_n_rows (cached);
+      run->stats.columns = result_set_get_n_columns (cached);
+
+      result_set_unref (cached);
+
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
     }
 
-  GPtrArray *tables = g_ptr_array_new_with_free_func (g_free);
+  /* Binary results cost a prepare and a describe before the query runs,
+   * which a script would fail and then run as text anyway */
+  gboolean binary = db_config.binary_results && sql_text_count_statements (query) == 1;
 
-  int rows = PQntuples (res);
+  db_conn_stream_async (db_editor_conn (), query, binary, append_rows, g_object_ref (model),
+                        g_object_unref, cancellable, on_query_streamed, task);
+}
 
-  for (int i = 0; i < rows; i++)
-    g_ptr_array_add (tables, g_strdup (PQgetvalue (res, i, 0)));
+gboolean
+db_run_query_finish (GAsyncResult *result, QueryStats *stats, GError **error)
+{
+  if (stats)
+    *stats = ((RunQuery *) g_task_get_task_data (G_TASK (result)))->stats;
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static void
+on_explain_result (PGresult *res, gpointer user_data)
+{
+  char **json = user_data;
+
+  if (PQntuples (res) > 0 && !*json)
+    *json = g_strdup (PQgetvalue (res, 0, 0));
 
   PQclear (res);
-  return tables;
 }
 
-GListStore *
-db_fetch_schema (const char *table_name)
+static void
+on_explained (GObject *source, GAsyncResult *result, gpointer user_data)
 {
-  char *escaped = PQescapeLiteral (db_conn, table_name, strlen (table_name));
+  (void) source;
 
-  char *query = g_strdup_printf ("SELECT column_name, data_type, is_nullable "
-                                 "FROM information_schema.columns "
-                                 "WHERE table_name = %s",
-                                 escaped);
+  GTask *task = user_data;
+  char **json = g_task_get_task_data (task);
+  GError *error = NULL;
+  ExplainPlan *plan = NULL;
 
-  PQfreemem (escaped);
+  if (db_conn_pipeline_finish (result, &error))
+    plan = explain_plan_parse (*json ? *json : "", &error);
 
-  PGresult *res = PQexec (db_conn, query);
-  g_free (query);
+  if (plan)
+    g_task_return_pointer (task, plan, (GDestroyNotify) explain_plan_unref);
+  else
+    g_task_return_error (task, error);
+
+  g_object_unref (task);
+}
+
+static gpointer
+discard_result (PGresult *res)
+{
+  PQclear (res);
+  return NULL;
+}
+
+static void
+free_explain_json (gpointer data)
+{
+  char **json = data;
+
+  g_free (*json);
+  g_free (json);
+}
+
+/* Runs query under EXPLAIN (ANALYZE, BUFFERS) in a transaction that is
+ * always rolled back, so explaining a write changes nothing. It runs in
+ * the editor's session when that is free, so it sees the same settings and
+ * temporary tables, inside a savepoint when a transaction is open there. */
+void
+db_explain_async (const char *query,
+                  GCancellable *cancellable,
+                  GAsyncReadyCallback callback,
+                  gpointer user_data)
+{
+  DbConn *conn = db_pool_get (db_pool, DB_LANE_BACKGROUND);
+  PGTransactionStatusType status = PQTRANS_IDLE;
 
-  if (PQresultStatus (res) != PGRES_TUPLES_OK)
+  if (editor_conn && db_conn_get_load (editor_conn) == 0)
     {
-      g_printerr ("Schema query failed: %s\n", PQerrorMessage (db_conn));
-      PQclear (res);
-      return NULL;
+      status = PQtransactionStatus (db_conn_get_pg (editor_conn));
+
+      if (status == PQTRANS_IDLE || status == PQTRANS_INTRANS)
+        conn = editor_conn;
+      else
+        status = PQTRANS_IDLE;
     }
 
-  GListStore *store = g_list_store_new (TYPE_SCHEMA_ROW);
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+  char **json = g_new0 (char *, 1);
 
-  int rows = PQntuples (res);
+  /* The statement is sent on its own, where a trailing ; would be a
+   * second, empty one */
+  char *trimmed = sql_text_strip_end (query);
 
-  for (int i = 0; i < rows; i++)
-    {
-      SchemaRow *row =
-          schema_row_new (PQgetvalue (res, i, 0), PQgetvalue (res, i, 1), PQgetvalue (res, i, 2));
+  char *explain = g_strdup_printf ("EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON) %s", trimmed);
+  DbPipeline *pipeline = db_pipeline_new ();
+
+  g_task_set_task_data (task, json, free_explain_json);
 
-      g_list_store_append (store, row);
-      g_object_unref (row);
+  if (status == PQTRANS_INTRANS)
+    db_pipeline_add (pipeline, "SAVEPOINT " EXPLAIN_SAVEPOINT, 0, NULL, NULL, NULL);
+  else
+    db_pipeline_add (pipeline, "BEGIN", 0, NULL, NULL, NULL);
+
+  db_pipeline_add (pipeline, explain, 0, NULL, on_explain_result, json);
+
+  db_conn_pipeline_async (conn, pipeline, cancellable, on_explained, task);
+
+  /* Queued right behind, so it also ends a transaction the EXPLAIN
+   * failed or was cancelled in, leaving the editor's own as it was */
+  if (status == PQTRANS_INTRANS)
+    {
+      db_conn_exec_async (conn, "ROLLBACK TO SAVEPOINT " EXPLAIN_SAVEPOINT, discard_result, NULL,
+                          NULL, NULL, NULL);
+      db_conn_exec_async (conn, "RELEASE SAVEPOINT " EXPLAIN_SAVEPOINT, discard_result, NULL,
+                          NULL, NULL, NULL);
     }
+  else
+    db_conn_exec_async (conn, "ROLLBACK", discard_result, NULL, NULL, NULL, NULL);
+
+  g_free (explain);
+  g_free (trimmed);
+}
+
+ExplainPlan *
+db_explain_finish (GAsyncResult *result, GError **error)
+{
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+const char *
+db_get_trace_file (void)
+{
+  return db_config.trace_file;
+}
+
+static gpointer
+result_set_from_result (PGresult *res)
+{
+  return result_set_new (res);
+}
+
+typedef struct
+{
+  ResultSet *set;
+  gint64 estimated_rows;
+  /* Share of the table browsed */
+  double fraction;
+  char *key;
+  gint64 cached_at;
+} BrowseOpen;
+
+static void
+browse_open_free (gpointer data)
+{
+  BrowseOpen *open = data;
+
+  g_clear_pointer (&open->set, result_set_unref);
+  g_free (open->key);
+  g_free (open);
+}
+
+static void
+on_browse_page (PGresult *res, gpointer user_data)
+{
+  BrowseOpen *open = user_data;
+
+  open->set = result_set_new (res);
+}
+
+static void
+on_browse_estimate (PGresult *res, gpointer user_data)
+{
+  BrowseOpen *open = user_data;
+
+  if (PQntuples (res) > 0)
+    open->estimated_rows = g_ascii_strtoll (PQgetvalue (res, 0, 0), NULL, 10);
+
+  if (open->estimated_rows > 0)
+    open->estimated_rows = (gint64) (open->estimated_rows * open->fraction + 0.5);
 
   PQclear (res);
-  return store;
 }
 
-GListStore *
-db_run_query (const char *query)
+static void
+on_browse_opened (GObject *source, GAsyncResult *result, gpointer user_data)
 {
-  PGresult *res = PQexec (db_conn, query);
+  (void) source;
+
+  GTask *task = user_data;
+  BrowseOpen *open = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  if (db_conn_pipeline_finish (result, &error))
+    {
+      if (open->set)
+        result_cache_insert (result_cache, open->key, open->set, open->estimated_rows);
+
+      g_task_return_boolean (task, TRUE);
+    }
+  else
+    {
+      g_task_return_error (task, error);
+    }
+
+  g_object_unref (task);
+}
+
+/* The first page came from the cache, so a failure here only shows once
+ * the next page is fetched */
+static void
+on_browse_cursor_opened (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+  (void) user_data;
+
+  GError *error = NULL;
+
+  if (!db_conn_pipeline_finish (result, &error)
+      && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    g_printerr ("Opening browse cursor failed: %s", error->message);
+
+  g_clear_error (&error);
+}
+
+/* The table's schema qualified name, quoted for use in a statement */
+static char *
+quote_table (PGconn *pg, const CatalogTable *table)
+{
+  char *schema = PQescapeIdentifier (pg, table->schema, strlen (table->schema));
+  char *name = PQescapeIdentifier (pg, table->name, strlen (table->name));
+  char *quoted = g_strdup_printf ("%s.%s", schema, name);
+
+  PQfreemem (name);
+  PQfreemem (schema);
+
+  return quoted;
+}
+
+/* Views and foreign tables have no ctid to find a row again by */
+gboolean
+db_browse_has_row_id (const CatalogTable *table)
+{
+  return table->kind != 'v' && table->kind != 'f';
+}
+
+/* TABLESAMPLE reads heap pages, which views and foreign tables don't have */
+gboolean
+db_browse_can_sample (const CatalogTable *table)
+{
+  return table->kind == 'r' || table->kind == 'p' || table->kind == 'm';
+}
+
+/* SYSTEM reads only the sampled share of the table's pages, so its cost
+ * follows the sample size; BERNOULLI picks single rows and reads every
+ * page */
+static char *
+sample_clause (const DbSample *sample)
+{
+  char percent[G_ASCII_DTOSTR_BUF_SIZE];
+
+  g_ascii_formatd (percent, sizeof (percent), "%g", CLAMP (sample->percent, 0, 100));
+
+  return g_strdup_printf (" TABLESAMPLE %s (%s) REPEATABLE (%d)",
+                          sample->bernoulli ? "BERNOULLI" : "SYSTEM", percent, sample->seed);
+}
+
+/* Types whose values have no useful upper bound on their size */
+static gboolean
+is_wide_type (const char *type)
+{
+  static const char *const wide[] = { "text", "bytea", "json", "jsonb", "xml", "tsvector",
+                                      "character varying", NULL };
+
+  if (g_str_has_suffix (type, "[]"))
+    return TRUE;
+
+  for (int i = 0; wide[i]; i++)
+    if (strcmp (type, wide[i]) == 0)
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Wide values arrive as their first bytes followed by their full size, so
+ * a page costs the same whatever the rows hold. The rest is fetched with
+ * db_fetch_value_async when asked for. */
+static void
+append_browse_column (GString *select, PGconn *pg, const CatalogColumn *column)
+{
+  char *name = PQescapeIdentifier (pg, column->name, strlen (column->name));
+
+  if (select->len > 0)
+    g_string_append (select, ", ");
+
+  if (!is_wide_type (column->type))
+    {
+      g_string_append (select, name);
+      PQfreemem (name);
+      return;
+    }
+
+  gboolean bytea = strcmp (column->type, "bytea") == 0;
+  gboolean native = bytea || strcmp (column->type, "text") == 0
+                    || strcmp (column->type, "character varying") == 0;
+  char *value = native ? g_strdup (name) : g_strdup_printf ("%s::text", name);
+  char *prefix = bytea ? g_strdup_printf ("substring (%s FROM 1 FOR %d)::text", value,
+                                          BROWSE_PREFIX_BYTES)
+                       : g_strdup_printf ("left (%s, %d)", value, BROWSE_PREFIX_BYTES);
+
+  g_string_append_printf (select,
+                          "CASE WHEN octet_length (%s) > %d "
+                          "THEN %s || ' \u2026 [' "
+                          "|| pg_size_pretty (octet_length (%s)::bigint) || ']' "
+                          "ELSE %s::text END AS %s",
+                          value, BROWSE_PREFIX_BYTES, prefix, value, value, name);
+
+  g_free (prefix);
+  g_free (value);
+  PQfreemem (name);
+}
+
+/* Opens the cursor, fetches the first page and reads the planner's row
+ * estimate in a single pipelined round trip. sample, when not NULL and
+ * the table can be sampled, browses only that sample of it, with the
+ * estimate scaled to match. order_by names the column to
+ * sort on, or is NULL for the table's own order. Where the table has one,
+ * the row id follows the columns as an extra last column. A first page and
+ * estimate still cached are returned right away, unless bypass_cache is
+ * set, while the cursor is opened behind them. Rows may have changed since
+ * the page was cached, so the caller fetches it again from the cursor. */
+void
+db_browse_open_async (const CatalogTable *table,
+                      const DbSample *sample,
+                      const char *order_by,
+                      gboolean descending,
+                      guint page_size,
+                      gboolean bypass_cache,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer user_data)
+{
+  DbConn *conn = db_browse_conn ();
+  PGconn *pg = db_conn_get_pg (conn);
+  char *escaped = quote_table (pg, table);
+  GString *select = g_string_new (NULL);
+
+  for (guint i = 0; i < table->n_columns; i++)
+    append_browse_column (select, pg, &table->columns[i]);
+
+  if (db_browse_has_row_id (table))
+    g_string_append_printf (select, "%s" BROWSE_ROW_ID, select->len > 0 ? ", " : "");
+
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+  BrowseOpen *open = g_new0 (BrowseOpen, 1);
+
+  open->estimated_rows = -1;
+  open->fraction = 1;
+  g_task_set_task_data (task, open, browse_open_free);
+
+  DbPipeline *pipeline = db_pipeline_new ();
+
+  /* The previous cursor's transaction may still be open, or aborted */
+  if (browse_in_transaction)
+    db_pipeline_add (pipeline, "ROLLBACK", 0, NULL, NULL, NULL);
+
+  char *order = NULL;
+
+  if (order_by)
+    {
+      char *column = PQescapeIdentifier (pg, order_by, strlen (order_by));
+
+      /* Qualified, so it sorts by the value and not the shortened one */
+      order = g_strdup_printf (" ORDER BY %s.%s %s", escaped, column,
+                               descending ? "DESC" : "ASC");
+      PQfreemem (column);
+    }
+
+  char *tablesample = sample && db_browse_can_sample (table) ? sample_clause (sample) : NULL;
+  char *query = g_strdup_printf ("SELECT %s FROM %s%s%s", select->str, escaped,
+                                 tablesample ? tablesample : "", order ? order : "");
+
+  if (tablesample)
+    open->fraction = CLAMP (sample->percent, 0, 100) / 100;
 
-  if (PQresultStatus (res) != PGRES_TUPLES_OK)
+  char *declare = g_strdup_printf ("DECLARE " BROWSE_CURSOR " SCROLL CURSOR FOR %s", query);
+  char *fetch = g_strdup_printf ("FETCH FORWARD %u FROM " BROWSE_CURSOR, page_size);
+  char *kind = g_strdup_printf ("browse %u", page_size);
+  const char *params[] = { escaped };
+
+  open->key = cache_key (kind, query);
+  open->set = bypass_cache ? NULL
+                           : result_cache_lookup (result_cache, open->key, &open->estimated_rows,
+                                                  &open->cached_at);
+
+  db_pipeline_add (pipeline, BROWSE_BEGIN, 0, NULL, NULL, NULL);
+  db_pipeline_add (pipeline, declare, 0, NULL, NULL, NULL);
+
+  if (!open->set)
     {
-      g_printerr ("Query failed: %s\n", PQerrorMessage (db_conn));
-      PQclear (res);
-      return NULL;
+      db_pipeline_add (pipeline, fetch, 0, NULL, on_browse_page, open);
+      db_pipeline_add (pipeline,
+                       "SELECT reltuples::bigint FROM pg_catalog.pg_class WHERE oid = $1::regclass",
+                       1, params, on_browse_estimate, open);
     }
 
-  int rows = PQntuples (res);
-  int cols = PQnfields (res);
+  g_free (browse_declare);
+  browse_declare = declare;
+
+  g_free (kind);
+  g_free (fetch);
+  g_free (query);
+  g_free (tablesample);
+  g_free (order);
+  g_string_free (select, TRUE);
+  g_free (escaped);
 
-  GListStore *store = g_list_store_new (TYPE_GENERIC_ROW);
+  browse_in_transaction = TRUE;
+  db_browse_touch ();
 
-  for (int i = 0; i < rows; i++)
+  if (open->set)
     {
-      GenericRow *row = generic_row_new (cols);
+      db_conn_pipeline_async (conn, pipeline, NULL, on_browse_cursor_opened, NULL);
+      g_task_return_boolean (task, TRUE);
+      g_object_unref (task);
+      return;
+    }
+
+  db_conn_pipeline_async (conn, pipeline, cancellable, on_browse_opened, task);
+}
+
+/* estimated_rows is -1 when the table was never analyzed. cached_at is
+ * the monotonic time a cached first page was fetched, or 0. */
+ResultSet *
+db_browse_open_finish (GAsyncResult *result,
+                       gint64 *estimated_rows,
+                       gint64 *cached_at,
+                       GError **error)
+{
+  if (!g_task_propagate_boolean (G_TASK (result), error))
+    return NULL;
 
-      for (int c = 0; c < cols; c++)
-        {
-          const char *val = PQgetvalue (res, i, c);
-          generic_row_set_value (row, c, val ? val : "");
-        }
+  BrowseOpen *open = g_task_get_task_data (G_TASK (result));
+
+  if (estimated_rows)
+    *estimated_rows = open->estimated_rows;
+
+  if (cached_at)
+    *cached_at = open->cached_at;
+
+  return g_steal_pointer (&open->set);
+}
 
-      g_list_store_append (store, row);
-      g_object_unref (row);
+/* Fetching after db_browse_close declares the cursor again, in a new
+ * transaction that may see rows changed since */
+void
+db_browse_fetch_async (guint offset,
+                       guint count,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+  const char *reopen = "";
+
+  if (!browse_in_transaction && browse_declare)
+    {
+      reopen = browse_declare;
+      browse_in_transaction = TRUE;
     }
 
+  /* MOVE ABSOLUTE is cheap when the cursor already sits at offset, so
+   * sequential pages stay constant time */
+  char *query = g_strdup_printf ("%s%s%s"
+                                 "MOVE ABSOLUTE %u IN " BROWSE_CURSOR "; "
+                                 "FETCH FORWARD %u FROM " BROWSE_CURSOR,
+                                 *reopen ? BROWSE_BEGIN "; " : "", reopen,
+                                 *reopen ? "; " : "", offset, count);
+
+  db_browse_touch ();
+
+  db_conn_exec_async (db_browse_conn (), query, result_set_from_result,
+                      (GDestroyNotify) result_set_unref, cancellable, callback, user_data);
+  g_free (query);
+}
+
+ResultSet *
+db_browse_fetch_finish (GAsyncResult *result, GError **error)
+{
+  return db_conn_exec_finish (result, error);
+}
+
+/* Ends the cursor's transaction, so an idle browse holds no snapshot that
+ * keeps vacuum from cleaning up and no lock that blocks ALTER, TRUNCATE or
+ * DROP on the table */
+void
+db_browse_close (void)
+{
+  if (browse_idle_id)
+    g_source_remove (browse_idle_id);
+
+  browse_idle_id = 0;
+
+  if (!browse_in_transaction)
+    return;
+
+  db_conn_exec_async (browse_conn, "ROLLBACK", discard_result, NULL, NULL, NULL, NULL);
+  browse_in_transaction = FALSE;
+}
+
+static gpointer
+value_from_result (PGresult *res)
+{
+  char *value = NULL;
+
+  if (PQntuples (res) > 0)
+    value = g_strdup (PQgetisnull (res, 0, 0) ? "NULL" : PQgetvalue (res, 0, 0));
+
   PQclear (res);
-  return store;
+  return value;
+}
+
+/* Reads one whole value of the row at row_id, as read by the browse
+ * cursor: in its transaction while that is open. Finishes with NULL and
+ * no error once the row is gone. */
+void
+db_fetch_value_async (const CatalogTable *table,
+                      const char *column,
+                      const char *row_id,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer user_data)
+{
+  DbConn *conn = browse_in_transaction ? db_browse_conn ()
+                                       : db_pool_get (db_pool, DB_LANE_INTERACTIVE);
+  PGconn *pg = db_conn_get_pg (conn);
+  char *quoted = quote_table (pg, table);
+  char *name = PQescapeIdentifier (pg, column, strlen (column));
+  char *id = PQescapeLiteral (pg, row_id, strlen (row_id));
+  char *query = g_strdup_printf ("SELECT %s::text FROM %s "
+                                 "WHERE tableoid = split_part (%s, ' ', 1)::oid "
+                                 "AND ctid = split_part (%s, ' ', 2)::tid "
+                                 "AND xmin = split_part (%s, ' ', 3)::xid",
+                                 name, quoted, id, id, id);
+
+  if (browse_in_transaction)
+    db_browse_touch ();
+
+  db_conn_exec_async (conn, query, value_from_result, g_free, cancellable, callback, user_data);
+
+  g_free (query);
+  PQfreemem (id);
+  PQfreemem (name);
+  g_free (quoted);
+}
+
+char *
+db_fetch_value_finish (GAsyncResult *result, GError **error)
+{
+  return db_conn_exec_finish (result, error);
+}
+
+/* Exports go over a connection of their own, so the pool stays free for
+ * browsing and queries while a large file is written. The format follows
+ * the file's extension. */
+void
+db_export_table_async (const CatalogTable *table,
+                       const char *path,
+                       DbCopyProgressFunc progress,
+                       gpointer progress_data,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+  PGconn *pg = db_conn_get_pg (db_pool_get (db_pool, DB_LANE_INTERACTIVE));
+  char *quoted = quote_table (pg, table);
+  char *query = g_strdup_printf ("SELECT * FROM %s", quoted);
+
+  db_copy_out_async (&db_config, query, path, db_copy_format_for_path (path), progress,
+                     progress_data, cancellable, callback, user_data);
+
+  g_free (query);
+  g_free (quoted);
+}
+
+/* sql must be a single query; trailing semicolons and comments are
+ * dropped, as it is wrapped in a COPY */
+void
+db_export_query_async (const char *sql,
+                       const char *path,
+                       DbCopyProgressFunc progress,
+                       gpointer progress_data,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
+{
+  char *query = sql_text_strip_end (sql);
+
+  db_copy_out_async (&db_config, query, path, db_copy_format_for_path (path), progress,
+                     progress_data, cancellable, callback, user_data);
+
+  g_free (query);
 }
 
-GListStore *
-db_fetch_top_100 (const char *table_name)
+gboolean
+db_export_finish (GAsyncResult *result, guint64 *rows, GError **error)
+{
+  return db_copy_out_finish (result, rows, error);
+}
+
+/* Imports map the file's header onto columns, the table's when known */
+void
+db_import_table_async (const CatalogTable *table,
+                       const char *const *columns,
+                       const char *path,
+                       DbCopyProgressFunc progress,
+                       gpointer progress_data,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data)
 {
-  char *escaped = PQescapeIdentifier (db_conn, table_name, strlen (table_name));
-  char *query = g_strdup_printf ("SELECT * FROM %s LIMIT 100", escaped);
+  PGconn *pg = db_conn_get_pg (db_pool_get (db_pool, DB_LANE_INTERACTIVE));
+  char *quoted = quote_table (pg, table);
 
-  PQfreemem (escaped);
+  db_copy_in_async (&db_config, quoted, columns, path, db_copy_format_for_path (path), progress,
+                    progress_data, cancellable, callback, user_data);
 
-  return db_run_query (query);
+  g_free (quoted);
+}
+
+gboolean
+db_import_finish (GAsyncResult *result, guint64 *rows, GError **error)
+{
+  return db_copy_in_finish (result, rows, error);
 }
\ No newline at end of file
@@ -1,6 +1,12 @@
 #ifndef DB_H
 #define DB_H
 
+#include "catalog.h"
+#include "db_copy.h"
+#include "explain_plan.h"
+#include "query_stats.h"
+#include "result-model.h"
+
 #include <gio/gio.h>
 #include <glib.h>
 #include <libpq-fe.h>
@@ -8,9 +14,107 @@
 gboolean db_connect (void);
 void db_disconnect (void);
 
-GPtrArray *db_fetch_table_names (void);
-GListStore *db_fetch_schema (const char *table_name);
-GListStore *db_fetch_top_100 (const char *table_name);
-GListStore *db_run_query (const char *query);
+void db_clear_cache (void);
+
+void db_fetch_catalog_async (GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data);
+Catalog *db_fetch_catalog_finish (GAsyncResult *result, GError **error);
+
+void db_fetch_catalog_fingerprint_async (GCancellable *cancellable,
+                                         GAsyncReadyCallback callback,
+                                         gpointer user_data);
+char *db_fetch_catalog_fingerprint_finish (GAsyncResult *result, GError **error);
+
+void db_fetch_table_stats_async (GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data);
+GHashTable *db_fetch_table_stats_finish (GAsyncResult *result, GError **error);
+
+char *db_catalog_cache_path (void);
+
+/* A sample of a table to browse instead of all of it */
+typedef struct
+{
+  /* Row by row instead of whole pages */
+  gboolean bernoulli;
+  double percent;
+  /* The same seed picks the same rows while the table is unchanged */
+  int seed;
+} DbSample;
+
+gboolean db_browse_has_row_id (const CatalogTable *table);
+gboolean db_browse_can_sample (const CatalogTable *table);
+void db_browse_open_async (const CatalogTable *table,
+                           const DbSample *sample,
+                           const char *order_by,
+                           gboolean descending,
+                           guint page_size,
+                           gboolean bypass_cache,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data);
+ResultSet *db_browse_open_finish (GAsyncResult *result,
+                                  gint64 *estimated_rows,
+                                  gint64 *cached_at,
+                                  GError **error);
+
+void db_browse_fetch_async (guint offset,
+                            guint count,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data);
+ResultSet *db_browse_fetch_finish (GAsyncResult *result, GError **error);
+void db_browse_close (void);
+
+void db_fetch_value_async (const CatalogTable *table,
+                           const char *column,
+                           const char *row_id,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data);
+char *db_fetch_value_finish (GAsyncResult *result, GError **error);
+
+void db_run_query_async (const char *query,
+                         ResultModel *model,
+                         gboolean bypass_cache,
+                         GCancellable *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data);
+gboolean db_run_query_finish (GAsyncResult *result, QueryStats *stats, GError **error);
+
+void db_explain_async (const char *query,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data);
+ExplainPlan *db_explain_finish (GAsyncResult *result, GError **error);
+
+const char *db_get_trace_file (void);
+
+void db_export_table_async (const CatalogTable *table,
+                            const char *path,
+                            DbCopyProgressFunc progress,
+                            gpointer progress_data,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data);
+void db_export_query_async (const char *sql,
+                            const char *path,
+                            DbCopyProgressFunc progress,
+                            gpointer progress_data,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data);
+gboolean db_export_finish (GAsyncResult *result, guint64 *rows, GError **error);
+
+void db_import_table_async (const CatalogTable *table,
+                            const char *const *columns,
+                            const char *path,
+                            DbCopyProgressFunc progress,
+                            gpointer progress_data,
+                            GCancellable *cancellable,
+                            GAsyncReadyCallback callback,
+                            gpointer user_data);
+gboolean db_import_finish (GAsyncResult *result, guint64 *rows, GError **error);
 
 #endif
\ No newline at end of file
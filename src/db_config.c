@@ -1,9 +1,56 @@
 #include "db_config.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <yaml.h>
 
+static int
+parse_bool (const char *value)
+{
+  return strcmp (value, "true") == 0 || strcmp (value, "yes") == 0 || strcmp (value, "1") == 0;
+}
+
+static void
+set_config_value (DbConfig *config, const char *section, const char *key, const char *value)
+{
+  if (strcmp (section, "database") == 0)
+    {
+      if (strcmp (key, "host") == 0)
+        strncpy (config->host, value, sizeof (config->host) - 1);
+      else if (strcmp (key, "port") == 0)
+        strncpy (config->port, value, sizeof (config->port) - 1);
+      else if (strcmp (key, "dbname") == 0)
+        strncpy (config->dbname, value, sizeof (config->dbname) - 1);
+      else if (strcmp (key, "user") == 0)
+        strncpy (config->user, value, sizeof (config->user) - 1);
+      else if (strcmp (key, "password") == 0)
+        strncpy (config->password, value, sizeof (config->password) - 1);
+    }
+  else if (strcmp (section, "pool") == 0)
+    {
+      if (strcmp (key, "size") == 0)
+        config->pool_size = atoi (value);
+    }
+  else if (strcmp (section, "results") == 0)
+    {
+      if (strcmp (key, "binary") == 0)
+        config->binary_results = parse_bool (value);
+    }
+  else if (strcmp (section, "trace") == 0)
+    {
+      if (strcmp (key, "file") == 0)
+        strncpy (config->trace_file, value, sizeof (config->trace_file) - 1);
+    }
+  else if (strcmp (section, "cache") == 0)
+    {
+      if (strcmp (key, "size_mb") == 0)
+        config->cache_size_mb = atoi (value);
+      else if (strcmp (key, "ttl") == 0)
+        config->cache_ttl = atoi (value);
+    }
+}
+
 int
 load_db_config (const char *filename, DbConfig *config)
 {
@@ -15,6 +62,7 @@ load_db_config (const char *filename, DbConfig *config)
     }
 
   memset (config, 0, sizeof (DbConfig));
+  config->cache_size_mb = -1;
 
   yaml_parser_t parser;
   yaml_event_t event;
@@ -28,38 +76,43 @@ load_db_config (const char *filename, DbConfig *config)
 
   yaml_parser_set_input_file (&parser, fh);
 
+  char section[64] = { 0 };
   char current_key[64] = { 0 };
-  int in_database = 0;
+  int depth = 0;
 
   while (1)
     {
       if (!yaml_parser_parse (&parser, &event))
         break;
 
-      if (event.type == YAML_SCALAR_EVENT)
+      /* Top level keys name a section, the mappings below hold the values */
+      if (event.type == YAML_MAPPING_START_EVENT)
+        {
+          depth++;
+        }
+      else if (event.type == YAML_MAPPING_END_EVENT)
+        {
+          depth--;
+          current_key[0] = '\0';
+
+          if (depth <= 1)
+            section[0] = '\0';
+        }
+      else if (event.type == YAML_SCALAR_EVENT)
         {
           char *value = (char *) event.data.scalar.value;
 
-          if (strcmp (value, "database") == 0)
+          if (depth == 1)
             {
-              in_database = 1;
+              strncpy (section, value, sizeof (section) - 1);
             }
-          else if (in_database && current_key[0] == '\0')
+          else if (depth == 2 && current_key[0] == '\0')
             {
               strncpy (current_key, value, sizeof (current_key) - 1);
             }
-          else if (in_database)
+          else if (depth == 2)
             {
-              if (strcmp (current_key, "host") == 0)
-                strncpy (config->host, value, sizeof (config->host) - 1);
-              else if (strcmp (current_key, "port") == 0)
-                strncpy (config->port, value, sizeof (config->port) - 1);
-              else if (strcmp (current_key, "dbname") == 0)
-                strncpy (config->dbname, value, sizeof (config->dbname) - 1);
-              else if (strcmp (current_key, "user") == 0)
-                strncpy (config->user, value, sizeof (config->user) - 1);
-              else if (strcmp (current_key, "password") == 0)
-                strncpy (config->password, value, sizeof (config->password) - 1);
+              set_config_value (config, section, current_key, value);
 
               current_key[0] = '\0';
             }
@@ -80,13 +133,19 @@ load_db_config (const char *filename, DbConfig *config)
   return 1;
 }
 
+static void
+format_conninfo (const DbConfig *config, char *conninfo, size_t size)
+{
+  snprintf (conninfo, size, "host=%s port=%s dbname=%s user=%s password=%s", config->host,
+            config->port, config->dbname, config->user, config->password);
+}
+
 PGconn *
 db_connect_from_config (const DbConfig *config)
 {
   char conninfo[512];
 
-  snprintf (conninfo, sizeof (conninfo), "host=%s port=%s dbname=%s user=%s password=%s",
-            config->host, config->port, config->dbname, config->user, config->password);
+  format_conninfo (config, conninfo, sizeof (conninfo));
 
   printf ("%s\n", conninfo);
 
@@ -97,5 +156,24 @@ db_connect_from_config (const DbConfig *config)
       fprintf (stderr, "Connection failed: %s\n", PQerrorMessage (conn));
     }
 
+  return conn;
+}
+
+/* Starts connecting without waiting for the server; the connection is
+ * then driven with PQconnectPoll */
+PGconn *
+db_connect_start_from_config (const DbConfig *config)
+{
+  char conninfo[512];
+
+  format_conninfo (config, conninfo, sizeof (conninfo));
+
+  PGconn *conn = PQconnectStart (conninfo);
+
+  if (PQstatus (conn) == CONNECTION_BAD)
+    {
+      fprintf (stderr, "Connection failed: %s\n", PQerrorMessage (conn));
+    }
+
   return conn;
 }
\ No newline at end of file
@@ -10,9 +10,21 @@ typedef struct
   char dbname[64];
   char user[64];
   char password[64];
+
+  int pool_size;
+  int binary_results;
+
+  /* JSON lines file with per-query timings, empty to disable */
+  char trace_file[256];
+
+  /* Result cache budget, -1 when unset and 0 to disable, and the age in
+   * seconds past which a cached result is refetched, 0 for no limit */
+  int cache_size_mb;
+  int cache_ttl;
 } DbConfig;
 
 int load_db_config (const char *filename, DbConfig *config);
 PGconn *db_connect_from_config (const DbConfig *config);
+PGconn *db_connect_start_from_config (const DbConfig *config);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,987 @@
+#include "db_conn.h"
+#include "pg_types.h"
+
+#include <glib-unix.h>
+#include <sys/ioctl.h>
+
+/* Rows per batch handed to a stream consumer */
+#define STREAM_BATCH_ROWS 1000
+
+struct _DbConn
+{
+  PGconn *pg;
+
+  GQueue pending;
+  GTask *current;
+
+  PGcancel *cancel;
+  guint watch_id;
+
+  /* Set while the connection is still being set up, or set up again
+   * after it dropped, queries wait */
+  gboolean connecting;
+  gboolean resetting;
+  guint connect_id;
+
+  /* Names of the statements prepared on this session */
+  GHashTable *prepared;
+};
+
+typedef enum
+{
+  DB_PHASE_EXECUTE,
+  DB_PHASE_PREPARE,
+  DB_PHASE_DESCRIBE,
+  DB_PHASE_PREPARE_NAMED
+} DbPhase;
+
+typedef struct
+{
+  char *query;
+  char **params;
+  int n_params;
+
+  DbStepFunc on_result;
+  gpointer user_data;
+} DbStep;
+
+struct _DbPipeline
+{
+  GArray *steps;
+};
+
+typedef struct
+{
+  char *query;
+  gboolean binary;
+  DbPhase phase;
+
+  DbPipeline *pipeline;
+  guint step;
+
+  char *statement;
+  char **params;
+  int n_params;
+  gboolean retried;
+
+  DbResultFunc convert;
+  GDestroyNotify result_free;
+
+  DbRowsFunc on_rows;
+  gpointer rows_data;
+  GDestroyNotify rows_data_free;
+  PGresult *batch;
+  gboolean has_rows;
+  gboolean set_done;
+
+  PGresult *result;
+  gulong cancel_id;
+
+  QueryStats stats;
+} DbExec;
+
+static void db_conn_start_next (DbConn *conn);
+static void db_conn_poll_connect (DbConn *conn);
+
+static char **
+dup_params (int n_params, const char *const *params)
+{
+  char **copy = g_new0 (char *, n_params);
+
+  for (int i = 0; i < n_params; i++)
+    copy[i] = g_strdup (params[i]);
+
+  return copy;
+}
+
+/* Parameters may be NULL, so they aren't a strv */
+static void
+free_params (int n_params, char **params)
+{
+  for (int i = 0; i < n_params; i++)
+    g_free (params[i]);
+
+  g_free (params);
+}
+
+static void
+db_step_clear (gpointer data)
+{
+  DbStep *step = data;
+
+  g_free (step->query);
+  free_params (step->n_params, step->params);
+}
+
+DbPipeline *
+db_pipeline_new (void)
+{
+  DbPipeline *pipeline = g_new0 (DbPipeline, 1);
+
+  pipeline->steps = g_array_new (FALSE, TRUE, sizeof (DbStep));
+  g_array_set_clear_func (pipeline->steps, db_step_clear);
+
+  return pipeline;
+}
+
+void
+db_pipeline_free (DbPipeline *pipeline)
+{
+  if (!pipeline)
+    return;
+
+  g_array_free (pipeline->steps, TRUE);
+  g_free (pipeline);
+}
+
+/* Queues a statement with bound text parameters. on_result, if set, gets
+ * its result as soon as it arrives. */
+void
+db_pipeline_add (DbPipeline *pipeline,
+                 const char *query,
+                 int n_params,
+                 const char *const *params,
+                 DbStepFunc on_result,
+                 gpointer user_data)
+{
+  DbStep step;
+
+  step.query = g_strdup (query);
+  step.n_params = n_params;
+  step.params = dup_params (n_params, params);
+  step.on_result = on_result;
+  step.user_data = user_data;
+
+  g_array_append_val (pipeline->steps, step);
+}
+
+static void
+db_exec_free (gpointer data)
+{
+  DbExec *exec = data;
+
+  g_free (exec->query);
+  g_free (exec->statement);
+  free_params (exec->n_params, exec->params);
+  db_pipeline_free (exec->pipeline);
+  g_clear_pointer (&exec->batch, PQclear);
+  g_clear_pointer (&exec->result, PQclear);
+
+  if (exec->rows_data_free)
+    exec->rows_data_free (exec->rows_data);
+
+  g_free (exec);
+}
+
+static void
+db_conn_fail_pending (DbConn *conn, const char *message)
+{
+  GTask *task;
+
+  while ((task = g_queue_pop_head (&conn->pending)))
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_CLOSED, "%s", message);
+      g_object_unref (task);
+    }
+}
+
+static gboolean
+on_connect_ready (gint fd, GIOCondition condition, gpointer user_data)
+{
+  (void) fd;
+  (void) condition;
+
+  DbConn *conn = user_data;
+
+  conn->connect_id = 0;
+  db_conn_poll_connect (conn);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Advances the connection setup by one step, then waits for the socket
+ * again. libpq may switch sockets between steps, e.g. to try the next
+ * host, so the watch is added anew every time. */
+static void
+db_conn_poll_connect (DbConn *conn)
+{
+  switch (conn->resetting ? PQresetPoll (conn->pg) : PQconnectPoll (conn->pg))
+    {
+    case PGRES_POLLING_READING:
+      conn->connect_id = g_unix_fd_add (PQsocket (conn->pg), G_IO_IN, on_connect_ready, conn);
+      return;
+
+    case PGRES_POLLING_WRITING:
+      conn->connect_id = g_unix_fd_add (PQsocket (conn->pg), G_IO_OUT, on_connect_ready, conn);
+      return;
+
+    case PGRES_POLLING_OK:
+      conn->connecting = FALSE;
+      conn->resetting = FALSE;
+      db_conn_start_next (conn);
+      return;
+
+    default:
+      conn->connecting = FALSE;
+      conn->resetting = FALSE;
+      g_printerr ("Connection failed: %s", PQerrorMessage (conn->pg));
+      db_conn_fail_pending (conn, PQerrorMessage (conn->pg));
+      return;
+    }
+}
+
+/* pg may still be connecting, as started by PQconnectStart. Queries
+ * queued meanwhile are sent once it is up, and fail if it never is. */
+DbConn *
+db_conn_new (PGconn *pg)
+{
+  DbConn *conn = g_new0 (DbConn, 1);
+
+  conn->pg = pg;
+  conn->prepared = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_queue_init (&conn->pending);
+
+  if (!pg)
+    return conn;
+
+  pg_track_session_time_zone (pg);
+
+  ConnStatusType status = PQstatus (pg);
+
+  if (status != CONNECTION_OK && status != CONNECTION_BAD)
+    {
+      /* A fresh connection is polled first as if it had asked to write */
+      conn->connecting = TRUE;
+      conn->connect_id = g_unix_fd_add (PQsocket (pg), G_IO_OUT, on_connect_ready, conn);
+    }
+
+  return conn;
+}
+
+static void
+cancel_thread (GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+  (void) source;
+  (void) cancellable;
+
+  char errbuf[256];
+
+  if (!PQcancel (task_data, errbuf, sizeof (errbuf)))
+    g_printerr ("Cancel failed: %s\n", errbuf);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/* PQcancel connects to the server and waits for it to answer, so it runs
+ * on a worker thread, which takes ownership of cancel */
+static void
+db_conn_send_cancel (PGcancel *cancel)
+{
+  GTask *task = g_task_new (NULL, NULL, NULL, NULL);
+
+  g_task_set_task_data (task, cancel, (GDestroyNotify) PQfreeCancel);
+  g_task_run_in_thread (task, cancel_thread);
+  g_object_unref (task);
+}
+
+void
+db_conn_free (DbConn *conn)
+{
+  if (!conn)
+    return;
+
+  if (conn->current)
+    {
+      DbExec *exec = g_task_get_task_data (conn->current);
+
+      if (conn->cancel)
+        db_conn_send_cancel (g_steal_pointer (&conn->cancel));
+
+      g_cancellable_disconnect (g_task_get_cancellable (conn->current), exec->cancel_id);
+
+      g_task_return_new_error (conn->current, G_IO_ERROR, G_IO_ERROR_CLOSED, "Connection closed");
+      g_clear_object (&conn->current);
+    }
+
+  db_conn_fail_pending (conn, "Connection closed");
+
+  if (conn->watch_id)
+    g_source_remove (conn->watch_id);
+
+  if (conn->connect_id)
+    g_source_remove (conn->connect_id);
+
+  g_clear_pointer (&conn->cancel, PQfreeCancel);
+  g_hash_table_destroy (conn->prepared);
+
+  if (conn->pg)
+    PQfinish (conn->pg);
+
+  g_free (conn);
+}
+
+PGconn *
+db_conn_get_pg (DbConn *conn)
+{
+  return conn->pg;
+}
+
+/* Queries running or waiting on this connection */
+guint
+db_conn_get_load (DbConn *conn)
+{
+  return g_queue_get_length (&conn->pending) + (conn->current ? 1 : 0);
+}
+
+static void
+on_exec_cancelled (GCancellable *cancellable, gpointer user_data)
+{
+  (void) cancellable;
+
+  DbConn *conn = user_data;
+
+  /* The server answers the in-flight query with an error, which
+   * finishes it through the normal read path */
+  if (conn->cancel)
+    db_conn_send_cancel (g_steal_pointer (&conn->cancel));
+}
+
+static void
+db_conn_finish_current (DbConn *conn, GError *error)
+{
+  GTask *task = g_steal_pointer (&conn->current);
+  DbExec *exec = g_task_get_task_data (task);
+
+  g_cancellable_disconnect (g_task_get_cancellable (task), exec->cancel_id);
+  exec->cancel_id = 0;
+
+  g_clear_pointer (&conn->cancel, PQfreeCancel);
+
+  exec->stats.last_row = g_get_monotonic_time ();
+
+  if (error)
+    {
+      g_task_return_error (task, error);
+    }
+  else if (!exec->result && !exec->on_rows && !exec->pipeline)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED, "%s",
+                               PQerrorMessage (conn->pg));
+    }
+  else if (exec->result && PQresultStatus (exec->result) != PGRES_TUPLES_OK
+           && PQresultStatus (exec->result) != PGRES_COMMAND_OK)
+    {
+      g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED, "%s",
+                               PQresultErrorMessage (exec->result));
+    }
+  else if (exec->on_rows || exec->pipeline)
+    {
+      g_task_return_boolean (task, TRUE);
+    }
+  else
+    {
+      g_task_return_pointer (task, exec->convert (g_steal_pointer (&exec->result)),
+                             exec->result_free);
+    }
+
+  g_object_unref (task);
+
+  db_conn_start_next (conn);
+}
+
+/* Hands a batch to the consumer, timing how long the model takes */
+static void
+db_exec_emit_rows (DbExec *exec, PGresult *batch)
+{
+  gint64 start = g_get_monotonic_time ();
+
+  if (batch)
+    {
+      exec->stats.rows += PQntuples (batch);
+      exec->stats.columns = PQnfields (batch);
+    }
+  else
+    {
+      exec->stats.rows = 0;
+    }
+
+  exec->on_rows (batch, exec->rows_data);
+
+  exec->stats.build_us += g_get_monotonic_time () - start;
+}
+
+static void
+db_exec_flush_rows (DbExec *exec)
+{
+  if (!exec->batch)
+    return;
+
+  db_exec_emit_rows (exec, g_steal_pointer (&exec->batch));
+  exec->has_rows = TRUE;
+}
+
+static void
+db_exec_begin_rows (DbExec *exec)
+{
+  if (!exec->set_done)
+    return;
+
+  db_exec_emit_rows (exec, NULL);
+  exec->set_done = FALSE;
+  exec->has_rows = FALSE;
+}
+
+/* Routes row-carrying results of a streamed query to its consumer.
+ * Returns FALSE for results that finish the query the normal way. */
+static gboolean
+db_exec_take_rows (DbExec *exec, PGresult *res)
+{
+  switch (PQresultStatus (res))
+    {
+    case PGRES_SINGLE_TUPLE:
+      {
+        db_exec_begin_rows (exec);
+
+        /* A PGresult per row is far too heavy to keep, so rows are
+         * copied into a shared batch result */
+        if (!exec->batch)
+          exec->batch = PQcopyResult (res, PG_COPYRES_ATTRS | PG_COPYRES_EVENTS);
+
+        int row = PQntuples (exec->batch);
+
+        for (int c = 0; c < PQnfields (res); c++)
+          {
+            gboolean is_null = PQgetisnull (res, 0, c);
+
+            PQsetvalue (exec->batch, row, c, is_null ? NULL : PQgetvalue (res, 0, c),
+                        is_null ? -1 : PQgetlength (res, 0, c));
+          }
+
+        PQclear (res);
+
+        if (row + 1 >= STREAM_BATCH_ROWS)
+          db_exec_flush_rows (exec);
+
+        return TRUE;
+      }
+
+#ifdef LIBPQ_HAS_CHUNK_MODE
+    case PGRES_TUPLES_CHUNK:
+      db_exec_begin_rows (exec);
+      db_exec_emit_rows (exec, res);
+      exec->has_rows = TRUE;
+      return TRUE;
+#endif
+
+    case PGRES_TUPLES_OK:
+      db_exec_begin_rows (exec);
+      db_exec_flush_rows (exec);
+
+      /* An empty set still carries the column descriptions */
+      if (exec->has_rows)
+        PQclear (res);
+      else
+        db_exec_emit_rows (exec, res);
+
+      exec->has_rows = TRUE;
+      exec->set_done = TRUE;
+      return TRUE;
+
+    default:
+      return FALSE;
+    }
+}
+
+static void
+db_conn_set_row_mode (DbConn *conn, DbExec *exec)
+{
+  if (!exec->on_rows)
+    return;
+
+#ifdef LIBPQ_HAS_CHUNK_MODE
+  PQsetChunkedRowsMode (conn->pg, STREAM_BATCH_ROWS);
+#else
+  PQsetSingleRowMode (conn->pg);
+#endif
+}
+
+/* Binary queries are prepared and described first, so the result format
+ * can be picked from the column types. Returns TRUE once the next step is
+ * sent. */
+static gboolean
+db_conn_advance (DbConn *conn, DbExec *exec, GError **error)
+{
+  PGresult *res = g_steal_pointer (&exec->result);
+  gboolean ok = res && PQresultStatus (res) == PGRES_COMMAND_OK;
+  gboolean sent;
+
+  /* 42P05: the session still has a statement we had forgotten */
+  if (exec->phase == DB_PHASE_PREPARE_NAMED && !ok && res
+      && g_strcmp0 (PQresultErrorField (res, PG_DIAG_SQLSTATE), "42P05") == 0)
+    ok = TRUE;
+
+  if (exec->phase == DB_PHASE_PREPARE_NAMED && !ok)
+    {
+      /* Report the prepare error as the result of the query */
+      exec->result = res;
+      exec->phase = DB_PHASE_EXECUTE;
+      return FALSE;
+    }
+  else if (exec->phase == DB_PHASE_PREPARE_NAMED)
+    {
+      g_hash_table_add (conn->prepared, g_strdup (exec->statement));
+
+      exec->phase = DB_PHASE_EXECUTE;
+      sent = PQsendQueryPrepared (conn->pg, exec->statement, exec->n_params,
+                                  (const char *const *) exec->params, NULL, NULL, 0);
+    }
+  else if (exec->phase == DB_PHASE_PREPARE && !ok)
+    {
+      /* Scripts with several statements can't be prepared, run them as text */
+      exec->phase = DB_PHASE_EXECUTE;
+      sent = PQsendQuery (conn->pg, exec->query);
+    }
+  else if (exec->phase == DB_PHASE_PREPARE)
+    {
+      exec->phase = DB_PHASE_DESCRIBE;
+      sent = PQsendDescribePrepared (conn->pg, "");
+    }
+  else
+    {
+      int format = ok;
+
+      for (int c = 0; ok && c < PQnfields (res); c++)
+        if (!pg_type_has_binary_decoder (PQftype (res, c)))
+          format = 0;
+
+      exec->phase = DB_PHASE_EXECUTE;
+      sent = PQsendQueryPrepared (conn->pg, "", 0, NULL, NULL, NULL, format);
+    }
+
+  g_clear_pointer (&res, PQclear);
+
+  if (!sent)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", PQerrorMessage (conn->pg));
+      return FALSE;
+    }
+
+  if (exec->phase == DB_PHASE_EXECUTE)
+    db_conn_set_row_mode (conn, exec);
+
+  return TRUE;
+}
+
+/* Executes a registered statement, preparing it first if this session
+ * hasn't seen it yet */
+static gboolean
+db_conn_send_statement (DbConn *conn, DbExec *exec)
+{
+  if (g_hash_table_contains (conn->prepared, exec->statement))
+    {
+      exec->phase = DB_PHASE_EXECUTE;
+      return PQsendQueryPrepared (conn->pg, exec->statement, exec->n_params,
+                                  (const char *const *) exec->params, NULL, NULL, 0);
+    }
+
+  exec->phase = DB_PHASE_PREPARE_NAMED;
+  return PQsendPrepare (conn->pg, exec->statement, exec->query, exec->n_params, NULL);
+}
+
+/* The server forgets prepared statements on DISCARD ALL or DEALLOCATE,
+ * which the query editor can run in its session. Only the missing one is
+ * forgotten here; others are found missing when they next run. */
+static gboolean
+db_exec_lost_statement (DbConn *conn, DbExec *exec)
+{
+  if (!exec->statement || exec->retried || !exec->result)
+    return FALSE;
+
+  const char *state = PQresultErrorField (exec->result, PG_DIAG_SQLSTATE);
+
+  if (g_strcmp0 (state, "26000") != 0)
+    return FALSE;
+
+  g_hash_table_remove (conn->prepared, exec->statement);
+  g_clear_pointer (&exec->result, PQclear);
+  exec->retried = TRUE;
+
+  return TRUE;
+}
+
+/* Sends every step of the pipeline followed by a single sync, so the
+ * whole batch costs one round trip */
+static gboolean
+db_conn_send_pipeline (DbConn *conn, DbExec *exec)
+{
+  GArray *steps = exec->pipeline->steps;
+
+  if (!PQenterPipelineMode (conn->pg))
+    return FALSE;
+
+  for (guint i = 0; i < steps->len; i++)
+    {
+      DbStep *step = &g_array_index (steps, DbStep, i);
+
+      if (!PQsendQueryParams (conn->pg, step->query, step->n_params, NULL,
+                              (const char *const *) step->params, NULL, NULL, 0))
+        goto failed;
+    }
+
+  if (PQpipelineSync (conn->pg))
+    return TRUE;
+
+failed:
+  /* Sending only fails on a broken connection, whose reset also clears
+   * its pipeline state */
+  PQexitPipelineMode (conn->pg);
+  return FALSE;
+}
+
+/* Hands each step its result as it arrives. A NULL result ends the
+ * current step; the sync marker ends the pipeline. Returns TRUE once
+ * the pipeline is done. */
+static gboolean
+db_conn_read_pipeline (DbConn *conn, DbExec *exec)
+{
+  GArray *steps = exec->pipeline->steps;
+
+  while (!PQisBusy (conn->pg))
+    {
+      PGresult *res = PQgetResult (conn->pg);
+
+      if (!res)
+        {
+          exec->step++;
+          continue;
+        }
+
+      switch (PQresultStatus (res))
+        {
+        case PGRES_PIPELINE_SYNC:
+          PQclear (res);
+          PQexitPipelineMode (conn->pg);
+          return TRUE;
+
+        case PGRES_PIPELINE_ABORTED:
+          PQclear (res);
+          break;
+
+        case PGRES_FATAL_ERROR:
+          /* Later steps are aborted by the server, keep the cause */
+          if (!exec->result)
+            exec->result = res;
+          else
+            PQclear (res);
+          break;
+
+        default:
+          {
+            DbStep *step = exec->step < steps->len
+                               ? &g_array_index (steps, DbStep, exec->step)
+                               : NULL;
+
+            if (step && step->on_result)
+              step->on_result (res, step->user_data);
+            else
+              PQclear (res);
+          }
+        }
+    }
+
+  return FALSE;
+}
+
+static gboolean
+on_socket_readable (gint fd, GIOCondition condition, gpointer user_data)
+{
+  (void) fd;
+  (void) condition;
+
+  DbConn *conn = user_data;
+  DbExec *exec = g_task_get_task_data (conn->current);
+  int available = 0;
+
+  if (!exec->stats.first_byte)
+    exec->stats.first_byte = g_get_monotonic_time ();
+
+  /* libpq doesn't count bytes, so ask the socket what it is holding */
+  if (ioctl (PQsocket (conn->pg), FIONREAD, &available) == 0)
+    exec->stats.bytes += available;
+
+  if (!PQconsumeInput (conn->pg))
+    {
+      conn->watch_id = 0;
+      db_conn_finish_current (conn, g_error_new (G_IO_ERROR, G_IO_ERROR_FAILED, "%s",
+                                                 PQerrorMessage (conn->pg)));
+      return G_SOURCE_REMOVE;
+    }
+
+  if (exec->pipeline)
+    {
+      if (!db_conn_read_pipeline (conn, exec))
+        return G_SOURCE_CONTINUE;
+
+      conn->watch_id = 0;
+      db_conn_finish_current (conn, NULL);
+
+      return G_SOURCE_REMOVE;
+    }
+
+  while (!PQisBusy (conn->pg))
+    {
+      PGresult *res = PQgetResult (conn->pg);
+
+      if (res == NULL)
+        {
+          GError *error = NULL;
+
+          if (exec->phase != DB_PHASE_EXECUTE && db_conn_advance (conn, exec, &error))
+            continue;
+
+          if (!error && db_exec_lost_statement (conn, exec) && db_conn_send_statement (conn, exec))
+            continue;
+
+          conn->watch_id = 0;
+          db_conn_finish_current (conn, error);
+
+          return G_SOURCE_REMOVE;
+        }
+
+      if (exec->on_rows && db_exec_take_rows (exec, res))
+        continue;
+
+      /* Keep the last result of a multi-statement query, but never let a
+       * later result hide an earlier error */
+      if (!exec->result || PQresultStatus (exec->result) != PGRES_FATAL_ERROR)
+        {
+          g_clear_pointer (&exec->result, PQclear);
+          exec->result = res;
+        }
+      else
+        {
+          PQclear (res);
+        }
+    }
+
+  /* Hand over whatever arrived so far, so the first rows paint early */
+  if (exec->on_rows)
+    db_exec_flush_rows (exec);
+
+  return G_SOURCE_CONTINUE;
+}
+
+/* A dropped connection is set up again in the background, which may take
+ * until the connect times out. Queries queued meanwhile wait for it. The
+ * prepared statements are lost with the session. */
+static void
+db_conn_start_reset (DbConn *conn)
+{
+  g_hash_table_remove_all (conn->prepared);
+
+  if (!PQresetStart (conn->pg))
+    {
+      db_conn_fail_pending (conn, PQerrorMessage (conn->pg));
+      return;
+    }
+
+  conn->connecting = TRUE;
+  conn->resetting = TRUE;
+  conn->connect_id = g_unix_fd_add (PQsocket (conn->pg), G_IO_OUT, on_connect_ready, conn);
+}
+
+static void
+db_conn_start_next (DbConn *conn)
+{
+  /* Also runs when a query finishes, so a drop found while reading its
+   * result is repaired before anything else is queued */
+  if (!conn->current && !conn->connecting && PQstatus (conn->pg) == CONNECTION_BAD)
+    {
+      db_conn_start_reset (conn);
+      return;
+    }
+
+  while (!conn->current && !conn->connecting && !g_queue_is_empty (&conn->pending))
+    {
+      GTask *task = g_queue_pop_head (&conn->pending);
+      DbExec *exec = g_task_get_task_data (task);
+
+      if (g_task_return_error_if_cancelled (task))
+        {
+          g_object_unref (task);
+          continue;
+        }
+
+      gboolean sent;
+
+      if (exec->pipeline)
+        {
+          sent = db_conn_send_pipeline (conn, exec);
+        }
+      else if (exec->statement)
+        {
+          sent = db_conn_send_statement (conn, exec);
+        }
+      else
+        {
+          exec->phase = exec->binary ? DB_PHASE_PREPARE : DB_PHASE_EXECUTE;
+          sent = exec->binary ? PQsendPrepare (conn->pg, "", exec->query, 0, NULL)
+                              : PQsendQuery (conn->pg, exec->query);
+        }
+
+      /* Nothing reached the server, so the query can wait for the reset */
+      if (!sent && PQstatus (conn->pg) == CONNECTION_BAD)
+        {
+          g_queue_push_head (&conn->pending, task);
+          db_conn_start_reset (conn);
+          return;
+        }
+
+      if (!sent)
+        {
+          g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_FAILED, "%s",
+                                   PQerrorMessage (conn->pg));
+          g_object_unref (task);
+          continue;
+        }
+
+      if (exec->phase == DB_PHASE_EXECUTE)
+        db_conn_set_row_mode (conn, exec);
+
+      exec->stats.sent = g_get_monotonic_time ();
+
+      conn->current = task;
+      conn->cancel = PQgetCancel (conn->pg);
+
+      if (g_task_get_cancellable (task))
+        exec->cancel_id = g_cancellable_connect (g_task_get_cancellable (task),
+                                                 G_CALLBACK (on_exec_cancelled), conn, NULL);
+
+      conn->watch_id = g_unix_fd_add (PQsocket (conn->pg), G_IO_IN, on_socket_readable, conn);
+    }
+}
+
+static void
+db_conn_queue (DbConn *conn,
+               const char *query,
+               DbExec *exec,
+               GCancellable *cancellable,
+               GAsyncReadyCallback callback,
+               gpointer user_data)
+{
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+
+  exec->query = g_strdup (query);
+  exec->stats.queued = g_get_monotonic_time ();
+
+  g_task_set_task_data (task, exec, db_exec_free);
+
+  g_queue_push_tail (&conn->pending, task);
+
+  db_conn_start_next (conn);
+}
+
+void
+db_conn_exec_async (DbConn *conn,
+                    const char *query,
+                    DbResultFunc convert,
+                    GDestroyNotify result_free,
+                    GCancellable *cancellable,
+                    GAsyncReadyCallback callback,
+                    gpointer user_data)
+{
+  DbExec *exec = g_new0 (DbExec, 1);
+
+  exec->convert = convert;
+  exec->result_free = result_free;
+
+  db_conn_queue (conn, query, exec, cancellable, callback, user_data);
+}
+
+/* Like db_conn_exec_async, for a fixed query the session prepares once
+ * under name and then executes with bound text parameters */
+void
+db_conn_exec_prepared_async (DbConn *conn,
+                             const char *name,
+                             const char *query,
+                             int n_params,
+                             const char *const *params,
+                             DbResultFunc convert,
+                             GDestroyNotify result_free,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data)
+{
+  DbExec *exec = g_new0 (DbExec, 1);
+
+  exec->statement = g_strdup (name);
+  exec->n_params = n_params;
+  exec->params = dup_params (n_params, params);
+
+  exec->convert = convert;
+  exec->result_free = result_free;
+
+  db_conn_queue (conn, query, exec, cancellable, callback, user_data);
+}
+
+/* Runs all steps of pipeline, which the connection takes ownership of,
+ * in one round trip. Fails with the first error; steps after it are
+ * skipped by the server. */
+void
+db_conn_pipeline_async (DbConn *conn,
+                        DbPipeline *pipeline,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
+{
+  DbExec *exec = g_new0 (DbExec, 1);
+
+  exec->pipeline = pipeline;
+
+  db_conn_queue (conn, NULL, exec, cancellable, callback, user_data);
+}
+
+gboolean
+db_conn_pipeline_finish (GAsyncResult *result, GError **error)
+{
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+gpointer
+db_conn_exec_finish (GAsyncResult *result, GError **error)
+{
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+void
+db_conn_stream_async (DbConn *conn,
+                      const char *query,
+                      gboolean binary,
+                      DbRowsFunc on_rows,
+                      gpointer rows_data,
+                      GDestroyNotify rows_data_free,
+                      GCancellable *cancellable,
+                      GAsyncReadyCallback callback,
+                      gpointer user_data)
+{
+  DbExec *exec = g_new0 (DbExec, 1);
+
+  exec->binary = binary;
+  exec->on_rows = on_rows;
+  exec->rows_data = rows_data;
+  exec->rows_data_free = rows_data_free;
+
+  db_conn_queue (conn, query, exec, cancellable, callback, user_data);
+}
+
+/* stats, if set, receives the timings also when the query failed */
+gboolean
+db_conn_stream_finish (GAsyncResult *result, QueryStats *stats, GError **error)
+{
+  DbExec *exec = g_task_get_task_data (G_TASK (result));
+
+  if (stats)
+    *stats = exec->stats;
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#ifndef DB_CONN_H
+#define DB_CONN_H
+
+#include "query_stats.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+#include <libpq-fe.h>
+
+typedef struct _DbConn DbConn;
+
+/* Turns a finished PGresult into the value handed to the finish call,
+ * taking ownership of the result */
+typedef gpointer (*DbResultFunc) (PGresult *res);
+
+/* Receives streamed row batches, taking ownership of them. A NULL batch
+ * means a new statement started and earlier rows should be dropped. */
+typedef void (*DbRowsFunc) (PGresult *batch, gpointer user_data);
+
+/* Receives the result of one pipeline step, taking ownership of it */
+typedef void (*DbStepFunc) (PGresult *res, gpointer user_data);
+
+/* Statements sent together and answered in one round trip */
+typedef struct _DbPipeline DbPipeline;
+
+DbPipeline *db_pipeline_new (void);
+void db_pipeline_free (DbPipeline *pipeline);
+void db_pipeline_add (DbPipeline *pipeline,
+                      const char *query,
+                      int n_params,
+                      const char *const *params,
+                      DbStepFunc on_result,
+                      gpointer user_data);
+
+DbConn *db_conn_new (PGconn *pg);
+void db_conn_free (DbConn *conn);
+
+PGconn *db_conn_get_pg (DbConn *conn);
+guint db_conn_get_load (DbConn *conn);
+
+void db_conn_exec_async (DbConn *conn,
+                         const char *query,
+                         DbResultFunc convert,
+                         GDestroyNotify result_free,
+                         GCancellable *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data);
+void db_conn_exec_prepared_async (DbConn *conn,
+                                  const char *name,
+                                  const char *query,
+                                  int n_params,
+                                  const char *const *params,
+                                  DbResultFunc convert,
+                                  GDestroyNotify result_free,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data);
+gpointer db_conn_exec_finish (GAsyncResult *result, GError **error);
+
+void db_conn_stream_async (DbConn *conn,
+                           const char *query,
+                           gboolean binary,
+                           DbRowsFunc on_rows,
+                           gpointer rows_data,
+                           GDestroyNotify rows_data_free,
+                           GCancellable *cancellable,
+                           GAsyncReadyCallback callback,
+                           gpointer user_data);
+gboolean db_conn_stream_finish (GAsyncResult *result, QueryStats *stats, GError **error);
+
+void db_conn_pipeline_async (DbConn *conn,
+                             DbPipeline *pipeline,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data);
+gboolean db_conn_pipeline_finish (GAsyncResult *result, GError **error);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,626 @@
+#include "db_copy.h"
+
+#include <string.h>
+
+#define COPY_BUFFER_SIZE (1024 * 1024)
+
+/* Import buffers sent between checks for an early error from the server */
+#define ERROR_CHECK_BUFFERS 8
+
+/* Longest wait on the server before cancellation is checked again */
+#define COPY_POLL_MS 100
+
+#define PROGRESS_INTERVAL_US (G_USEC_PER_SEC / 10)
+
+typedef struct
+{
+  DbConfig config;
+  char *statement;
+  char *path;
+
+  /* Imports only: the quoted target and its columns, NULL if unknown */
+  char *table;
+  char **columns;
+  DbCopyFormat format;
+
+  DbCopyProgressFunc progress;
+  gpointer progress_data;
+  gint64 last_progress;
+
+  PGconn *pg;
+  gboolean cancel_sent;
+
+  guint64 rows;
+  guint64 bytes;
+} DbCopy;
+
+typedef struct
+{
+  DbCopyProgressFunc func;
+  gpointer user_data;
+  guint64 rows;
+  guint64 bytes;
+} CopyProgress;
+
+static void
+db_copy_free (gpointer data)
+{
+  DbCopy *copy = data;
+
+  if (copy->pg)
+    PQfinish (copy->pg);
+
+  g_free (copy->statement);
+  g_free (copy->path);
+  g_free (copy->table);
+  g_strfreev (copy->columns);
+  g_free (copy);
+}
+
+static DbCopy *
+db_copy_new (const DbConfig *config,
+             const char *path,
+             DbCopyProgressFunc progress,
+             gpointer progress_data)
+{
+  DbCopy *copy = g_new0 (DbCopy, 1);
+
+  copy->config = *config;
+  copy->path = g_strdup (path);
+  copy->progress = progress;
+  copy->progress_data = progress_data;
+
+  return copy;
+}
+
+DbCopyFormat
+db_copy_format_for_path (const char *path)
+{
+  char *lower = g_ascii_strdown (path, -1);
+  gboolean tsv = g_str_has_suffix (lower, ".tsv") || g_str_has_suffix (lower, ".tab");
+
+  g_free (lower);
+
+  return tsv ? DB_COPY_TSV : DB_COPY_CSV;
+}
+
+static const char *
+db_copy_options (DbCopyFormat format)
+{
+  return format == DB_COPY_TSV ? "FORMAT csv, HEADER, DELIMITER E'\\t'" : "FORMAT csv, HEADER";
+}
+
+static gboolean
+copy_progress_dispatch (gpointer data)
+{
+  CopyProgress *progress = data;
+
+  progress->func (progress->rows, progress->bytes, progress->user_data);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+db_copy_report (DbCopy *copy, GTask *task)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  if (!copy->progress || now - copy->last_progress < PROGRESS_INTERVAL_US)
+    return;
+
+  copy->last_progress = now;
+
+  CopyProgress *progress = g_new (CopyProgress, 1);
+
+  progress->func = copy->progress;
+  progress->user_data = copy->progress_data;
+  progress->rows = copy->rows;
+  progress->bytes = copy->bytes;
+
+  g_main_context_invoke_full (g_task_get_context (task), G_PRIORITY_DEFAULT,
+                              copy_progress_dispatch, progress, g_free);
+}
+
+static void
+db_copy_set_error (DbCopy *copy, PGresult *res, GError **error)
+{
+  const char *message = res ? PQresultErrorMessage (res) : "";
+
+  if (!message[0])
+    message = PQerrorMessage (copy->pg);
+
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED, "%s", message);
+}
+
+static void
+db_copy_cancel (DbCopy *copy)
+{
+  PGcancel *cancel = PQgetCancel (copy->pg);
+  char errbuf[256];
+
+  if (cancel)
+    {
+      PQcancel (cancel, errbuf, sizeof (errbuf));
+      PQfreeCancel (cancel);
+    }
+
+  copy->cancel_sent = TRUE;
+}
+
+/* Waits a little for the server, asking it to stop once the cancellable
+ * fires. FALSE when the connection broke. */
+static gboolean
+db_copy_wait (DbCopy *copy, GCancellable *cancellable)
+{
+  GPollFD fd = { PQsocket (copy->pg), G_IO_IN, 0 };
+
+  g_poll (&fd, 1, COPY_POLL_MS);
+
+  if (!copy->cancel_sent && g_cancellable_is_cancelled (cancellable))
+    db_copy_cancel (copy);
+
+  return PQconsumeInput (copy->pg);
+}
+
+static void
+db_copy_drain (DbCopy *copy)
+{
+  PGresult *res;
+
+  while ((res = PQgetResult (copy->pg)))
+    PQclear (res);
+}
+
+static gboolean
+db_copy_connect (DbCopy *copy, GError **error)
+{
+  copy->pg = db_connect_from_config (&copy->config);
+
+  if (PQstatus (copy->pg) == CONNECTION_OK)
+    return TRUE;
+
+  db_copy_set_error (copy, NULL, error);
+
+  return FALSE;
+}
+
+/* Sends the COPY and waits until the server switches to copy mode */
+static gboolean
+db_copy_start (DbCopy *copy, ExecStatusType expected, GCancellable *cancellable, GError **error)
+{
+  if (!PQsendQuery (copy->pg, copy->statement))
+    {
+      db_copy_set_error (copy, NULL, error);
+      return FALSE;
+    }
+
+  while (PQisBusy (copy->pg) && db_copy_wait (copy, cancellable))
+    ;
+
+  PGresult *res = PQgetResult (copy->pg);
+  gboolean ok = PQresultStatus (res) == expected;
+
+  if (!ok)
+    {
+      db_copy_set_error (copy, res, error);
+      db_copy_drain (copy);
+    }
+
+  PQclear (res);
+
+  return ok;
+}
+
+/* Reads the result the server ends the copy with. Its row count replaces
+ * the one kept for progress. */
+static gboolean
+db_copy_finish_command (DbCopy *copy, GError **error)
+{
+  PGresult *res = PQgetResult (copy->pg);
+  gboolean ok = PQresultStatus (res) == PGRES_COMMAND_OK;
+
+  if (!ok)
+    db_copy_set_error (copy, res, error);
+  else if (*PQcmdTuples (res))
+    copy->rows = g_ascii_strtoull (PQcmdTuples (res), NULL, 10);
+
+  PQclear (res);
+  db_copy_drain (copy);
+
+  return ok;
+}
+
+/* The file is written next to path and only replaces it once complete */
+static GOutputStream *
+db_copy_open_output (const char *path, GCancellable *cancellable, GError **error)
+{
+  GFile *file = g_file_new_for_path (path);
+  GFileOutputStream *stream =
+      g_file_replace (file, NULL, FALSE, G_FILE_CREATE_REPLACE_DESTINATION, cancellable, error);
+
+  g_object_unref (file);
+
+  if (!stream)
+    return NULL;
+
+  GOutputStream *out = g_buffered_output_stream_new_sized (G_OUTPUT_STREAM (stream),
+                                                           COPY_BUFFER_SIZE);
+
+  g_object_unref (stream);
+
+  return out;
+}
+
+/* Closing with a cancelled cancellable drops the partial file, so a failed
+ * export leaves whatever was at path before */
+static void
+db_copy_abort_output (GOutputStream *out)
+{
+  GCancellable *abort = g_cancellable_new ();
+
+  g_cancellable_cancel (abort);
+  g_output_stream_close (out, abort, NULL);
+
+  g_object_unref (abort);
+  g_object_unref (out);
+}
+
+static void
+copy_out_thread (GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+  (void) source;
+
+  DbCopy *copy = task_data;
+  GError *error = NULL;
+
+  GOutputStream *out = db_copy_open_output (copy->path, cancellable, &error);
+
+  if (!out)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  if (!db_copy_connect (copy, &error)
+      || !db_copy_start (copy, PGRES_COPY_OUT, cancellable, &error))
+    {
+      db_copy_abort_output (out);
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* Each buffer is one row, the first is the header. After a write error
+   * the rest is still read, and dropped, until the server has stopped. */
+  for (;;)
+    {
+      char *buf;
+      int len = PQgetCopyData (copy->pg, &buf, TRUE);
+
+      if (len > 0)
+        {
+          if (!error && !g_output_stream_write_all (out, buf, len, NULL, NULL, &error))
+            db_copy_cancel (copy);
+
+          PQfreemem (buf);
+
+          if (copy->bytes > 0)
+            copy->rows++;
+
+          copy->bytes += len;
+          db_copy_report (copy, task);
+          continue;
+        }
+
+      if (len == 0 && db_copy_wait (copy, cancellable))
+        continue;
+
+      break;
+    }
+
+  db_copy_finish_command (copy, error ? NULL : &error);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    {
+      g_clear_error (&error);
+      g_cancellable_set_error_if_cancelled (cancellable, &error);
+    }
+
+  if (error || !g_output_stream_close (out, NULL, &error))
+    {
+      db_copy_abort_output (out);
+      g_task_return_error (task, error);
+      return;
+    }
+
+  g_object_unref (out);
+  g_task_return_boolean (task, TRUE);
+}
+
+/* Writes the rows of query to path, with a header line */
+void
+db_copy_out_async (const DbConfig *config,
+                   const char *query,
+                   const char *path,
+                   DbCopyFormat format,
+                   DbCopyProgressFunc progress,
+                   gpointer progress_data,
+                   GCancellable *cancellable,
+                   GAsyncReadyCallback callback,
+                   gpointer user_data)
+{
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+  DbCopy *copy = db_copy_new (config, path, progress, progress_data);
+
+  copy->statement = g_strdup_printf ("COPY (%s) TO STDOUT WITH (%s)", query,
+                                     db_copy_options (format));
+
+  g_task_set_task_data (task, copy, db_copy_free);
+  g_task_run_in_thread (task, copy_out_thread);
+  g_object_unref (task);
+}
+
+gboolean
+db_copy_out_finish (GAsyncResult *result, guint64 *rows, GError **error)
+{
+  if (!g_task_propagate_boolean (G_TASK (result), error))
+    return FALSE;
+
+  if (rows)
+    *rows = ((DbCopy *) g_task_get_task_data (G_TASK (result)))->rows;
+
+  return TRUE;
+}
+
+/* Splits the header line of a CSV file into its field names */
+static char **
+parse_csv_header (const char *line, gsize len, char delimiter)
+{
+  GPtrArray *fields = g_ptr_array_new ();
+  GString *field = g_string_new (NULL);
+  gboolean quoted = FALSE;
+
+  for (gsize i = 0; i <= len; i++)
+    {
+      char c = i < len ? line[i] : delimiter;
+
+      if (quoted && c == '"' && i + 1 < len && line[i + 1] == '"')
+        {
+          g_string_append_c (field, '"');
+          i++;
+        }
+      else if (c == '"')
+        {
+          quoted = !quoted;
+        }
+      else if (c == delimiter && !quoted)
+        {
+          g_ptr_array_add (fields, g_string_free (field, FALSE));
+          field = g_string_new (NULL);
+        }
+      else if (c != '\r' || quoted)
+        {
+          g_string_append_c (field, c);
+        }
+    }
+
+  g_string_free (field, TRUE);
+  g_ptr_array_add (fields, NULL);
+
+  return (char **) g_ptr_array_free (fields, FALSE);
+}
+
+/* Matches each field of the header to a table column, exactly or else
+ * ignoring case, and returns the escaped column list for the COPY */
+static char *
+db_copy_map_columns (DbCopy *copy, char **header, GError **error)
+{
+  GString *list = g_string_new (NULL);
+
+  for (int i = 0; header[i]; i++)
+    {
+      const char *column = NULL;
+
+      for (int c = 0; copy->columns[c] && !column; c++)
+        if (strcmp (copy->columns[c], header[i]) == 0)
+          column = copy->columns[c];
+
+      for (int c = 0; copy->columns[c] && !column; c++)
+        if (g_ascii_strcasecmp (copy->columns[c], header[i]) == 0)
+          column = copy->columns[c];
+
+      if (!column)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                       "File column \"%s\" is not in table %s", header[i], copy->table);
+          return g_string_free (list, TRUE);
+        }
+
+      char *escaped = PQescapeIdentifier (copy->pg, column, strlen (column));
+
+      g_string_append_printf (list, "%s%s", i > 0 ? ", " : "", escaped);
+      PQfreemem (escaped);
+    }
+
+  return g_string_free (list, FALSE);
+}
+
+/* Builds the COPY from the file's header line, which is sent along with
+ * the rest and skipped by the server */
+static gboolean
+db_copy_prepare_in (DbCopy *copy, const char *data, gsize len, GError **error)
+{
+  const char *newline = memchr (data, '\n', len);
+
+  if (!newline)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "%s",
+                   len == 0 ? "The file is empty" : "The header line is too long");
+      return FALSE;
+    }
+
+  char *columns = NULL;
+
+  if (copy->columns)
+    {
+      char delimiter = copy->format == DB_COPY_TSV ? '\t' : ',';
+      char **header = parse_csv_header (data, newline - data, delimiter);
+
+      columns = db_copy_map_columns (copy, header, error);
+      g_strfreev (header);
+
+      if (!columns)
+        return FALSE;
+    }
+
+  copy->statement = g_strdup_printf ("COPY %s%s%s%s FROM STDIN WITH (%s)", copy->table,
+                                     columns ? " (" : "", columns ? columns : "",
+                                     columns ? ")" : "", db_copy_options (copy->format));
+
+  g_free (columns);
+
+  return TRUE;
+}
+
+/* Anything the server sends during COPY FROM is an error report */
+static gboolean
+db_copy_server_spoke (DbCopy *copy)
+{
+  GPollFD fd = { PQsocket (copy->pg), G_IO_IN, 0 };
+
+  return g_poll (&fd, 1, 0) > 0;
+}
+
+static guint64
+count_lines (const char *data, gsize len)
+{
+  guint64 lines = 0;
+  const char *end = data + len;
+
+  while ((data = memchr (data, '\n', end - data)))
+    {
+      lines++;
+      data++;
+    }
+
+  return lines;
+}
+
+static void
+copy_in_thread (GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+  (void) source;
+
+  DbCopy *copy = task_data;
+  GError *error = NULL;
+  GFile *file = g_file_new_for_path (copy->path);
+  GFileInputStream *in = g_file_read (file, cancellable, &error);
+
+  g_object_unref (file);
+
+  if (!in)
+    {
+      g_task_return_error (task, error);
+      return;
+    }
+
+  char *buf = g_malloc (COPY_BUFFER_SIZE);
+  gssize len = g_input_stream_read (G_INPUT_STREAM (in), buf, COPY_BUFFER_SIZE, cancellable,
+                                    &error);
+
+  if (len < 0 || !db_copy_connect (copy, &error) || !db_copy_prepare_in (copy, buf, len, &error)
+      || !db_copy_start (copy, PGRES_COPY_IN, cancellable, &error))
+    {
+      g_free (buf);
+      g_object_unref (in);
+      g_task_return_error (task, error);
+      return;
+    }
+
+  /* Lines sent, for progress only: quoted fields may span lines. The
+   * header line isn't a row. */
+  gboolean header = TRUE;
+  const char *abort = NULL;
+
+  for (guint sent = 1; len > 0; sent++)
+    {
+      if (PQputCopyData (copy->pg, buf, len) != 1)
+        break;
+
+      guint64 lines = count_lines (buf, len);
+
+      copy->rows += lines - (header && lines > 0);
+      copy->bytes += len;
+      header = header && lines == 0;
+      db_copy_report (copy, task);
+
+      if (g_cancellable_is_cancelled (cancellable))
+        {
+          abort = "Import cancelled";
+          break;
+        }
+
+      /* The server rejected a row and ignores the rest; stop sending */
+      if (sent % ERROR_CHECK_BUFFERS == 0 && db_copy_server_spoke (copy))
+        break;
+
+      len = g_input_stream_read (G_INPUT_STREAM (in), buf, COPY_BUFFER_SIZE, NULL, &error);
+
+      if (len < 0)
+        abort = error->message;
+    }
+
+  /* A read error or cancellation rolls the whole COPY back */
+  if (PQputCopyEnd (copy->pg, abort) == 1)
+    db_copy_finish_command (copy, error ? NULL : &error);
+  else if (!error)
+    db_copy_set_error (copy, NULL, &error);
+
+  if (g_cancellable_is_cancelled (cancellable))
+    {
+      g_clear_error (&error);
+      g_cancellable_set_error_if_cancelled (cancellable, &error);
+    }
+
+  g_free (buf);
+  g_object_unref (in);
+
+  if (error)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+}
+
+/* Appends the rows of a CSV or TSV file with a header line to table, a
+ * quoted and possibly schema qualified name. The header is matched to
+ * columns when they are given, so the file may hold them in any order or
+ * leave some out. The whole file is one COPY: the first bad row aborts it
+ * and nothing is written. */
+void
+db_copy_in_async (const DbConfig *config,
+                  const char *table,
+                  const char *const *columns,
+                  const char *path,
+                  DbCopyFormat format,
+                  DbCopyProgressFunc progress,
+                  gpointer progress_data,
+                  GCancellable *cancellable,
+                  GAsyncReadyCallback callback,
+                  gpointer user_data)
+{
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+  DbCopy *copy = db_copy_new (config, path, progress, progress_data);
+
+  copy->table = g_strdup (table);
+  copy->columns = columns ? g_strdupv ((char **) columns) : NULL;
+  copy->format = format;
+
+  g_task_set_task_data (task, copy, db_copy_free);
+  g_task_run_in_thread (task, copy_in_thread);
+  g_object_unref (task);
+}
+
+gboolean
+db_copy_in_finish (GAsyncResult *result, guint64 *rows, GError **error)
+{
+  return db_copy_out_finish (result, rows, error);
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#ifndef DB_COPY_H
+#define DB_COPY_H
+
+#include "db_config.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+/* Bulk transfers between the server and files through COPY. Each runs on
+ * a worker thread with a connection of its own, moving libpq's buffers
+ * straight to or from the file, so memory use doesn't grow with size. */
+
+typedef enum
+{
+  DB_COPY_CSV,
+  DB_COPY_TSV
+} DbCopyFormat;
+
+/* Called on the main loop now and then while a copy runs */
+typedef void (*DbCopyProgressFunc) (guint64 rows, guint64 bytes, gpointer user_data);
+
+DbCopyFormat db_copy_format_for_path (const char *path);
+
+void db_copy_out_async (const DbConfig *config,
+                        const char *query,
+                        const char *path,
+                        DbCopyFormat format,
+                        DbCopyProgressFunc progress,
+                        gpointer progress_data,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data);
+gboolean db_copy_out_finish (GAsyncResult *result, guint64 *rows, GError **error);
+
+void db_copy_in_async (const DbConfig *config,
+                       const char *table,
+                       const char *const *columns,
+                       const char *path,
+                       DbCopyFormat format,
+                       DbCopyProgressFunc progress,
+                       gpointer progress_data,
+                       GCancellable *cancellable,
+                       GAsyncReadyCallback callback,
+                       gpointer user_data);
+gboolean db_copy_in_finish (GAsyncResult *result, guint64 *rows, GError **error);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "db_pool.h"
+
+#define DEFAULT_POOL_SIZE 3
+
+/* Slot 0 serves the interactive lane, the other slots the background lane.
+ * Slot 0 is connected when the pool is made, at startup before there is a
+ * window to freeze. The others start connecting the first time they are
+ * used, without waiting: queries queue on them until they are up. */
+struct _DbPool
+{
+  DbConfig config;
+
+  int size;
+  DbConn **conns;
+  gboolean *pinned;
+
+  GPtrArray *dedicated;
+};
+
+DbPool *
+db_pool_new (const DbConfig *config)
+{
+  DbPool *pool = g_new0 (DbPool, 1);
+
+  pool->config = *config;
+  pool->size = config->pool_size > 0 ? MAX (config->pool_size, 2) : DEFAULT_POOL_SIZE;
+  pool->conns = g_new0 (DbConn *, pool->size);
+  pool->pinned = g_new0 (gboolean, pool->size);
+  pool->dedicated = g_ptr_array_new_with_free_func ((GDestroyNotify) db_conn_free);
+  pool->conns[0] = db_conn_new (db_connect_from_config (&pool->config));
+
+  return pool;
+}
+
+void
+db_pool_free (DbPool *pool)
+{
+  if (!pool)
+    return;
+
+  g_ptr_array_unref (pool->dedicated);
+
+  for (int i = 0; i < pool->size; i++)
+    db_conn_free (pool->conns[i]);
+
+  g_free (pool->conns);
+  g_free (pool->pinned);
+  g_free (pool);
+}
+
+static DbConn *
+db_pool_slot (DbPool *pool, int slot)
+{
+  if (!pool->conns[slot])
+    pool->conns[slot] = db_conn_new (db_connect_start_from_config (&pool->config));
+
+  return pool->conns[slot];
+}
+
+/* Picks the unpinned background slot that would start a query soonest:
+ * an idle connection, then an unopened slot, then the shortest queue */
+static int
+db_pool_pick_background (DbPool *pool)
+{
+  int best = -1;
+  guint best_load = G_MAXUINT;
+
+  for (int i = 1; i < pool->size; i++)
+    {
+      if (pool->pinned[i])
+        continue;
+
+      guint load = pool->conns[i] ? db_conn_get_load (pool->conns[i]) : 0;
+
+      if (pool->conns[i] && load == 0)
+        return i;
+
+      /* An unopened slot costs a connect, so prefer it only over a queue */
+      if (!pool->conns[i])
+        load = 1;
+
+      if (load < best_load)
+        {
+          best = i;
+          best_load = load;
+        }
+    }
+
+  return best;
+}
+
+DbConn *
+db_pool_get (DbPool *pool, DbLane lane)
+{
+  if (lane == DB_LANE_BACKGROUND)
+    {
+      int slot = db_pool_pick_background (pool);
+
+      if (slot >= 0)
+        return db_pool_slot (pool, slot);
+    }
+
+  return db_pool_slot (pool, 0);
+}
+
+static int
+db_pool_count_shared (DbPool *pool)
+{
+  int shared = 0;
+
+  for (int i = 1; i < pool->size; i++)
+    if (!pool->pinned[i])
+      shared++;
+
+  return shared;
+}
+
+/* Whether a slot can be handed out without its new owner inheriting
+ * queued work or a transaction someone else left open */
+static gboolean
+db_pool_is_clean (DbPool *pool, int slot)
+{
+  DbConn *conn = pool->conns[slot];
+
+  if (!conn)
+    return TRUE;
+
+  PGconn *pg = db_conn_get_pg (conn);
+
+  /* A connection still being made has no transaction yet */
+  return db_conn_get_load (conn) == 0
+         && (PQstatus (pg) != CONNECTION_OK || PQtransactionStatus (pg) == PQTRANS_IDLE);
+}
+
+/* Hands out a connection for exclusive use, e.g. to keep a cursor open.
+ * The background lane always keeps one shared connection; past that, or
+ * when the best slot is busy, the caller gets a dedicated connection
+ * outside the pool. */
+DbConn *
+db_pool_acquire (DbPool *pool)
+{
+  if (db_pool_count_shared (pool) > 1)
+    {
+      int slot = db_pool_pick_background (pool);
+
+      if (db_pool_is_clean (pool, slot))
+        {
+          pool->pinned[slot] = TRUE;
+          return db_pool_slot (pool, slot);
+        }
+    }
+
+  DbConn *conn = db_conn_new (db_connect_start_from_config (&pool->config));
+
+  g_ptr_array_add (pool->dedicated, conn);
+
+  return conn;
+}
+
+void
+db_pool_release (DbPool *pool, DbConn *conn)
+{
+  for (int i = 1; i < pool->size; i++)
+    {
+      if (pool->conns[i] == conn)
+        {
+          pool->pinned[i] = FALSE;
+          return;
+        }
+    }
+
+  g_ptr_array_remove (pool->dedicated, conn);
+}
\ No newline at end of file
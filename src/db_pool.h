@@ -0,0 +1,25 @@
+#ifndef DB_POOL_H
+#define DB_POOL_H
+
+#include "db_config.h"
+#include "db_conn.h"
+
+/* Catalog lookups get a connection of their own, so they never queue
+ * behind long running editor queries */
+typedef enum
+{
+  DB_LANE_INTERACTIVE,
+  DB_LANE_BACKGROUND
+} DbLane;
+
+typedef struct _DbPool DbPool;
+
+DbPool *db_pool_new (const DbConfig *config);
+void db_pool_free (DbPool *pool);
+
+DbConn *db_pool_get (DbPool *pool, DbLane lane);
+
+DbConn *db_pool_acquire (DbPool *pool);
+void db_pool_release (DbPool *pool, DbConn *conn);
+
+#endif
\ No newline at end of file
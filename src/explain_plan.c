@@ -0,0 +1,319 @@
+#include "explain_plan.h"
+
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+#include <string.h>
+
+/* Nodes taking at least this share of the execution time are hot, up to
+ * HOT_NODES of them */
+#define HOT_SHARE 0.1
+#define HOT_NODES 3
+
+struct _ExplainPlan
+{
+  gint ref_count;
+
+  PlanNode *root;
+  double planning_ms;
+  double execution_ms;
+
+  ExplainPlan *baseline;
+};
+
+static void
+plan_node_free (PlanNode *node)
+{
+  for (guint i = 0; i < node->n_children; i++)
+    plan_node_free (node->children[i]);
+
+  g_free (node->children);
+  g_free (node->label);
+  g_free (node->detail);
+  g_free (node);
+}
+
+static char *
+node_label (JsonObject *object)
+{
+  GString *label = g_string_new (NULL);
+  const char *subplan = json_object_get_string_member_with_default (object, "Subplan Name", NULL);
+  const char *join = json_object_get_string_member_with_default (object, "Join Type", NULL);
+  const char *relation =
+      json_object_get_string_member_with_default (object, "Relation Name", NULL);
+  const char *alias = json_object_get_string_member_with_default (object, "Alias", NULL);
+  const char *index = json_object_get_string_member_with_default (object, "Index Name", NULL);
+
+  if (subplan)
+    g_string_append_printf (label, "%s: ", subplan);
+
+  g_string_append (label, json_object_get_string_member_with_default (object, "Node Type", "?"));
+
+  if (join && strcmp (join, "Inner") != 0)
+    g_string_append_printf (label, " (%s)", join);
+
+  if (index)
+    g_string_append_printf (label, " using %s", index);
+
+  if (relation)
+    {
+      g_string_append_printf (label, " on %s", relation);
+
+      if (alias && strcmp (alias, relation) != 0)
+        g_string_append_printf (label, " %s", alias);
+    }
+
+  return g_string_free (label, FALSE);
+}
+
+static char *
+node_detail (JsonObject *object)
+{
+  const char *keys[] = { "Index Cond", "Hash Cond", "Merge Cond", "Recheck Cond",
+                         "Join Filter", "Filter" };
+  GString *detail = g_string_new (NULL);
+
+  for (guint i = 0; i < G_N_ELEMENTS (keys); i++)
+    {
+      const char *value = json_object_get_string_member_with_default (object, keys[i], NULL);
+
+      if (value)
+        g_string_append_printf (detail, "%s%s: %s", detail->len > 0 ? ", " : "", keys[i], value);
+    }
+
+  if (detail->len == 0)
+    {
+      g_string_free (detail, TRUE);
+      return NULL;
+    }
+
+  return g_string_free (detail, FALSE);
+}
+
+/* Per loop figures are averages, so they are multiplied back up. Parallel
+ * workers count as loops and overlap in time, which can leave a Gather
+ * with less time than its children; its self time is then 0. Buffers are
+ * counted with the children's, like time, and hit and read receive those
+ * totals. */
+static PlanNode *
+plan_node_parse (JsonObject *object, gint64 *hit, gint64 *read)
+{
+  PlanNode *node = g_new0 (PlanNode, 1);
+  double loops = json_object_get_double_member_with_default (object, "Actual Loops", 0);
+
+  node->label = node_label (object);
+  node->detail = node_detail (object);
+  node->never_executed = loops == 0;
+  node->total_ms = json_object_get_double_member_with_default (object, "Actual Total Time", 0)
+                   * loops;
+  node->estimated_rows = json_object_get_double_member_with_default (object, "Plan Rows", 0)
+                         * MAX (loops, 1);
+  node->actual_rows = json_object_get_double_member_with_default (object, "Actual Rows", 0)
+                      * loops;
+
+  *hit = json_object_get_int_member_with_default (object, "Shared Hit Blocks", 0);
+  *read = json_object_get_int_member_with_default (object, "Shared Read Blocks", 0);
+
+  JsonArray *plans = json_object_has_member (object, "Plans")
+                         ? json_object_get_array_member (object, "Plans")
+                         : NULL;
+  double child_ms = 0;
+  gint64 child_hit = 0;
+  gint64 child_read = 0;
+
+  node->n_children = plans ? json_array_get_length (plans) : 0;
+  node->children = g_new0 (PlanNode *, MAX (node->n_children, 1));
+
+  for (guint i = 0; i < node->n_children; i++)
+    {
+      gint64 hit_total;
+      gint64 read_total;
+
+      node->children[i] =
+          plan_node_parse (json_array_get_object_element (plans, i), &hit_total, &read_total);
+      child_ms += node->children[i]->total_ms;
+      child_hit += hit_total;
+      child_read += read_total;
+    }
+
+  node->self_ms = MAX (node->total_ms - child_ms, 0);
+  node->hit_blocks = MAX (*hit - child_hit, 0);
+  node->read_blocks = MAX (*read - child_read, 0);
+
+  return node;
+}
+
+static void
+collect_nodes (PlanNode *node, GPtrArray *nodes)
+{
+  g_ptr_array_add (nodes, node);
+
+  for (guint i = 0; i < node->n_children; i++)
+    collect_nodes (node->children[i], nodes);
+}
+
+static gint
+compare_self_time (gconstpointer a, gconstpointer b)
+{
+  const PlanNode *na = *(PlanNode *const *) a;
+  const PlanNode *nb = *(PlanNode *const *) b;
+
+  return (na->self_ms < nb->self_ms) - (na->self_ms > nb->self_ms);
+}
+
+static void
+explain_plan_mark_hot (ExplainPlan *plan)
+{
+  GPtrArray *nodes = g_ptr_array_new ();
+
+  collect_nodes (plan->root, nodes);
+  g_ptr_array_sort (nodes, compare_self_time);
+
+  for (guint i = 0; i < MIN (nodes->len, HOT_NODES); i++)
+    {
+      PlanNode *node = g_ptr_array_index (nodes, i);
+
+      if (node->self_ms >= HOT_SHARE * plan->execution_ms && node->self_ms > 0)
+        node->hot = TRUE;
+    }
+
+  g_ptr_array_unref (nodes);
+}
+
+/* Parses the single row EXPLAIN returns in FORMAT JSON */
+ExplainPlan *
+explain_plan_parse (const char *json, GError **error)
+{
+  JsonParser *parser = json_parser_new ();
+  ExplainPlan *plan = NULL;
+
+  if (!json_parser_load_from_data (parser, json, -1, error))
+    goto out;
+
+  JsonNode *root = json_parser_get_root (parser);
+  JsonArray *array = root && JSON_NODE_HOLDS_ARRAY (root) ? json_node_get_array (root) : NULL;
+  JsonObject *object = array && json_array_get_length (array) > 0
+                           ? json_array_get_object_element (array, 0)
+                           : NULL;
+
+  if (!object || !json_object_has_member (object, "Plan"))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "EXPLAIN returned no plan");
+      goto out;
+    }
+
+  plan = g_new0 (ExplainPlan, 1);
+  plan->ref_count = 1;
+  gint64 hit;
+  gint64 read;
+
+  plan->root = plan_node_parse (json_object_get_object_member (object, "Plan"), &hit, &read);
+  plan->planning_ms = json_object_get_double_member_with_default (object, "Planning Time", 0);
+  plan->execution_ms = json_object_get_double_member_with_default (object, "Execution Time",
+                                                                   plan->root->total_ms);
+
+  explain_plan_mark_hot (plan);
+
+out:
+  g_object_unref (parser);
+
+  return plan;
+}
+
+ExplainPlan *
+explain_plan_ref (ExplainPlan *plan)
+{
+  g_atomic_int_inc (&plan->ref_count);
+
+  return plan;
+}
+
+void
+explain_plan_unref (ExplainPlan *plan)
+{
+  if (!g_atomic_int_dec_and_test (&plan->ref_count))
+    return;
+
+  g_clear_pointer (&plan->baseline, explain_plan_unref);
+  plan_node_free (plan->root);
+  g_free (plan);
+}
+
+const PlanNode *
+explain_plan_get_root (ExplainPlan *plan)
+{
+  return plan->root;
+}
+
+double
+explain_plan_get_planning_ms (ExplainPlan *plan)
+{
+  return plan->planning_ms;
+}
+
+double
+explain_plan_get_execution_ms (ExplainPlan *plan)
+{
+  return plan->execution_ms;
+}
+
+/* Nodes pair up while both plans have the same shape, so a changed
+ * subtree is left out of the comparison and the rest still lines up */
+static void
+match_nodes (PlanNode *node, const PlanNode *baseline)
+{
+  if (strcmp (node->label, baseline->label) != 0)
+    return;
+
+  node->baseline = baseline;
+
+  if (node->n_children != baseline->n_children)
+    return;
+
+  for (guint i = 0; i < node->n_children; i++)
+    match_nodes (node->children[i], baseline->children[i]);
+}
+
+static void
+clear_matches (PlanNode *node)
+{
+  node->baseline = NULL;
+
+  for (guint i = 0; i < node->n_children; i++)
+    clear_matches (node->children[i]);
+}
+
+/* Compares plan against baseline, usually an earlier run of the same
+ * query, which may be NULL. The plan keeps a reference to it. */
+void
+explain_plan_set_baseline (ExplainPlan *plan, ExplainPlan *baseline)
+{
+  if (baseline == plan)
+    return;
+
+  clear_matches (plan->root);
+  g_clear_pointer (&plan->baseline, explain_plan_unref);
+
+  if (!baseline)
+    return;
+
+  /* A plan never needs its baseline's own, so chains don't build up */
+  plan->baseline = explain_plan_ref (baseline);
+  g_clear_pointer (&baseline->baseline, explain_plan_unref);
+  clear_matches (baseline->root);
+
+  match_nodes (plan->root, baseline->root);
+}
+
+ExplainPlan *
+explain_plan_get_baseline (ExplainPlan *plan)
+{
+  return plan->baseline;
+}
+
+/* Actual rows over estimated ones, each counted as at least one: above 1
+ * the planner underestimated, below it overestimated */
+double
+plan_node_estimate_error (const PlanNode *node)
+{
+  return MAX (node->actual_rows, 1) / MAX (node->estimated_rows, 1);
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#ifndef EXPLAIN_PLAN_H
+#define EXPLAIN_PLAN_H
+
+#include <glib.h>
+
+/* One step of a plan from EXPLAIN (ANALYZE, BUFFERS, FORMAT JSON). Times
+ * and rows are summed over every loop the node ran, so they add up the
+ * way the node's cost did. */
+typedef struct _PlanNode PlanNode;
+struct _PlanNode
+{
+  /* "Seq Scan on orders o", "Hash Join" */
+  char *label;
+  /* The node's condition or filter, NULL when it has none */
+  char *detail;
+
+  double total_ms;
+  /* total_ms less that of the children, never below 0 */
+  double self_ms;
+  double estimated_rows;
+  double actual_rows;
+  gboolean never_executed;
+
+  /* Shared buffers of this node alone */
+  gint64 hit_blocks;
+  gint64 read_blocks;
+
+  /* Among the nodes most of the time went to */
+  gboolean hot;
+  /* The same node in the plan compared against, or NULL */
+  const PlanNode *baseline;
+
+  guint n_children;
+  PlanNode **children;
+};
+
+typedef struct _ExplainPlan ExplainPlan;
+
+ExplainPlan *explain_plan_parse (const char *json, GError **error);
+ExplainPlan *explain_plan_ref (ExplainPlan *plan);
+void explain_plan_unref (ExplainPlan *plan);
+
+const PlanNode *explain_plan_get_root (ExplainPlan *plan);
+double explain_plan_get_planning_ms (ExplainPlan *plan);
+double explain_plan_get_execution_ms (ExplainPlan *plan);
+
+void explain_plan_set_baseline (ExplainPlan *plan, ExplainPlan *baseline);
+ExplainPlan *explain_plan_get_baseline (ExplainPlan *plan);
+
+double plan_node_estimate_error (const PlanNode *node);
+
+#endif
\ No newline at end of file
@@ -4,8 +4,11 @@ struct _GenericRow
 {
   GObject parent_instance;
 
-  int n_columns;
-  char **values;
+  ResultSet *set;
+  guint index;
+
+  /* Native cells are formatted in here when bound */
+  char buf[64];
 };
 
 G_DEFINE_TYPE (GenericRow, generic_row, G_TYPE_OBJECT)
@@ -15,13 +18,7 @@ generic_row_dispose (GObject *object)
 {
   GenericRow *row = GENERIC_ROW (object);
 
-  if (row->values)
-    {
-      for (int i = 0; i < row->n_columns; i++)
-        g_free (row->values[i]);
-
-      g_free (row->values);
-    }
+  g_clear_pointer (&row->set, result_set_unref);
 
   G_OBJECT_CLASS (generic_row_parent_class)->dispose (object);
 }
@@ -37,41 +34,35 @@ generic_row_class_init (GenericRowClass *klass)
 static void
 generic_row_init (GenericRow *self)
 {
-  self->n_columns = 0;
-  self->values = NULL;
+  self->set = NULL;
+  self->index = 0;
 }
 
 GenericRow *
-generic_row_new (int n_columns)
+generic_row_new (ResultSet *set, guint index)
 {
   GenericRow *row = g_object_new (TYPE_GENERIC_ROW, NULL);
 
-  row->n_columns = n_columns;
-  row->values = g_new0 (char *, n_columns);
+  row->set = set ? result_set_ref (set) : NULL;
+  row->index = index;
 
   return row;
 }
 
-void
-generic_row_set_value (GenericRow *row, int index, const char *value)
-{
-  if (index >= row->n_columns)
-    return;
-
-  row->values[index] = g_strdup (value);
-}
-
 const char *
 generic_row_get_value (GenericRow *row, int index)
 {
-  if (index >= row->n_columns)
+  if (!row->set)
     return "";
 
-  return row->values[index];
+  return result_set_format_value (row->set, row->index, index, row->buf, sizeof (row->buf));
 }
 
 int
 generic_row_get_n_columns (GenericRow *row)
 {
-  return row->n_columns;
+  if (!row->set)
+    return 0;
+
+  return result_set_get_n_columns (row->set);
 }
\ No newline at end of file
@@ -0,0 +1,462 @@
+#include "paged-model.h"
+#include "db.h"
+#include "generic-row.h"
+
+/* GListModel over a server-side cursor. Rows are fetched a page at a time
+ * as the view scrolls towards the end, and pages far away from the visible
+ * range are dropped again and refetched on demand. */
+
+#define PAGE_SIZE 500
+#define KEEP_PAGES 4
+
+typedef struct
+{
+  ResultSet *set;
+  guint n_rows;
+  gboolean loading;
+} Page;
+
+typedef struct
+{
+  PagedModel *model;
+  guint index;
+} PageLoad;
+
+struct _PagedModel
+{
+  GObject parent_instance;
+
+  GArray *pages;
+  guint n_items;
+
+  char **column_names;
+  Oid *column_types;
+  /* The result's last column is the row id, kept out of the names */
+  gboolean has_row_id;
+  gboolean complete;
+  gint64 estimated_rows;
+  gint64 cached_at;
+
+  GCancellable *cancellable;
+};
+
+enum
+{
+  REFRESHED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+/* The model the browse cursor was last opened for */
+static PagedModel *browsing = NULL;
+
+static void paged_model_list_model_init (GListModelInterface *iface);
+static void paged_model_load_page (PagedModel *model, guint index);
+
+G_DEFINE_TYPE_WITH_CODE (PagedModel,
+                         paged_model,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, paged_model_list_model_init))
+
+static GType
+paged_model_get_item_type (GListModel *list)
+{
+  (void) list;
+
+  return TYPE_GENERIC_ROW;
+}
+
+static guint
+paged_model_get_n_items (GListModel *list)
+{
+  return PAGED_MODEL (list)->n_items;
+}
+
+static gpointer
+paged_model_get_item (GListModel *list, guint position)
+{
+  PagedModel *model = PAGED_MODEL (list);
+
+  if (position >= model->n_items)
+    return NULL;
+
+  guint index = position / PAGE_SIZE;
+  Page *page = &g_array_index (model->pages, Page, index);
+
+  /* Evicted page: hand out an empty row now and rebind once it is back */
+  if (!page->set)
+    {
+      paged_model_load_page (model, index);
+      return generic_row_new (NULL, 0);
+    }
+
+  return generic_row_new (page->set, position % PAGE_SIZE);
+}
+
+static void
+paged_model_list_model_init (GListModelInterface *iface)
+{
+  iface->get_item_type = paged_model_get_item_type;
+  iface->get_n_items = paged_model_get_n_items;
+  iface->get_item = paged_model_get_item;
+}
+
+static void
+page_clear (gpointer data)
+{
+  Page *page = data;
+
+  g_clear_pointer (&page->set, result_set_unref);
+}
+
+static void
+paged_model_dispose (GObject *object)
+{
+  PagedModel *model = PAGED_MODEL (object);
+
+  paged_model_close (model);
+
+  g_clear_pointer (&model->pages, g_array_unref);
+  g_clear_pointer (&model->column_names, g_strfreev);
+  g_clear_pointer (&model->column_types, g_free);
+  g_clear_object (&model->cancellable);
+
+  G_OBJECT_CLASS (paged_model_parent_class)->dispose (object);
+}
+
+static void
+paged_model_class_init (PagedModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = paged_model_dispose;
+
+  /* The cached first page was replaced by the server's */
+  signals[REFRESHED] = g_signal_new ("refreshed", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
+                                     0, NULL, NULL, NULL, G_TYPE_NONE, 0);
+}
+
+static void
+paged_model_init (PagedModel *self)
+{
+  self->pages = g_array_new (FALSE, TRUE, sizeof (Page));
+  g_array_set_clear_func (self->pages, page_clear);
+
+  self->cancellable = g_cancellable_new ();
+  self->estimated_rows = -1;
+}
+
+PagedModel *
+paged_model_new (void)
+{
+  return g_object_new (TYPE_PAGED_MODEL, NULL);
+}
+
+/* Stores a freshly fetched page and announces the rows it added or
+ * brought back */
+static void
+paged_model_fill_page (PagedModel *model, guint index, ResultSet *set)
+{
+  Page *page = &g_array_index (model->pages, Page, index);
+  guint n_rows = result_set_get_n_rows (set);
+  gboolean appended = page->n_rows == 0;
+
+  page->loading = FALSE;
+
+  if (appended)
+    {
+      if (n_rows < PAGE_SIZE)
+        model->complete = TRUE;
+
+      if (n_rows == 0)
+        {
+          result_set_unref (set);
+          g_array_set_size (model->pages, index);
+          return;
+        }
+
+      page->set = set;
+      page->n_rows = n_rows;
+      model->n_items += n_rows;
+
+      g_list_model_items_changed (G_LIST_MODEL (model), index * PAGE_SIZE, 0, n_rows);
+      return;
+    }
+
+  page->set = set;
+
+  g_list_model_items_changed (G_LIST_MODEL (model), index * PAGE_SIZE, page->n_rows,
+                              page->n_rows);
+}
+
+static void
+on_page_loaded (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  PageLoad *load = user_data;
+  PagedModel *model = load->model;
+  GError *error = NULL;
+
+  ResultSet *set = db_browse_fetch_finish (result, &error);
+
+  if (error)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_printerr ("Page fetch failed: %s", error->message);
+
+      g_error_free (error);
+
+      if (model->pages && load->index < model->pages->len)
+        {
+          Page *page = &g_array_index (model->pages, Page, load->index);
+
+          page->loading = FALSE;
+
+          if (page->n_rows == 0)
+            g_array_set_size (model->pages, load->index);
+        }
+    }
+  else
+    {
+      paged_model_fill_page (model, load->index, set);
+    }
+
+  g_object_unref (load->model);
+  g_free (load);
+}
+
+static void
+paged_model_load_page (PagedModel *model, guint index)
+{
+  Page *page = &g_array_index (model->pages, Page, index);
+
+  if (page->loading)
+    return;
+
+  page->loading = TRUE;
+
+  PageLoad *load = g_new0 (PageLoad, 1);
+
+  load->model = g_object_ref (model);
+  load->index = index;
+
+  db_browse_fetch_async (index * PAGE_SIZE, PAGE_SIZE, model->cancellable, on_page_loaded, load);
+}
+
+void
+paged_model_load_more (PagedModel *model)
+{
+  if (model->complete || model->pages->len == 0)
+    return;
+
+  Page *last = &g_array_index (model->pages, Page, model->pages->len - 1);
+
+  if (last->loading && last->n_rows == 0)
+    return;
+
+  g_array_set_size (model->pages, model->pages->len + 1);
+
+  paged_model_load_page (model, model->pages->len - 1);
+}
+
+void
+paged_model_set_visible_range (PagedModel *model, guint first, guint last)
+{
+  guint first_page = first / PAGE_SIZE;
+  guint last_page = last / PAGE_SIZE;
+
+  for (guint i = 0; i < model->pages->len; i++)
+    {
+      if (i + KEEP_PAGES >= first_page && i <= last_page + KEEP_PAGES)
+        continue;
+
+      g_clear_pointer (&g_array_index (model->pages, Page, i).set, result_set_unref);
+    }
+}
+
+static void
+on_first_page_refreshed (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  PagedModel *model = user_data;
+  GError *error = NULL;
+
+  ResultSet *set = db_browse_fetch_finish (result, &error);
+
+  if (error)
+    {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        g_printerr ("Page fetch failed: %s", error->message);
+
+      g_error_free (error);
+      g_object_unref (model);
+      return;
+    }
+
+  if (!model->pages || model->pages->len == 0)
+    {
+      result_set_unref (set);
+      g_object_unref (model);
+      return;
+    }
+
+  Page *page = &g_array_index (model->pages, Page, 0);
+  guint old_rows = page->n_rows;
+  guint n_rows = result_set_get_n_rows (set);
+
+  g_clear_pointer (&page->set, result_set_unref);
+  page->set = set;
+  page->n_rows = n_rows;
+  model->n_items = model->n_items - old_rows + n_rows;
+  model->cached_at = 0;
+
+  if (model->pages->len == 1)
+    model->complete = n_rows < PAGE_SIZE;
+
+  g_list_model_items_changed (G_LIST_MODEL (model), 0, old_rows, n_rows);
+  g_signal_emit (model, signals[REFRESHED], 0);
+
+  g_object_unref (model);
+}
+
+static void
+on_open_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  GTask *task = user_data;
+  PagedModel *model = g_task_get_source_object (task);
+  GError *error = NULL;
+
+  ResultSet *set = db_browse_open_finish (result, &model->estimated_rows, &model->cached_at,
+                                          &error);
+
+  if (error)
+    {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+      return;
+    }
+
+  model->column_names = result_set_dup_column_names (set);
+  model->column_types = result_set_dup_column_types (set);
+
+  if (model->has_row_id)
+    {
+      int last = result_set_get_n_columns (set) - 1;
+
+      g_clear_pointer (&model->column_names[last], g_free);
+    }
+
+  g_array_set_size (model->pages, 1);
+  paged_model_fill_page (model, 0, set);
+
+  /* The cached page shows until the cursor's own first page replaces it,
+   * so later pages continue from rows read in the same snapshot */
+  if (model->cached_at)
+    db_browse_fetch_async (0, PAGE_SIZE, model->cancellable, on_first_page_refreshed,
+                           g_object_ref (model));
+
+  g_task_return_boolean (task, TRUE);
+  g_object_unref (task);
+}
+
+/* The cursor is sorted by the server, so sorting covers every row and not
+ * just the pages fetched so far. Only the first page may come from the
+ * cache. */
+void
+paged_model_open_async (PagedModel *model,
+                        const CatalogTable *table,
+                        const DbSample *sample,
+                        const char *order_by,
+                        gboolean descending,
+                        gboolean bypass_cache,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data)
+{
+  GTask *task = g_task_new (model, cancellable, callback, user_data);
+
+  model->has_row_id = db_browse_has_row_id (table);
+  browsing = model;
+
+  db_browse_open_async (table, sample, order_by, descending, PAGE_SIZE, bypass_cache,
+                        cancellable, on_open_ready, task);
+}
+
+gboolean
+paged_model_open_finish (PagedModel *model, GAsyncResult *result, GError **error)
+{
+  (void) model;
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* Drops any page loads still queued for this model and, unless another
+ * model has opened it since, closes the cursor */
+void
+paged_model_close (PagedModel *model)
+{
+  if (model->cancellable)
+    g_cancellable_cancel (model->cancellable);
+
+  if (browsing != model)
+    return;
+
+  browsing = NULL;
+  db_browse_close ();
+}
+
+/* The id of the row at position, for db_fetch_value_async. NULL when the
+ * table has none or the row's page is not loaded. */
+char *
+paged_model_dup_row_id (PagedModel *model, guint position)
+{
+  if (!model->has_row_id || position >= model->n_items)
+    return NULL;
+
+  Page *page = &g_array_index (model->pages, Page, position / PAGE_SIZE);
+
+  if (!page->set)
+    return NULL;
+
+  int last = result_set_get_n_columns (page->set) - 1;
+
+  return g_strdup (result_set_get_text (page->set, position % PAGE_SIZE, last));
+}
+
+const char *const *
+paged_model_get_column_names (PagedModel *model)
+{
+  return (const char *const *) model->column_names;
+}
+
+const Oid *
+paged_model_get_column_types (PagedModel *model)
+{
+  return model->column_types;
+}
+
+gboolean
+paged_model_is_complete (PagedModel *model)
+{
+  return model->complete;
+}
+
+/* The planner's row count for the table, or -1 if it has none */
+gint64
+paged_model_get_estimated_rows (PagedModel *model)
+{
+  return model->estimated_rows;
+}
+
+/* Monotonic time the first page was fetched when it came from the cache,
+ * 0 when it came from the server or has been refetched since */
+gint64
+paged_model_get_cached_at (PagedModel *model)
+{
+  return model->cached_at;
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef PAGED_MODEL_H
+#define PAGED_MODEL_H
+
+#include "catalog.h"
+#include "db.h"
+
+#include <gio/gio.h>
+#include <libpq-fe.h>
+
+#define TYPE_PAGED_MODEL (paged_model_get_type ())
+G_DECLARE_FINAL_TYPE (PagedModel, paged_model, PAGED, MODEL, GObject)
+
+PagedModel *paged_model_new (void);
+
+void paged_model_open_async (PagedModel *model,
+                             const CatalogTable *table,
+                             const DbSample *sample,
+                             const char *order_by,
+                             gboolean descending,
+                             gboolean bypass_cache,
+                             GCancellable *cancellable,
+                             GAsyncReadyCallback callback,
+                             gpointer user_data);
+gboolean paged_model_open_finish (PagedModel *model, GAsyncResult *result, GError **error);
+void paged_model_close (PagedModel *model);
+
+void paged_model_load_more (PagedModel *model);
+void paged_model_set_visible_range (PagedModel *model, guint first, guint last);
+
+char *paged_model_dup_row_id (PagedModel *model, guint position);
+
+const char *const *paged_model_get_column_names (PagedModel *model);
+const Oid *paged_model_get_column_types (PagedModel *model);
+gboolean paged_model_is_complete (PagedModel *model);
+gint64 paged_model_get_estimated_rows (PagedModel *model);
+gint64 paged_model_get_cached_at (PagedModel *model);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,547 @@
+#include "pg_types.h"
+
+#include <libpq-events.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Postgres dates and timestamps count from 2000-01-01 */
+#define PG_EPOCH_JDATE 2451545
+#define UNIX_EPOCH_JDATE 2440588
+#define USECS_PER_DAY G_GINT64_CONSTANT (86400000000)
+
+#define NUMERIC_NEG 0x4000
+#define NUMERIC_NAN 0xC000
+#define NUMERIC_PINF 0xD000
+#define NUMERIC_NINF 0xF000
+
+/* A connection's TimeZone setting, which the server reports on connect
+ * and on every change */
+typedef struct
+{
+  char *name;
+  GTimeZone *zone;
+} SessionZone;
+
+static guint16
+read_u16 (const char *data)
+{
+  guint16 v;
+
+  memcpy (&v, data, sizeof (v));
+  return GUINT16_FROM_BE (v);
+}
+
+static guint32
+read_u32 (const char *data)
+{
+  guint32 v;
+
+  memcpy (&v, data, sizeof (v));
+  return GUINT32_FROM_BE (v);
+}
+
+static guint64
+read_u64 (const char *data)
+{
+  guint64 v;
+
+  memcpy (&v, data, sizeof (v));
+  return GUINT64_FROM_BE (v);
+}
+
+gboolean
+pg_type_has_binary_decoder (Oid type)
+{
+  switch (type)
+    {
+    case BOOLOID:
+    case BYTEAOID:
+    case CHAROID:
+    case NAMEOID:
+    case INT8OID:
+    case INT2OID:
+    case INT4OID:
+    case TEXTOID:
+    case OIDOID:
+    case JSONOID:
+    case XMLOID:
+    case FLOAT4OID:
+    case FLOAT8OID:
+    case BPCHAROID:
+    case VARCHAROID:
+    case DATEOID:
+    case TIMEOID:
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID:
+    case NUMERICOID:
+    case UUIDOID:
+    case JSONBOID:
+      return TRUE;
+    default:
+      return FALSE;
+    }
+}
+
+/* Fixed-width types that are kept in native form instead of as text */
+PgKind
+pg_type_native_kind (Oid type)
+{
+  switch (type)
+    {
+    case INT2OID:
+    case INT4OID:
+    case INT8OID:
+    case OIDOID:
+      return PG_KIND_INT;
+    case FLOAT4OID:
+      return PG_KIND_FLOAT4;
+    case FLOAT8OID:
+      return PG_KIND_FLOAT;
+    case BOOLOID:
+      return PG_KIND_BOOL;
+    case DATEOID:
+      return PG_KIND_DATE;
+    case TIMEOID:
+      return PG_KIND_TIME;
+    case TIMESTAMPOID:
+      return PG_KIND_TIMESTAMP;
+    case TIMESTAMPTZOID:
+      return PG_KIND_TIMESTAMPTZ;
+    default:
+      return PG_KIND_TEXT;
+    }
+}
+
+PgNative
+pg_binary_read_native (Oid type, const char *data)
+{
+  PgNative value = { 0 };
+
+  switch (type)
+    {
+    case INT2OID:
+      value.i = (gint16) read_u16 (data);
+      break;
+    case INT4OID:
+    case DATEOID:
+      value.i = (gint32) read_u32 (data);
+      break;
+    case OIDOID:
+      value.i = read_u32 (data);
+      break;
+    case INT8OID:
+    case TIMEOID:
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID:
+      value.i = (gint64) read_u64 (data);
+      break;
+    case FLOAT4OID:
+      {
+        guint32 bits = read_u32 (data);
+        float f;
+
+        memcpy (&f, &bits, sizeof (f));
+        value.f = f;
+        break;
+      }
+    case FLOAT8OID:
+      {
+        guint64 bits = read_u64 (data);
+
+        memcpy (&value.f, &bits, sizeof (value.f));
+        break;
+      }
+    case BOOLOID:
+      value.i = data[0] != 0;
+      break;
+    default:
+      break;
+    }
+
+  return value;
+}
+
+static void
+append_numeric (GString *out, const char *data, int len)
+{
+  if (len < 8)
+    return;
+
+  int ndigits = (gint16) read_u16 (data);
+  int weight = (gint16) read_u16 (data + 2);
+  guint16 sign = read_u16 (data + 4);
+  int dscale = read_u16 (data + 6);
+
+  switch (sign)
+    {
+    case NUMERIC_NAN:
+      g_string_append (out, "NaN");
+      return;
+    case NUMERIC_PINF:
+      g_string_append (out, "Infinity");
+      return;
+    case NUMERIC_NINF:
+      g_string_append (out, "-Infinity");
+      return;
+    default:
+      break;
+    }
+
+  if (len < 8 + ndigits * 2)
+    return;
+
+  /* Digits are base 10000, the first one sits at position weight */
+  if (sign == NUMERIC_NEG)
+    g_string_append_c (out, '-');
+
+  if (weight < 0)
+    {
+      g_string_append_c (out, '0');
+    }
+  else
+    {
+      for (int i = 0; i <= weight; i++)
+        {
+          int digit = i < ndigits ? read_u16 (data + 8 + i * 2) : 0;
+
+          g_string_append_printf (out, i == 0 ? "%d" : "%04d", digit);
+        }
+    }
+
+  if (dscale <= 0)
+    return;
+
+  g_string_append_c (out, '.');
+
+  for (int i = weight + 1, written = 0; written < dscale; i++)
+    {
+      int digit = i >= 0 && i < ndigits ? read_u16 (data + 8 + i * 2) : 0;
+      char group[5];
+
+      g_snprintf (group, sizeof (group), "%04d", digit);
+
+      for (int k = 0; k < 4 && written < dscale; k++, written++)
+        g_string_append_c (out, group[k]);
+    }
+}
+
+/* Renders a variable-width binary value the way the text protocol would */
+void
+pg_binary_append_text (GString *out, Oid type, const char *data, int len)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  switch (type)
+    {
+    case NUMERICOID:
+      append_numeric (out, data, len);
+      break;
+    case UUIDOID:
+      for (int i = 0; i < len; i++)
+        {
+          if (i == 4 || i == 6 || i == 8 || i == 10)
+            g_string_append_c (out, '-');
+
+          g_string_append_c (out, hex[(guint8) data[i] >> 4]);
+          g_string_append_c (out, hex[(guint8) data[i] & 0xf]);
+        }
+      break;
+    case BYTEAOID:
+      g_string_append (out, "\\x");
+
+      for (int i = 0; i < len; i++)
+        {
+          g_string_append_c (out, hex[(guint8) data[i] >> 4]);
+          g_string_append_c (out, hex[(guint8) data[i] & 0xf]);
+        }
+      break;
+    case JSONBOID:
+      /* Leading version byte, then the JSON text */
+      if (len > 0)
+        g_string_append_len (out, data + 1, len - 1);
+      break;
+    default:
+      g_string_append_len (out, data, len);
+      break;
+    }
+}
+
+/* Days since 2000-01-01 to a proleptic Gregorian date */
+static void
+civil_from_days (gint64 days, gint64 *year, int *month, int *day)
+{
+  gint64 z = days + 730425;
+  gint64 era = (z >= 0 ? z : z - 146096) / 146097;
+  gint64 doe = z - era * 146097;
+  gint64 yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  gint64 doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  gint64 mp = (5 * doy + 2) / 153;
+
+  *day = doy - (153 * mp + 2) / 5 + 1;
+  *month = mp < 10 ? mp + 3 : mp - 9;
+  *year = yoe + era * 400 + (*month <= 2);
+}
+
+static void
+split_usecs (gint64 usecs, gint64 *days, int *hour, int *min, int *sec, int *frac)
+{
+  *days = usecs / USECS_PER_DAY;
+  usecs %= USECS_PER_DAY;
+
+  if (usecs < 0)
+    {
+      usecs += USECS_PER_DAY;
+      (*days)--;
+    }
+
+  *frac = usecs % G_USEC_PER_SEC;
+  usecs /= G_USEC_PER_SEC;
+  *sec = usecs % 60;
+  *min = (usecs / 60) % 60;
+  *hour = usecs / 3600;
+}
+
+/* Returns TRUE for BC dates, which Postgres marks with a trailing " BC" */
+static gboolean
+format_date (char *buf, gsize size, gint64 days)
+{
+  gint64 year;
+  int month, day;
+
+  civil_from_days (days, &year, &month, &day);
+
+  gboolean bc = year <= 0;
+
+  g_snprintf (buf, size, "%04" G_GINT64_FORMAT "-%02d-%02d", bc ? 1 - year : year, month, day);
+
+  return bc;
+}
+
+static void
+format_time (char *buf, gsize size, int hour, int min, int sec, int frac)
+{
+  if (frac == 0)
+    {
+      g_snprintf (buf, size, "%02d:%02d:%02d", hour, min, sec);
+      return;
+    }
+
+  int n = g_snprintf (buf, size, "%02d:%02d:%02d.%06d", hour, min, sec, frac);
+
+  /* Postgres drops trailing zeros of the fraction */
+  while (n > 0 && buf[n - 1] == '0')
+    buf[--n] = '\0';
+}
+
+static void
+format_offset (char *buf, gsize size, GTimeSpan offset)
+{
+  char sign = offset < 0 ? '-' : '+';
+  gint64 minutes = ABS (offset) / G_TIME_SPAN_MINUTE;
+
+  if (minutes % 60 == 0)
+    g_snprintf (buf, size, "%c%02d", sign, (int) (minutes / 60));
+  else
+    g_snprintf (buf, size, "%c%02d:%02d", sign, (int) (minutes / 60), (int) (minutes % 60));
+}
+
+/* Shortest representation that reads back as the same value, which is
+ * what Postgres prints since version 12 */
+static void
+format_float (char *buf, gsize size, double value, gboolean single)
+{
+  if (isnan (value))
+    {
+      g_strlcpy (buf, "NaN", size);
+      return;
+    }
+
+  if (isinf (value))
+    {
+      g_strlcpy (buf, value > 0 ? "Infinity" : "-Infinity", size);
+      return;
+    }
+
+  for (int precision = single ? 6 : 15; precision <= 17; precision++)
+    {
+      char format[8];
+
+      g_snprintf (format, sizeof (format), "%%.%dg", precision);
+      g_ascii_formatd (buf, size, format, value);
+
+      double back = g_ascii_strtod (buf, NULL);
+
+      if (single ? (float) back == (float) value : back == value)
+        return;
+    }
+}
+
+static GTimeZone *
+session_zone_get (SessionZone *session, PGconn *pg)
+{
+  const char *name = PQparameterStatus (pg, "TimeZone");
+
+  if (g_strcmp0 (name, session->name) != 0)
+    {
+      g_free (session->name);
+      session->name = g_strdup (name);
+      g_clear_pointer (&session->zone, g_time_zone_unref);
+
+      if (name)
+        session->zone = g_time_zone_new_identifier (name);
+    }
+
+  return session->zone;
+}
+
+/* Each result carries a reference to the zone its connection was in when
+ * it was made, as the instance data of this event proc */
+static int
+on_session_event (PGEventId id, void *info, void *pass_through)
+{
+  (void) pass_through;
+
+  switch (id)
+    {
+    case PGEVT_REGISTER:
+      PQsetInstanceData (((PGEventRegister *) info)->conn, on_session_event,
+                         g_new0 (SessionZone, 1));
+      break;
+    case PGEVT_CONNDESTROY:
+      {
+        PGconn *pg = ((PGEventConnDestroy *) info)->conn;
+        SessionZone *session = PQinstanceData (pg, on_session_event);
+
+        if (session)
+          {
+            g_free (session->name);
+            g_clear_pointer (&session->zone, g_time_zone_unref);
+            g_free (session);
+          }
+        break;
+      }
+    case PGEVT_RESULTCREATE:
+      {
+        PGEventResultCreate *create = info;
+        SessionZone *session = PQinstanceData (create->conn, on_session_event);
+        GTimeZone *zone = session ? session_zone_get (session, create->conn) : NULL;
+
+        if (zone)
+          PQresultSetInstanceData (create->result, on_session_event, g_time_zone_ref (zone));
+        break;
+      }
+    case PGEVT_RESULTCOPY:
+      {
+        PGEventResultCopy *copy = info;
+        GTimeZone *zone = PQresultInstanceData (copy->src, on_session_event);
+
+        if (zone)
+          PQresultSetInstanceData (copy->dest, on_session_event, g_time_zone_ref (zone));
+        break;
+      }
+    case PGEVT_RESULTDESTROY:
+      {
+        GTimeZone *zone =
+            PQresultInstanceData (((PGEventResultDestroy *) info)->result, on_session_event);
+
+        if (zone)
+          g_time_zone_unref (zone);
+        break;
+      }
+    default:
+      break;
+    }
+
+  return TRUE;
+}
+
+/* Makes results of pg remember the session's time zone */
+void
+pg_track_session_time_zone (PGconn *pg)
+{
+  PQregisterEventProc (pg, on_session_event, "pgbrowsr session zone", NULL);
+}
+
+/* The time zone of the session res came from, or NULL when unknown. The
+ * reference belongs to res. */
+GTimeZone *
+pg_result_get_time_zone (const PGresult *res)
+{
+  return PQresultInstanceData (res, on_session_event);
+}
+
+/* Formats a native value into buf, the way the server would print it.
+ * timestamptz arrives in UTC and is shown in time_zone, the session's
+ * time zone, as the server does for text results. Without a zone, or for
+ * zones GLib doesn't know, local time is used. */
+const char *
+pg_native_format (PgKind kind, PgNative value, char *buf, gsize size, GTimeZone *time_zone)
+{
+  gint64 days;
+  int hour, min, sec, frac;
+  char date[32], time[32], zone[16];
+
+  switch (kind)
+    {
+    case PG_KIND_INT:
+      g_snprintf (buf, size, "%" G_GINT64_FORMAT, value.i);
+      break;
+    case PG_KIND_FLOAT4:
+    case PG_KIND_FLOAT:
+      format_float (buf, size, value.f, kind == PG_KIND_FLOAT4);
+      break;
+    case PG_KIND_BOOL:
+      g_strlcpy (buf, value.i ? "t" : "f", size);
+      break;
+    case PG_KIND_DATE:
+      if (value.i == G_MAXINT32 || value.i == G_MININT32)
+        g_strlcpy (buf, value.i > 0 ? "infinity" : "-infinity", size);
+      else if (format_date (date, sizeof (date), value.i))
+        g_snprintf (buf, size, "%s BC", date);
+      else
+        g_strlcpy (buf, date, size);
+      break;
+    case PG_KIND_TIME:
+      split_usecs (value.i, &days, &hour, &min, &sec, &frac);
+      format_time (buf, size, hour, min, sec, frac);
+      break;
+    case PG_KIND_TIMESTAMP:
+    case PG_KIND_TIMESTAMPTZ:
+      if (value.i == G_MAXINT64 || value.i == G_MININT64)
+        {
+          g_strlcpy (buf, value.i > 0 ? "infinity" : "-infinity", size);
+          break;
+        }
+
+      zone[0] = '\0';
+
+      if (kind == PG_KIND_TIMESTAMPTZ)
+        {
+          GTimeZone *tz = time_zone ? g_time_zone_ref (time_zone) : g_time_zone_new_local ();
+          gint64 unix_secs =
+              value.i / G_USEC_PER_SEC + (gint64) (PG_EPOCH_JDATE - UNIX_EPOCH_JDATE) * 86400;
+          int interval = g_time_zone_find_interval (tz, G_TIME_TYPE_UNIVERSAL, unix_secs);
+          GTimeSpan offset = (GTimeSpan) g_time_zone_get_offset (tz, interval) * G_USEC_PER_SEC;
+
+          value.i += offset;
+          format_offset (zone, sizeof (zone), offset);
+          g_time_zone_unref (tz);
+        }
+
+      split_usecs (value.i, &days, &hour, &min, &sec, &frac);
+      format_time (time, sizeof (time), hour, min, sec, frac);
+
+      if (format_date (date, sizeof (date), days))
+        g_snprintf (buf, size, "%s %s%s BC", date, time, zone);
+      else
+        g_snprintf (buf, size, "%s %s%s", date, time, zone);
+      break;
+    case PG_KIND_TEXT:
+    default:
+      buf[0] = '\0';
+      break;
+    }
+
+  return buf;
+}
\ No newline at end of file
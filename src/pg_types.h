@@ -0,0 +1,61 @@
+#ifndef PG_TYPES_H
+#define PG_TYPES_H
+
+#include <glib.h>
+#include <libpq-fe.h>
+
+/* Built-in type OIDs, see pg_type.dat */
+#define BOOLOID 16
+#define BYTEAOID 17
+#define CHAROID 18
+#define NAMEOID 19
+#define INT8OID 20
+#define INT2OID 21
+#define INT4OID 23
+#define TEXTOID 25
+#define OIDOID 26
+#define JSONOID 114
+#define XMLOID 142
+#define FLOAT4OID 700
+#define FLOAT8OID 701
+#define BPCHAROID 1042
+#define VARCHAROID 1043
+#define DATEOID 1082
+#define TIMEOID 1083
+#define TIMESTAMPOID 1114
+#define TIMESTAMPTZOID 1184
+#define NUMERICOID 1700
+#define UUIDOID 2950
+#define JSONBOID 3802
+
+typedef enum
+{
+  PG_KIND_TEXT,
+  PG_KIND_INT,
+  PG_KIND_FLOAT4,
+  PG_KIND_FLOAT,
+  PG_KIND_BOOL,
+  PG_KIND_DATE,
+  PG_KIND_TIME,
+  PG_KIND_TIMESTAMP,
+  PG_KIND_TIMESTAMPTZ
+} PgKind;
+
+typedef union
+{
+  gint64 i;
+  double f;
+} PgNative;
+
+gboolean pg_type_has_binary_decoder (Oid type);
+PgKind pg_type_native_kind (Oid type);
+
+PgNative pg_binary_read_native (Oid type, const char *data);
+void pg_binary_append_text (GString *out, Oid type, const char *data, int len);
+
+void pg_track_session_time_zone (PGconn *pg);
+GTimeZone *pg_result_get_time_zone (const PGresult *res);
+const char *pg_native_format (PgKind kind, PgNative value, char *buf, gsize size,
+                              GTimeZone *time_zone);
+
+#endif
\ No newline at end of file
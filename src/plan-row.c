@@ -0,0 +1,80 @@
+#include "plan-row.h"
+
+/* One node of a plan in a GtkTreeListModel, keeping the plan it points
+ * into alive */
+struct _PlanRow
+{
+  GObject parent_instance;
+
+  ExplainPlan *plan;
+  const PlanNode *node;
+};
+
+G_DEFINE_TYPE (PlanRow, plan_row, G_TYPE_OBJECT)
+
+static void
+plan_row_dispose (GObject *object)
+{
+  PlanRow *row = PLAN_ROW (object);
+
+  g_clear_pointer (&row->plan, explain_plan_unref);
+
+  G_OBJECT_CLASS (plan_row_parent_class)->dispose (object);
+}
+
+static void
+plan_row_class_init (PlanRowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = plan_row_dispose;
+}
+
+static void
+plan_row_init (PlanRow *self)
+{
+  (void) self;
+}
+
+PlanRow *
+plan_row_new (ExplainPlan *plan, const PlanNode *node)
+{
+  PlanRow *row = g_object_new (TYPE_PLAN_ROW, NULL);
+
+  row->plan = explain_plan_ref (plan);
+  row->node = node;
+
+  return row;
+}
+
+const PlanNode *
+plan_row_get_node (PlanRow *row)
+{
+  return row->node;
+}
+
+ExplainPlan *
+plan_row_get_plan (PlanRow *row)
+{
+  return row->plan;
+}
+
+/* A new model of the node's children, or NULL for a leaf */
+GListModel *
+plan_row_get_children (PlanRow *row)
+{
+  if (row->node->n_children == 0)
+    return NULL;
+
+  GListStore *store = g_list_store_new (TYPE_PLAN_ROW);
+
+  for (guint i = 0; i < row->node->n_children; i++)
+    {
+      PlanRow *child = plan_row_new (row->plan, row->node->children[i]);
+
+      g_list_store_append (store, child);
+      g_object_unref (child);
+    }
+
+  return G_LIST_MODEL (store);
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef PLAN_ROW_H
+#define PLAN_ROW_H
+
+#include "explain_plan.h"
+
+#include <gio/gio.h>
+
+#define TYPE_PLAN_ROW (plan_row_get_type ())
+G_DECLARE_FINAL_TYPE (PlanRow, plan_row, PLAN, ROW, GObject)
+
+PlanRow *plan_row_new (ExplainPlan *plan, const PlanNode *node);
+
+const PlanNode *plan_row_get_node (PlanRow *row);
+ExplainPlan *plan_row_get_plan (PlanRow *row);
+GListModel *plan_row_get_children (PlanRow *row);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "query_stats.h"
+
+#include <stdio.h>
+
+static double
+span_ms (gint64 from, gint64 to)
+{
+  if (from == 0 || to < from)
+    return 0;
+
+  return (to - from) / 1000.0;
+}
+
+char *
+query_stats_format (const QueryStats *stats)
+{
+  if (stats->cached_at)
+    return g_strdup_printf ("%u rows, %d columns from the cache, fetched %" G_GINT64_FORMAT
+                            " s ago. Paint %.1f ms",
+                            stats->rows, stats->columns,
+                            (stats->last_row - stats->cached_at) / G_USEC_PER_SEC,
+                            span_ms (stats->last_row, stats->painted));
+
+  char *size = g_format_size (stats->bytes);
+  char *text = g_strdup_printf ("%u rows, %d columns, %s received. "
+                                "Queued %.1f ms, server %.1f ms, transfer %.1f ms, "
+                                "model %.1f ms, paint %.1f ms",
+                                stats->rows, stats->columns, size,
+                                span_ms (stats->queued, stats->sent),
+                                span_ms (stats->sent, stats->first_byte),
+                                span_ms (stats->first_byte, stats->last_row),
+                                stats->build_us / 1000.0,
+                                span_ms (stats->last_row, stats->painted));
+
+  g_free (size);
+  return text;
+}
+
+static void
+append_json_string (GString *out, const char *str)
+{
+  g_string_append_c (out, '"');
+
+  for (const char *p = str; *p; p++)
+    {
+      switch (*p)
+        {
+        case '"':
+          g_string_append (out, "\\\"");
+          break;
+        case '\\':
+          g_string_append (out, "\\\\");
+          break;
+        case '\n':
+          g_string_append (out, "\\n");
+          break;
+        case '\t':
+          g_string_append (out, "\\t");
+          break;
+        default:
+          if ((guchar) *p < 0x20)
+            g_string_append_printf (out, "\\u%04x", (guchar) *p);
+          else
+            g_string_append_c (out, *p);
+        }
+    }
+
+  g_string_append_c (out, '"');
+}
+
+void
+query_stats_append_trace (const QueryStats *stats,
+                          const char *query,
+                          const char *error,
+                          const char *path)
+{
+  if (!path || path[0] == '\0')
+    return;
+
+  FILE *fh = fopen (path, "a");
+
+  if (!fh)
+    {
+      perror ("fopen");
+      return;
+    }
+
+  GString *line = g_string_new (NULL);
+
+  g_string_append_printf (line, "{\"time\": %" G_GINT64_FORMAT ", \"query\": ",
+                          g_get_real_time () / G_USEC_PER_SEC);
+  append_json_string (line, query);
+
+  g_string_append (line, ", \"error\": ");
+
+  if (error)
+    append_json_string (line, error);
+  else
+    g_string_append (line, "null");
+
+  g_string_append_printf (line,
+                          ", \"rows\": %u, \"columns\": %d, \"bytes\": %" G_GUINT64_FORMAT
+                          ", \"queue_ms\": %.3f, \"server_ms\": %.3f, \"transfer_ms\": %.3f"
+                          ", \"model_ms\": %.3f, \"paint_ms\": %.3f, \"cached\": %s}\n",
+                          stats->rows, stats->columns, stats->bytes,
+                          span_ms (stats->queued, stats->sent),
+                          span_ms (stats->sent, stats->first_byte),
+                          span_ms (stats->first_byte, stats->last_row), stats->build_us / 1000.0,
+                          span_ms (stats->last_row, stats->painted),
+                          stats->cached_at ? "true" : "false");
+
+  fputs (line->str, fh);
+  fclose (fh);
+
+  g_string_free (line, TRUE);
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef QUERY_STATS_H
+#define QUERY_STATS_H
+
+#include <glib.h>
+
+/* Where the time of one query went. Timestamps are monotonic
+ * microseconds, 0 when the stage was never reached. */
+typedef struct
+{
+  gint64 queued;
+  gint64 sent;
+  gint64 first_byte;
+  gint64 last_row;
+  gint64 painted;
+
+  /* Time spent turning row batches into the model */
+  gint64 build_us;
+
+  guint64 bytes;
+  guint rows;
+  int columns;
+
+  /* When the result served from the cache was fetched, 0 when it came
+   * from the server */
+  gint64 cached_at;
+} QueryStats;
+
+char *query_stats_format (const QueryStats *stats);
+void query_stats_append_trace (const QueryStats *stats,
+                               const char *query,
+                               const char *error,
+                               const char *path);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "result-model.h"
+#include "generic-row.h"
+
+/* GListModel over a ResultSet. Row objects are only created when a view
+ * asks for them, so building the model costs nothing per row. Batches can
+ * be appended while a query is still streaming in. Sorting and filtering
+ * only change which set row is shown at each position. */
+struct _ResultModel
+{
+  GObject parent_instance;
+
+  ResultSet *set;
+  gboolean has_columns;
+
+  /* Every row in sorted order, NULL in arrival order */
+  guint *order;
+  guint n_order;
+
+  /* Matching rows in ascending order, NULL when not filtered */
+  guint *filter;
+  guint n_filter;
+
+  /* Set row shown at each position, NULL when showing every row in
+   * arrival order. Points at order or filter unless both are set. */
+  const guint *positions;
+  guint n_positions;
+  guint *merged;
+};
+
+enum
+{
+  COLUMNS_CHANGED,
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
+
+static void result_model_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (ResultModel,
+                         result_model,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, result_model_list_model_init))
+
+static GType
+result_model_get_item_type (GListModel *list)
+{
+  (void) list;
+
+  return TYPE_GENERIC_ROW;
+}
+
+static guint
+result_model_get_n_items (GListModel *list)
+{
+  ResultModel *model = RESULT_MODEL (list);
+
+  if (model->positions)
+    return model->n_positions;
+
+  return result_set_get_n_rows (model->set);
+}
+
+static gpointer
+result_model_get_item (GListModel *list, guint position)
+{
+  ResultModel *model = RESULT_MODEL (list);
+
+  if (position >= result_model_get_n_items (list))
+    return NULL;
+
+  if (model->positions)
+    position = model->positions[position];
+
+  return generic_row_new (model->set, position);
+}
+
+static void
+result_model_list_model_init (GListModelInterface *iface)
+{
+  iface->get_item_type = result_model_get_item_type;
+  iface->get_n_items = result_model_get_n_items;
+  iface->get_item = result_model_get_item;
+}
+
+static void
+result_model_dispose (GObject *object)
+{
+  ResultModel *model = RESULT_MODEL (object);
+
+  g_clear_pointer (&model->set, result_set_unref);
+  g_clear_pointer (&model->order, g_free);
+  g_clear_pointer (&model->filter, g_free);
+  g_clear_pointer (&model->merged, g_free);
+
+  G_OBJECT_CLASS (result_model_parent_class)->dispose (object);
+}
+
+static void
+result_model_class_init (ResultModelClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = result_model_dispose;
+
+  signals[COLUMNS_CHANGED] = g_signal_new ("columns-changed", G_TYPE_FROM_CLASS (klass),
+                                           G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
+                                           G_TYPE_NONE, 0);
+}
+
+static void
+result_model_init (ResultModel *self)
+{
+  self->set = result_set_new_empty ();
+}
+
+ResultModel *
+result_model_new (void)
+{
+  return g_object_new (TYPE_RESULT_MODEL, NULL);
+}
+
+/* Takes ownership of batch */
+void
+result_model_append (ResultModel *model, PGresult *batch)
+{
+  guint old_rows = result_set_get_n_rows (model->set);
+
+  result_set_append (model->set, batch);
+
+  if (!model->has_columns)
+    {
+      model->has_columns = TRUE;
+      g_signal_emit (model, signals[COLUMNS_CHANGED], 0);
+    }
+
+  guint added = result_set_get_n_rows (model->set) - old_rows;
+
+  if (added > 0)
+    g_list_model_items_changed (G_LIST_MODEL (model), old_rows, 0, added);
+}
+
+/* Drops all rows, e.g. when the next statement of a script starts */
+void
+result_model_reset (ResultModel *model)
+{
+  guint old_rows = result_model_get_n_items (G_LIST_MODEL (model));
+
+  result_set_unref (model->set);
+  model->set = result_set_new_empty ();
+  model->has_columns = FALSE;
+
+  g_clear_pointer (&model->order, g_free);
+  g_clear_pointer (&model->filter, g_free);
+  g_clear_pointer (&model->merged, g_free);
+  model->positions = NULL;
+  model->n_order = model->n_filter = 0;
+
+  if (old_rows > 0)
+    g_list_model_items_changed (G_LIST_MODEL (model), 0, old_rows, 0);
+}
+
+/* Shows set, which must be complete, in place of any rows so far */
+void
+result_model_set_result_set (ResultModel *model, ResultSet *set)
+{
+  result_model_reset (model);
+
+  result_set_unref (model->set);
+  model->set = result_set_ref (set);
+  model->has_columns = TRUE;
+
+  g_signal_emit (model, signals[COLUMNS_CHANGED], 0);
+
+  if (result_set_get_n_rows (set) > 0)
+    g_list_model_items_changed (G_LIST_MODEL (model), 0, 0, result_set_get_n_rows (set));
+}
+
+ResultSet *
+result_model_get_result_set (ResultModel *model)
+{
+  return model->set;
+}
+
+int
+result_model_get_n_columns (ResultModel *model)
+{
+  return result_set_get_n_columns (model->set);
+}
+
+const char *
+result_model_get_column_name (ResultModel *model, int column)
+{
+  return result_set_get_column_name (model->set, column);
+}
+
+/* Recomputes which row is shown where and announces the whole list as
+ * replaced */
+static void
+result_model_update_positions (ResultModel *model)
+{
+  guint old_items = result_model_get_n_items (G_LIST_MODEL (model));
+
+  g_clear_pointer (&model->merged, g_free);
+  model->positions = NULL;
+  model->n_positions = 0;
+
+  if (model->order && model->filter)
+    {
+      guint8 *keep = g_new0 (guint8, result_set_get_n_rows (model->set));
+
+      for (guint i = 0; i < model->n_filter; i++)
+        keep[model->filter[i]] = 1;
+
+      model->merged = g_new (guint, MAX (model->n_filter, 1));
+
+      for (guint i = 0; i < model->n_order; i++)
+        if (keep[model->order[i]])
+          model->merged[model->n_positions++] = model->order[i];
+
+      model->positions = model->merged;
+      g_free (keep);
+    }
+  else if (model->filter)
+    {
+      model->positions = model->filter;
+      model->n_positions = model->n_filter;
+    }
+  else if (model->order)
+    {
+      model->positions = model->order;
+      model->n_positions = model->n_order;
+    }
+
+  guint n_items = result_model_get_n_items (G_LIST_MODEL (model));
+
+  if (old_items > 0 || n_items > 0)
+    g_list_model_items_changed (G_LIST_MODEL (model), 0, old_items, n_items);
+}
+
+/* Shows the rows in the given order, taking ownership of it, or in
+ * arrival order again when order is NULL */
+void
+result_model_set_order (ResultModel *model, guint *order, guint n_rows)
+{
+  g_free (model->order);
+  model->order = order;
+  model->n_order = order ? n_rows : 0;
+
+  result_model_update_positions (model);
+}
+
+/* Shows only the given rows, taking ownership of the ascending list, or
+ * every row again when rows is NULL */
+void
+result_model_set_filter (ResultModel *model, guint *rows, guint n_rows)
+{
+  g_free (model->filter);
+  model->filter = rows;
+  model->n_filter = rows ? n_rows : 0;
+
+  result_model_update_positions (model);
+}
+
+/* The rows passing the current filter, NULL when not filtered */
+const guint *
+result_model_get_filter (ResultModel *model, guint *n_rows)
+{
+  *n_rows = model->n_filter;
+
+  return model->filter;
+}
\ No newline at end of file
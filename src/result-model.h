@@ -0,0 +1,24 @@
+#ifndef RESULT_MODEL_H
+#define RESULT_MODEL_H
+
+#include "result_set.h"
+
+#include <gio/gio.h>
+
+#define TYPE_RESULT_MODEL (result_model_get_type ())
+G_DECLARE_FINAL_TYPE (ResultModel, result_model, RESULT, MODEL, GObject)
+
+ResultModel *result_model_new (void);
+
+void result_model_append (ResultModel *model, PGresult *batch);
+void result_model_reset (ResultModel *model);
+void result_model_set_result_set (ResultModel *model, ResultSet *set);
+void result_model_set_order (ResultModel *model, guint *order, guint n_rows);
+void result_model_set_filter (ResultModel *model, guint *rows, guint n_rows);
+const guint *result_model_get_filter (ResultModel *model, guint *n_rows);
+
+ResultSet *result_model_get_result_set (ResultModel *model);
+int result_model_get_n_columns (ResultModel *model);
+const char *result_model_get_column_name (ResultModel *model, int column);
+
+#endif
\ No newline at end of file
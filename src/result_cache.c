@@ -0,0 +1,143 @@
+#include "result_cache.h"
+
+#include <string.h>
+
+/* Entries sit in a queue from most to least recently used, with a table
+ * from key to queue link, so lookups, hits and evictions are all constant
+ * time. Sets are immutable once cached and shared with whatever shows
+ * them, so a hit costs a reference and not a copy. */
+
+typedef struct
+{
+  char *key;
+  ResultSet *set;
+  gint64 estimated_rows;
+  gsize bytes;
+  gint64 fetched_at;
+} CacheEntry;
+
+struct _ResultCache
+{
+  gsize max_bytes;
+  gint64 ttl_us;
+
+  gsize bytes;
+  GQueue entries;
+  GHashTable *links;
+};
+
+static void
+cache_entry_free (CacheEntry *entry)
+{
+  result_set_unref (entry->set);
+  g_free (entry->key);
+  g_free (entry);
+}
+
+/* max_bytes 0 caches nothing, ttl_us 0 keeps results until evicted */
+ResultCache *
+result_cache_new (gsize max_bytes, gint64 ttl_us)
+{
+  ResultCache *cache = g_new0 (ResultCache, 1);
+
+  cache->max_bytes = max_bytes;
+  cache->ttl_us = ttl_us;
+  cache->links = g_hash_table_new (g_str_hash, g_str_equal);
+
+  return cache;
+}
+
+void
+result_cache_free (ResultCache *cache)
+{
+  if (!cache)
+    return;
+
+  result_cache_clear (cache);
+  g_hash_table_unref (cache->links);
+  g_free (cache);
+}
+
+static void
+result_cache_remove_link (ResultCache *cache, GList *link)
+{
+  CacheEntry *entry = link->data;
+
+  g_hash_table_remove (cache->links, entry->key);
+  g_queue_delete_link (&cache->entries, link);
+
+  cache->bytes -= entry->bytes;
+  cache_entry_free (entry);
+}
+
+/* Keeps set, a complete result, under key. A set larger than the whole
+ * budget is not kept. estimated_rows is stored alongside for callers that
+ * have one. */
+void
+result_cache_insert (ResultCache *cache, const char *key, ResultSet *set, gint64 estimated_rows)
+{
+  GList *old = g_hash_table_lookup (cache->links, key);
+
+  if (old)
+    result_cache_remove_link (cache, old);
+
+  gsize bytes = result_set_get_n_bytes (set) + strlen (key);
+
+  if (bytes > cache->max_bytes)
+    return;
+
+  while (cache->bytes + bytes > cache->max_bytes)
+    result_cache_remove_link (cache, g_queue_peek_tail_link (&cache->entries));
+
+  CacheEntry *entry = g_new0 (CacheEntry, 1);
+
+  entry->key = g_strdup (key);
+  entry->set = result_set_ref (set);
+  entry->estimated_rows = estimated_rows;
+  entry->bytes = bytes;
+  entry->fetched_at = g_get_monotonic_time ();
+
+  g_queue_push_head (&cache->entries, entry);
+  g_hash_table_insert (cache->links, entry->key, g_queue_peek_head_link (&cache->entries));
+  cache->bytes += bytes;
+}
+
+/* A new reference to the set under key, or NULL when there is none or it
+ * has expired. fetched_at receives its monotonic time of arrival. */
+ResultSet *
+result_cache_lookup (ResultCache *cache,
+                     const char *key,
+                     gint64 *estimated_rows,
+                     gint64 *fetched_at)
+{
+  GList *link = g_hash_table_lookup (cache->links, key);
+
+  if (!link)
+    return NULL;
+
+  CacheEntry *entry = link->data;
+
+  if (cache->ttl_us > 0 && g_get_monotonic_time () - entry->fetched_at > cache->ttl_us)
+    {
+      result_cache_remove_link (cache, link);
+      return NULL;
+    }
+
+  g_queue_unlink (&cache->entries, link);
+  g_queue_push_head_link (&cache->entries, link);
+
+  if (estimated_rows)
+    *estimated_rows = entry->estimated_rows;
+
+  if (fetched_at)
+    *fetched_at = entry->fetched_at;
+
+  return result_set_ref (entry->set);
+}
+
+void
+result_cache_clear (ResultCache *cache)
+{
+  while (!g_queue_is_empty (&cache->entries))
+    result_cache_remove_link (cache, g_queue_peek_tail_link (&cache->entries));
+}
\ No newline at end of file
@@ -0,0 +1,25 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include "result_set.h"
+
+#include <glib.h>
+
+/* Recent complete results by key, dropping the least recently used once
+ * they outgrow a byte budget. Main thread only. */
+typedef struct _ResultCache ResultCache;
+
+ResultCache *result_cache_new (gsize max_bytes, gint64 ttl_us);
+void result_cache_free (ResultCache *cache);
+
+void result_cache_insert (ResultCache *cache,
+                          const char *key,
+                          ResultSet *set,
+                          gint64 estimated_rows);
+ResultSet *result_cache_lookup (ResultCache *cache,
+                                const char *key,
+                                gint64 *estimated_rows,
+                                gint64 *fetched_at);
+void result_cache_clear (ResultCache *cache);
+
+#endif
\ No newline at end of file
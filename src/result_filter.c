@@ -0,0 +1,354 @@
+#include "result_filter.h"
+#include "work_pool.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+/* Cells are searched where they live: text columns are scanned straight
+ * out of their arena, a whole chunk of rows in one pass when every row is
+ * a candidate, and native columns are formatted as the grid shows them.
+ * Candidate positions come from comparing a block of bytes against the
+ * needle's first and last byte at once; only those are checked in full. */
+
+#define MIN_CHUNK_ROWS 8192
+#define CANCEL_CHECK_ROWS 4096
+
+typedef struct
+{
+  char *lower;
+  gsize len;
+
+  char first_lower;
+  char first_upper;
+  char last_lower;
+  char last_upper;
+} Needle;
+
+typedef const char *(*FindFunc) (const char *hay, gsize len, const Needle *needle);
+
+typedef struct
+{
+  ResultSet *set;
+  Needle needle;
+  FindFunc find;
+
+  /* NULL when every row is a candidate */
+  guint *candidates;
+  guint n_candidates;
+
+  guint n_chunks;
+  GArray **matches;
+  guint n_matches;
+
+  GCancellable *cancellable;
+} FilterJob;
+
+static gboolean
+matches_at (const char *p, const Needle *needle)
+{
+  for (gsize i = 0; i < needle->len; i++)
+    if (g_ascii_tolower (p[i]) != needle->lower[i])
+      return FALSE;
+
+  return TRUE;
+}
+
+static const char *
+find_scalar (const char *hay, gsize len, const Needle *needle)
+{
+  for (gsize i = 0; i + needle->len <= len; i++)
+    if (matches_at (hay + i, needle))
+      return hay + i;
+
+  return NULL;
+}
+
+#ifdef HAVE_X86_SIMD
+static const char *
+find_sse2 (const char *hay, gsize len, const Needle *needle)
+{
+  gsize last = needle->len - 1;
+  gsize i = 0;
+
+  __m128i first_lower = _mm_set1_epi8 (needle->first_lower);
+  __m128i first_upper = _mm_set1_epi8 (needle->first_upper);
+  __m128i last_lower = _mm_set1_epi8 (needle->last_lower);
+  __m128i last_upper = _mm_set1_epi8 (needle->last_upper);
+
+  for (; i + last + 16 <= len; i += 16)
+    {
+      __m128i head = _mm_loadu_si128 ((const __m128i *) (hay + i));
+      __m128i tail = _mm_loadu_si128 ((const __m128i *) (hay + i + last));
+      __m128i first = _mm_or_si128 (_mm_cmpeq_epi8 (head, first_lower),
+                                    _mm_cmpeq_epi8 (head, first_upper));
+      __m128i end = _mm_or_si128 (_mm_cmpeq_epi8 (tail, last_lower),
+                                  _mm_cmpeq_epi8 (tail, last_upper));
+      guint mask = _mm_movemask_epi8 (_mm_and_si128 (first, end));
+
+      for (; mask; mask &= mask - 1)
+        {
+          const char *p = hay + i + __builtin_ctz (mask);
+
+          if (matches_at (p, needle))
+            return p;
+        }
+    }
+
+  return find_scalar (hay + i, len - i, needle);
+}
+
+__attribute__ ((target ("avx2"))) static const char *
+find_avx2 (const char *hay, gsize len, const Needle *needle)
+{
+  gsize last = needle->len - 1;
+  gsize i = 0;
+
+  __m256i first_lower = _mm256_set1_epi8 (needle->first_lower);
+  __m256i first_upper = _mm256_set1_epi8 (needle->first_upper);
+  __m256i last_lower = _mm256_set1_epi8 (needle->last_lower);
+  __m256i last_upper = _mm256_set1_epi8 (needle->last_upper);
+
+  for (; i + last + 32 <= len; i += 32)
+    {
+      __m256i head = _mm256_loadu_si256 ((const __m256i *) (hay + i));
+      __m256i tail = _mm256_loadu_si256 ((const __m256i *) (hay + i + last));
+      __m256i first = _mm256_or_si256 (_mm256_cmpeq_epi8 (head, first_lower),
+                                       _mm256_cmpeq_epi8 (head, first_upper));
+      __m256i end = _mm256_or_si256 (_mm256_cmpeq_epi8 (tail, last_lower),
+                                     _mm256_cmpeq_epi8 (tail, last_upper));
+      guint mask = (guint) _mm256_movemask_epi8 (_mm256_and_si256 (first, end));
+
+      for (; mask; mask &= mask - 1)
+        {
+          const char *p = hay + i + __builtin_ctz (mask);
+
+          if (matches_at (p, needle))
+            return p;
+        }
+    }
+
+  return find_sse2 (hay + i, len - i, needle);
+}
+#endif
+
+static FindFunc
+pick_find_func (void)
+{
+#ifdef HAVE_X86_SIMD
+  __builtin_cpu_init ();
+
+  if (__builtin_cpu_supports ("avx2"))
+    return find_avx2;
+
+  return find_sse2;
+#else
+  return find_scalar;
+#endif
+}
+
+static void
+needle_init (Needle *needle, const char *text)
+{
+  needle->lower = g_ascii_strdown (text, -1);
+  needle->len = strlen (needle->lower);
+
+  if (needle->len == 0)
+    return;
+
+  needle->first_lower = needle->lower[0];
+  needle->first_upper = g_ascii_toupper (needle->lower[0]);
+  needle->last_lower = needle->lower[needle->len - 1];
+  needle->last_upper = g_ascii_toupper (needle->lower[needle->len - 1]);
+}
+
+static guint
+filter_job_row (FilterJob *job, guint index)
+{
+  return job->candidates ? job->candidates[index] : index;
+}
+
+/* Every row of the chunk is a candidate, so the values of lo .. hi - 1
+ * sit back to back in the arena and are searched in one span. After a
+ * hit the search resumes at the next row. */
+static void
+filter_text_span (FilterJob *job, const char *data, const gsize *offsets, guint lo, guint hi,
+                  guint8 *hits)
+{
+  const char *end = data + offsets[hi];
+  const char *p = data + offsets[lo];
+  guint row = lo;
+
+  while (p < end && (p = job->find (p, end - p, &job->needle)))
+    {
+      gsize offset = p - data;
+
+      while (offsets[row + 1] <= offset)
+        row++;
+
+      hits[row - lo] = 1;
+      p = data + offsets[row + 1];
+    }
+}
+
+static void
+filter_chunk (guint index, gpointer user_data)
+{
+  FilterJob *job = user_data;
+  guint lo = (guint) ((guint64) job->n_candidates * index / job->n_chunks);
+  guint hi = (guint) ((guint64) job->n_candidates * (index + 1) / job->n_chunks);
+  guint8 *hits = g_new0 (guint8, MAX (hi - lo, 1));
+  int n_columns = result_set_get_n_columns (job->set);
+  char buf[64];
+
+  for (int c = 0; c < n_columns; c++)
+    {
+      const gsize *offsets;
+      const char *data = result_set_get_text_column (job->set, c, &offsets);
+
+      if (g_cancellable_is_cancelled (job->cancellable))
+        break;
+
+      if (data && !job->candidates)
+        {
+          filter_text_span (job, data, offsets, lo, hi, hits);
+          continue;
+        }
+
+      for (guint i = lo; i < hi; i++)
+        {
+          guint row = filter_job_row (job, i);
+
+          if (hits[i - lo])
+            continue;
+
+          if (data)
+            {
+              const char *value = data + offsets[row];
+
+              hits[i - lo] = job->find (value, offsets[row + 1] - offsets[row] - 1, &job->needle)
+                             != NULL;
+            }
+          else if (!result_set_is_null (job->set, row, c))
+            {
+              const char *value = result_set_format_value (job->set, row, c, buf, sizeof (buf));
+
+              hits[i - lo] = job->find (value, strlen (value), &job->needle) != NULL;
+            }
+
+          if ((i - lo) % CANCEL_CHECK_ROWS == 0 && g_cancellable_is_cancelled (job->cancellable))
+            break;
+        }
+    }
+
+  GArray *matches = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  for (guint i = lo; i < hi; i++)
+    if (hits[i - lo])
+      {
+        guint row = filter_job_row (job, i);
+
+        g_array_append_val (matches, row);
+      }
+
+  job->matches[index] = matches;
+  g_free (hits);
+}
+
+static void
+filter_job_free (gpointer data)
+{
+  FilterJob *job = data;
+
+  for (guint i = 0; i < job->n_chunks; i++)
+    if (job->matches[i])
+      g_array_unref (job->matches[i]);
+
+  g_free (job->matches);
+  g_free (job->candidates);
+  g_free (job->needle.lower);
+  g_clear_object (&job->cancellable);
+  result_set_unref (job->set);
+  g_free (job);
+}
+
+static void
+filter_thread (GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+  (void) source;
+  (void) cancellable;
+
+  FilterJob *job = task_data;
+
+  job->find = job->needle.len > 0 ? pick_find_func () : find_scalar;
+  job->n_chunks = CLAMP (job->n_candidates / MIN_CHUNK_ROWS, 1, work_pool_get_n_threads ());
+  job->matches = g_new0 (GArray *, job->n_chunks);
+
+  work_pool_run (job->n_chunks, filter_chunk, job);
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  for (guint i = 0; i < job->n_chunks; i++)
+    job->n_matches += job->matches[i]->len;
+
+  guint *rows = g_new (guint, MAX (job->n_matches, 1));
+  guint n = 0;
+
+  for (guint i = 0; i < job->n_chunks; i++)
+    {
+      memcpy (rows + n, job->matches[i]->data, job->matches[i]->len * sizeof (guint));
+      n += job->matches[i]->len;
+    }
+
+  g_task_return_pointer (task, rows, g_free);
+}
+
+void
+result_filter_async (ResultSet *set,
+                     const char *needle,
+                     const guint *candidates,
+                     guint n_candidates,
+                     GCancellable *cancellable,
+                     GAsyncReadyCallback callback,
+                     gpointer user_data)
+{
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+  FilterJob *job = g_new0 (FilterJob, 1);
+
+  job->set = result_set_ref (set);
+  needle_init (&job->needle, needle);
+
+  /* Copied, the caller's list may be replaced while the scan runs */
+  if (candidates)
+    {
+      job->candidates = g_new (guint, MAX (n_candidates, 1));
+      job->n_candidates = n_candidates;
+      memcpy (job->candidates, candidates, n_candidates * sizeof (guint));
+    }
+  else
+    {
+      job->n_candidates = result_set_get_n_rows (set);
+    }
+
+  job->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+
+  g_task_set_task_data (task, job, filter_job_free);
+  g_task_run_in_thread (task, filter_thread);
+  g_object_unref (task);
+}
+
+/* Returns the matching rows, n_matches long */
+guint *
+result_filter_finish (GAsyncResult *result, guint *n_matches, GError **error)
+{
+  guint *rows = g_task_propagate_pointer (G_TASK (result), error);
+
+  if (rows && n_matches)
+    *n_matches = ((FilterJob *) g_task_get_task_data (G_TASK (result)))->n_matches;
+
+  return rows;
+}
\ No newline at end of file
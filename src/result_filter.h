@@ -0,0 +1,23 @@
+#ifndef RESULT_FILTER_H
+#define RESULT_FILTER_H
+
+#include "result_set.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+/* Finds the rows of a complete ResultSet with a cell containing needle,
+ * ignoring ASCII case, on the work pool. Only the candidate rows are
+ * scanned, or every row when candidates is NULL, so a refined needle can
+ * start from the previous matches. Candidates must be ascending; the
+ * matching rows come back ascending too. */
+void result_filter_async (ResultSet *set,
+                          const char *needle,
+                          const guint *candidates,
+                          guint n_candidates,
+                          GCancellable *cancellable,
+                          GAsyncReadyCallback callback,
+                          gpointer user_data);
+guint *result_filter_finish (GAsyncResult *result, guint *n_matches, GError **error);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,411 @@
+#include "result_set.h"
+
+#include <string.h>
+
+/* All values of a text column live back to back in one arena, each
+ * followed by a NUL so they can be handed out as C strings. Row i spans
+ * offsets[i] .. offsets[i + 1] - 1. Native columns keep one PgNative per
+ * row and are only formatted for display. */
+typedef struct
+{
+  PgKind kind;
+  gboolean binary;
+
+  PgNative *native;
+
+  char *data;
+  gsize len;
+  gsize alloc;
+
+  gsize *offsets;
+  guint8 *nulls;
+} ResultColumn;
+
+struct _ResultSet
+{
+  gint ref_count;
+
+  guint n_rows;
+  guint alloc_rows;
+
+  int n_columns;
+  char **names;
+  Oid *types;
+  ResultColumn *columns;
+
+  /* The session time zone timestamptz values are shown in */
+  GTimeZone *zone;
+};
+
+ResultSet *
+result_set_new_empty (void)
+{
+  ResultSet *set = g_new0 (ResultSet, 1);
+
+  set->ref_count = 1;
+
+  return set;
+}
+
+ResultSet *
+result_set_new (PGresult *res)
+{
+  ResultSet *set = result_set_new_empty ();
+
+  result_set_append (set, res);
+
+  return set;
+}
+
+ResultSet *
+result_set_ref (ResultSet *set)
+{
+  g_atomic_int_inc (&set->ref_count);
+
+  return set;
+}
+
+void
+result_set_unref (ResultSet *set)
+{
+  if (!g_atomic_int_dec_and_test (&set->ref_count))
+    return;
+
+  for (int c = 0; c < set->n_columns; c++)
+    {
+      g_free (set->columns[c].native);
+      g_free (set->columns[c].data);
+      g_free (set->columns[c].offsets);
+      g_free (set->columns[c].nulls);
+    }
+
+  g_free (set->columns);
+  g_free (set->types);
+  g_clear_pointer (&set->zone, g_time_zone_unref);
+  g_strfreev (set->names);
+  g_free (set);
+}
+
+static void
+result_set_init_columns (ResultSet *set, PGresult *res)
+{
+  set->n_columns = PQnfields (res);
+  set->names = g_new0 (char *, set->n_columns + 1);
+  set->types = g_new0 (Oid, set->n_columns);
+  set->columns = g_new0 (ResultColumn, set->n_columns);
+
+  for (int c = 0; c < set->n_columns; c++)
+    {
+      ResultColumn *col = &set->columns[c];
+
+      set->names[c] = g_strdup (PQfname (res, c));
+      set->types[c] = PQftype (res, c);
+
+      col->binary = PQfformat (res, c) == 1;
+      col->kind = col->binary ? pg_type_native_kind (set->types[c]) : PG_KIND_TEXT;
+    }
+}
+
+static void
+result_set_reserve_rows (ResultSet *set, guint n_rows)
+{
+  if (n_rows <= set->alloc_rows)
+    return;
+
+  guint old_bytes = (set->alloc_rows + 7) / 8;
+  guint alloc = MAX (set->alloc_rows * 2, MAX (n_rows, 64));
+  guint bytes = (alloc + 7) / 8;
+
+  for (int c = 0; c < set->n_columns; c++)
+    {
+      ResultColumn *col = &set->columns[c];
+
+      if (col->kind == PG_KIND_TEXT)
+        {
+          col->offsets = g_renew (gsize, col->offsets, alloc + 1);
+          col->offsets[0] = 0;
+        }
+      else
+        {
+          col->native = g_renew (PgNative, col->native, alloc);
+        }
+
+      col->nulls = g_renew (guint8, col->nulls, bytes);
+      memset (col->nulls + old_bytes, 0, bytes - old_bytes);
+    }
+
+  set->alloc_rows = alloc;
+}
+
+static void
+result_column_reserve (ResultColumn *col, gsize len)
+{
+  if (len <= col->alloc)
+    return;
+
+  col->alloc = MAX (col->alloc * 2, MAX (len, 4096));
+  col->data = g_realloc (col->data, col->alloc);
+}
+
+static void
+result_column_append_native (ResultColumn *col, Oid type, PGresult *res, int c, guint first)
+{
+  guint n = PQntuples (res);
+
+  for (guint r = 0; r < n; r++)
+    {
+      guint row = first + r;
+      PgNative value = { 0 };
+
+      if (PQgetisnull (res, r, c))
+        col->nulls[row / 8] |= 1 << (row % 8);
+      else
+        value = pg_binary_read_native (type, PQgetvalue (res, r, c));
+
+      col->native[row] = value;
+    }
+}
+
+static void
+result_column_push (ResultColumn *col, guint row, const char *value, gsize len)
+{
+  result_column_reserve (col, col->len + len + 1);
+
+  memcpy (col->data + col->len, value, len);
+  col->data[col->len + len] = '\0';
+
+  col->len += len + 1;
+  col->offsets[row + 1] = col->len;
+}
+
+static void
+result_column_append_text (ResultColumn *col, Oid type, PGresult *res, int c, guint first)
+{
+  guint n = PQntuples (res);
+  gsize bytes = 0;
+
+  for (guint r = 0; r < n; r++)
+    bytes += PQgetlength (res, r, c) + 1;
+
+  result_column_reserve (col, col->len + bytes);
+
+  /* Variable-width binary values are rendered to text once, on arrival */
+  GString *scratch = col->binary ? g_string_new (NULL) : NULL;
+
+  for (guint r = 0; r < n; r++)
+    {
+      guint row = first + r;
+      const char *value = PQgetvalue (res, r, c);
+      int len = PQgetlength (res, r, c);
+
+      if (PQgetisnull (res, r, c))
+        {
+          col->nulls[row / 8] |= 1 << (row % 8);
+          result_column_push (col, row, "", 0);
+        }
+      else if (scratch)
+        {
+          g_string_truncate (scratch, 0);
+          pg_binary_append_text (scratch, type, value, len);
+          result_column_push (col, row, scratch->str, scratch->len);
+        }
+      else
+        {
+          result_column_push (col, row, value, len);
+        }
+    }
+
+  if (scratch)
+    g_string_free (scratch, TRUE);
+}
+
+/* Copies the rows of res into the columns and frees it */
+void
+result_set_append (ResultSet *set, PGresult *res)
+{
+  if (!set->names)
+    result_set_init_columns (set, res);
+
+  if (!set->zone && pg_result_get_time_zone (res))
+    set->zone = g_time_zone_ref (pg_result_get_time_zone (res));
+
+  guint n = PQntuples (res);
+
+  result_set_reserve_rows (set, set->n_rows + n);
+
+  for (int c = 0; c < set->n_columns; c++)
+    {
+      ResultColumn *col = &set->columns[c];
+
+      if (col->kind == PG_KIND_TEXT)
+        result_column_append_text (col, set->types[c], res, c, set->n_rows);
+      else
+        result_column_append_native (col, set->types[c], res, c, set->n_rows);
+    }
+
+  set->n_rows += n;
+
+  PQclear (res);
+}
+
+guint
+result_set_get_n_rows (ResultSet *set)
+{
+  return set->n_rows;
+}
+
+/* Memory the rows take, counting what was reserved for more */
+gsize
+result_set_get_n_bytes (ResultSet *set)
+{
+  gsize bytes = sizeof (ResultSet) + set->n_columns * (sizeof (ResultColumn) + sizeof (Oid));
+
+  for (int c = 0; c < set->n_columns; c++)
+    {
+      const ResultColumn *col = &set->columns[c];
+
+      bytes += col->alloc + (set->alloc_rows + 7) / 8;
+
+      if (col->kind == PG_KIND_TEXT)
+        bytes += (set->alloc_rows + 1) * sizeof (gsize);
+      else
+        bytes += set->alloc_rows * sizeof (PgNative);
+    }
+
+  return bytes;
+}
+
+int
+result_set_get_n_columns (ResultSet *set)
+{
+  return set->n_columns;
+}
+
+const char *
+result_set_get_column_name (ResultSet *set, int column)
+{
+  if (column >= set->n_columns)
+    return NULL;
+
+  return set->names[column];
+}
+
+char **
+result_set_dup_column_names (ResultSet *set)
+{
+  if (!set->names)
+    return g_new0 (char *, 1);
+
+  return g_strdupv (set->names);
+}
+
+Oid *
+result_set_dup_column_types (ResultSet *set)
+{
+  return g_memdup2 (set->types, sizeof (Oid) * MAX (set->n_columns, 0));
+}
+
+Oid
+result_set_get_column_type (ResultSet *set, int column)
+{
+  if (column >= set->n_columns)
+    return InvalidOid;
+
+  return set->types[column];
+}
+
+PgKind
+result_set_get_column_kind (ResultSet *set, int column)
+{
+  if (column >= set->n_columns)
+    return PG_KIND_TEXT;
+
+  return set->columns[column].kind;
+}
+
+/* Returns the cell as display text, either pointing into the column arena
+ * or formatted into buf. The pointer stays valid until more rows are
+ * appended. */
+const char *
+result_set_format_value (ResultSet *set, guint row, int column, char *buf, gsize size)
+{
+  if (row >= set->n_rows || column >= set->n_columns)
+    return "";
+
+  ResultColumn *col = &set->columns[column];
+
+  if (col->kind == PG_KIND_TEXT)
+    return col->data + col->offsets[row];
+
+  if (result_set_is_null (set, row, column))
+    return "";
+
+  return pg_native_format (col->kind, col->native[row], buf, size, set->zone);
+}
+
+/* Text columns only */
+const char *
+result_set_get_text (ResultSet *set, guint row, int column)
+{
+  if (row >= set->n_rows || column >= set->n_columns)
+    return "";
+
+  ResultColumn *col = &set->columns[column];
+
+  if (col->kind != PG_KIND_TEXT)
+    return "";
+
+  return col->data + col->offsets[row];
+}
+
+/* The arena of a text column and its row offsets, for scanning many
+ * values at once. NULL for native columns. */
+const char *
+result_set_get_text_column (ResultSet *set, int column, const gsize **offsets)
+{
+  if (column >= set->n_columns || set->columns[column].kind != PG_KIND_TEXT)
+    return NULL;
+
+  *offsets = set->columns[column].offsets;
+
+  return set->columns[column].data;
+}
+
+gsize
+result_set_get_length (ResultSet *set, guint row, int column)
+{
+  if (row >= set->n_rows || column >= set->n_columns)
+    return 0;
+
+  ResultColumn *col = &set->columns[column];
+
+  if (col->kind != PG_KIND_TEXT)
+    return 0;
+
+  return col->offsets[row + 1] - col->offsets[row] - 1;
+}
+
+PgNative
+result_set_get_native (ResultSet *set, guint row, int column)
+{
+  PgNative value = { 0 };
+
+  if (row >= set->n_rows || column >= set->n_columns)
+    return value;
+
+  ResultColumn *col = &set->columns[column];
+
+  if (col->kind == PG_KIND_TEXT)
+    return value;
+
+  return col->native[row];
+}
+
+gboolean
+result_set_is_null (ResultSet *set, guint row, int column)
+{
+  if (row >= set->n_rows || column >= set->n_columns)
+    return TRUE;
+
+  return (set->columns[column].nulls[row / 8] >> (row % 8)) & 1;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#ifndef RESULT_SET_H
+#define RESULT_SET_H
+
+#include "pg_types.h"
+
+#include <glib.h>
+#include <libpq-fe.h>
+
+/* Reference counted, read-only result of one query, stored column by
+ * column. Rows can be appended in batches while a query streams in.
+ * Fixed-width columns received in binary format stay native. */
+typedef struct _ResultSet ResultSet;
+
+ResultSet *result_set_new (PGresult *res);
+ResultSet *result_set_new_empty (void);
+ResultSet *result_set_ref (ResultSet *set);
+void result_set_unref (ResultSet *set);
+
+void result_set_append (ResultSet *set, PGresult *res);
+
+guint result_set_get_n_rows (ResultSet *set);
+gsize result_set_get_n_bytes (ResultSet *set);
+int result_set_get_n_columns (ResultSet *set);
+
+const char *result_set_get_column_name (ResultSet *set, int column);
+char **result_set_dup_column_names (ResultSet *set);
+Oid *result_set_dup_column_types (ResultSet *set);
+Oid result_set_get_column_type (ResultSet *set, int column);
+PgKind result_set_get_column_kind (ResultSet *set, int column);
+
+const char *result_set_format_value (ResultSet *set,
+                                     guint row,
+                                     int column,
+                                     char *buf,
+                                     gsize size);
+const char *result_set_get_text (ResultSet *set, guint row, int column);
+const char *result_set_get_text_column (ResultSet *set, int column, const gsize **offsets);
+gsize result_set_get_length (ResultSet *set, guint row, int column);
+PgNative result_set_get_native (ResultSet *set, guint row, int column);
+gboolean result_set_is_null (ResultSet *set, guint row, int column);
+
+#endif
\ No newline at end of file
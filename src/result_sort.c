@@ -0,0 +1,486 @@
+#include "result_sort.h"
+#include "work_pool.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Every row gets a key up front, so comparisons never parse or collate:
+ * numbers compare as numbers, numeric by its digits, dates and timestamps
+ * as microseconds and text by its collation key. The rows are split into one chunk per core,
+ * each chunk is keyed and sorted on the work pool, and the sorted runs
+ * are then merged pairwise, again on the pool, until one run is left. */
+
+/* Smaller chunks cost more in handoffs than they gain in parallelism */
+#define MIN_CHUNK_ROWS 16384
+#define CANCEL_CHECK_ROWS 4096
+
+typedef enum
+{
+  SORT_KEY_INT,
+  SORT_KEY_FLOAT,
+  SORT_KEY_NUMERIC,
+  SORT_KEY_BYTES,
+  SORT_KEY_COLLATE
+} SortKeyKind;
+
+typedef union
+{
+  gint64 i;
+  double f;
+  const char *s;
+} SortKey;
+
+typedef struct
+{
+  ResultSet *set;
+  int column;
+  Oid type;
+  gboolean native;
+  gboolean descending;
+  SortKeyKind kind;
+  GTimeZone *utc;
+
+  guint n_rows;
+  SortKey *keys;
+  guint8 *nulls;
+  guint *order;
+  guint *scratch;
+
+  GCancellable *cancellable;
+
+  /* Edges of the sorted runs, and the merge pass in flight */
+  guint *bounds;
+  const guint *src;
+  guint *dst;
+} SortJob;
+
+static SortKeyKind
+sort_key_kind (PgKind kind, Oid type)
+{
+  switch (kind)
+    {
+    case PG_KIND_TEXT:
+      break;
+    case PG_KIND_FLOAT4:
+    case PG_KIND_FLOAT:
+      return SORT_KEY_FLOAT;
+    default:
+      return SORT_KEY_INT;
+    }
+
+  /* Received as text, or rendered to text on arrival */
+  switch (type)
+    {
+    case BOOLOID:
+    case INT2OID:
+    case INT4OID:
+    case INT8OID:
+    case OIDOID:
+    case DATEOID:
+    case TIMEOID:
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID:
+      return SORT_KEY_INT;
+    case FLOAT4OID:
+    case FLOAT8OID:
+      return SORT_KEY_FLOAT;
+    case NUMERICOID:
+      return SORT_KEY_NUMERIC;
+    case BYTEAOID:
+    case CHAROID:
+    case NAMEOID:
+    case UUIDOID:
+      return SORT_KEY_BYTES;
+    default:
+      return SORT_KEY_COLLATE;
+    }
+}
+
+/* Microseconds since the Unix epoch of a date or timestamp printed with
+ * DateStyle ISO. Values GLib can't parse, such as BC dates, sort as the
+ * epoch. */
+static gint64
+text_to_epoch (const char *text, gboolean date_only, GTimeZone *utc)
+{
+  if (strcmp (text, "infinity") == 0)
+    return G_MAXINT64;
+
+  if (strcmp (text, "-infinity") == 0)
+    return G_MININT64;
+
+  char buf[64];
+
+  g_snprintf (buf, sizeof (buf), date_only ? "%sT00:00:00" : "%s", text);
+
+  char *space = strchr (buf, ' ');
+
+  if (space)
+    *space = 'T';
+
+  GDateTime *time = g_date_time_new_from_iso8601 (buf, utc);
+
+  if (!time)
+    return 0;
+
+  gint64 usec = g_date_time_to_unix (time) * G_USEC_PER_SEC + g_date_time_get_microsecond (time);
+
+  g_date_time_unref (time);
+
+  return usec;
+}
+
+/* Microseconds since midnight of HH:MM:SS[.ffffff] */
+static gint64
+text_to_time (const char *text)
+{
+  char *end;
+  gint64 hours = g_ascii_strtoll (text, &end, 10);
+  gint64 minutes = 0;
+  double seconds = 0;
+
+  if (*end == ':')
+    minutes = g_ascii_strtoll (end + 1, &end, 10);
+
+  if (*end == ':')
+    seconds = g_ascii_strtod (end + 1, NULL);
+
+  return (hours * 60 + minutes) * 60 * G_USEC_PER_SEC + (gint64) (seconds * G_USEC_PER_SEC + 0.5);
+}
+
+static gint64
+text_to_int (SortJob *job, const char *text)
+{
+  switch (job->type)
+    {
+    case BOOLOID:
+      return text[0] == 't';
+    case DATEOID:
+      return text_to_epoch (text, TRUE, job->utc);
+    case TIMEOID:
+      return text_to_time (text);
+    case TIMESTAMPOID:
+    case TIMESTAMPTZOID:
+      return text_to_epoch (text, FALSE, job->utc);
+    default:
+      return g_ascii_strtoll (text, NULL, 10);
+    }
+}
+
+static void
+sort_job_build_keys (SortJob *job, guint lo, guint hi)
+{
+  for (guint r = lo; r < hi; r++)
+    {
+      if ((r - lo) % CANCEL_CHECK_ROWS == 0 && g_cancellable_is_cancelled (job->cancellable))
+        return;
+
+      job->order[r] = r;
+      job->nulls[r] = result_set_is_null (job->set, r, job->column);
+
+      if (job->nulls[r])
+        continue;
+
+      SortKey *key = &job->keys[r];
+
+      if (job->native)
+        {
+          PgNative value = result_set_get_native (job->set, r, job->column);
+
+          if (job->kind == SORT_KEY_FLOAT)
+            key->f = value.f;
+          else
+            key->i = value.i;
+
+          continue;
+        }
+
+      const char *text = result_set_get_text (job->set, r, job->column);
+
+      switch (job->kind)
+        {
+        case SORT_KEY_INT:
+          key->i = text_to_int (job, text);
+          break;
+        case SORT_KEY_FLOAT:
+          key->f = g_ascii_strtod (text, NULL);
+          break;
+        case SORT_KEY_NUMERIC:
+        case SORT_KEY_BYTES:
+          key->s = text;
+          break;
+        case SORT_KEY_COLLATE:
+          key->s = g_utf8_collate_key (text, result_set_get_length (job->set, r, job->column));
+          break;
+        }
+    }
+}
+
+/* NaN sorts above every number, as in Postgres */
+static int
+compare_floats (double a, double b)
+{
+  if (isnan (a) || isnan (b))
+    return !!isnan (a) - !!isnan (b);
+
+  return (a > b) - (a < b);
+}
+
+/* -Infinity, negative, zero or positive, Infinity and NaN, in the order
+ * Postgres sorts them */
+static int
+numeric_class (const char *text)
+{
+  if (strcmp (text, "NaN") == 0)
+    return 3;
+
+  if (strcmp (text, "Infinity") == 0)
+    return 2;
+
+  if (strcmp (text, "-Infinity") == 0)
+    return -2;
+
+  return text[0] == '-' ? -1 : 1;
+}
+
+/* Compares unsigned numbers printed without leading zeros or exponent:
+ * a longer integer part is larger, then digits decide from the left */
+static int
+compare_magnitudes (const char *a, const char *b)
+{
+  gsize int_a = strcspn (a, ".");
+  gsize int_b = strcspn (b, ".");
+
+  if (int_a != int_b)
+    return int_a < int_b ? -1 : 1;
+
+  int cmp = strncmp (a, b, int_a);
+
+  if (cmp != 0)
+    return cmp < 0 ? -1 : 1;
+
+  a += int_a + (a[int_a] == '.');
+  b += int_b + (b[int_b] == '.');
+
+  /* Missing fraction digits count as zeros */
+  while (*a || *b)
+    {
+      char da = *a ? *a++ : '0';
+      char db = *b ? *b++ : '0';
+
+      if (da != db)
+        return da < db ? -1 : 1;
+    }
+
+  return 0;
+}
+
+/* numeric values as printed by the server, compared exactly: as doubles
+ * they would round past 15 or so significant digits */
+static int
+compare_numerics (const char *a, const char *b)
+{
+  int class_a = numeric_class (a);
+  int class_b = numeric_class (b);
+
+  if (class_a != class_b)
+    return (class_a > class_b) - (class_a < class_b);
+
+  if (class_a == -1)
+    return compare_magnitudes (b + 1, a + 1);
+
+  if (class_a == 1)
+    return compare_magnitudes (a, b);
+
+  return 0;
+}
+
+static int
+sort_job_compare (const SortJob *job, guint a, guint b)
+{
+  const SortKey *ka = &job->keys[a];
+  const SortKey *kb = &job->keys[b];
+  int cmp;
+
+  if (job->nulls[a] || job->nulls[b])
+    cmp = job->nulls[a] - job->nulls[b];
+  else if (job->kind == SORT_KEY_INT)
+    cmp = (ka->i > kb->i) - (ka->i < kb->i);
+  else if (job->kind == SORT_KEY_FLOAT)
+    cmp = compare_floats (ka->f, kb->f);
+  else if (job->kind == SORT_KEY_NUMERIC)
+    cmp = compare_numerics (ka->s, kb->s);
+  else
+    cmp = strcmp (ka->s, kb->s);
+
+  return job->descending ? -cmp : cmp;
+}
+
+static gint
+compare_rows (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  return sort_job_compare (user_data, *(const guint *) a, *(const guint *) b);
+}
+
+/* Stable: of two equal rows the one from the left run comes first */
+static void
+merge_runs (const SortJob *job, const guint *src, guint *dst, guint lo, guint mid, guint hi)
+{
+  guint i = lo;
+  guint j = mid;
+  guint k = lo;
+
+  while (i < mid && j < hi)
+    dst[k++] = sort_job_compare (job, src[j], src[i]) < 0 ? src[j++] : src[i++];
+
+  memcpy (dst + k, src + i, (mid - i) * sizeof (guint));
+  k += mid - i;
+  memcpy (dst + k, src + j, (hi - j) * sizeof (guint));
+}
+
+static void
+sort_chunk (guint index, gpointer user_data)
+{
+  SortJob *job = user_data;
+  guint lo = job->bounds[index];
+  guint hi = job->bounds[index + 1];
+
+  sort_job_build_keys (job, lo, hi);
+
+  if (!g_cancellable_is_cancelled (job->cancellable))
+    g_qsort_with_data (job->order + lo, hi - lo, sizeof (guint), compare_rows, job);
+}
+
+/* Merges runs 2 * index and 2 * index + 1 */
+static void
+merge_pair (guint index, gpointer user_data)
+{
+  SortJob *job = user_data;
+  guint *bounds = job->bounds + 2 * index;
+
+  if (!g_cancellable_is_cancelled (job->cancellable))
+    merge_runs (job, job->src, job->dst, bounds[0], bounds[1], bounds[2]);
+}
+
+static void
+sort_job_free (gpointer data)
+{
+  SortJob *job = data;
+
+  if (job->kind == SORT_KEY_COLLATE)
+    for (guint r = 0; r < job->n_rows; r++)
+      g_free ((char *) job->keys[r].s);
+
+  g_free (job->keys);
+  g_free (job->nulls);
+  g_free (job->order);
+  g_free (job->scratch);
+  g_free (job->bounds);
+
+  g_clear_object (&job->cancellable);
+  g_time_zone_unref (job->utc);
+  result_set_unref (job->set);
+  g_free (job);
+}
+
+static void
+sort_thread (GTask *task, gpointer source, gpointer task_data, GCancellable *cancellable)
+{
+  (void) source;
+  (void) cancellable;
+
+  SortJob *job = task_data;
+  guint n_runs = CLAMP (job->n_rows / MIN_CHUNK_ROWS, 1, work_pool_get_n_threads ());
+
+  job->bounds = g_new (guint, n_runs + 1);
+
+  for (guint i = 0; i <= n_runs; i++)
+    job->bounds[i] = (guint) ((guint64) job->n_rows * i / n_runs);
+
+  work_pool_run (n_runs, sort_chunk, job);
+
+  guint *src = job->order;
+  guint *dst = job->scratch;
+  guint *bounds = job->bounds;
+
+  while (n_runs > 1 && !g_cancellable_is_cancelled (job->cancellable))
+    {
+      job->src = src;
+      job->dst = dst;
+
+      /* An odd run out is carried over as it is */
+      if (n_runs % 2)
+        memcpy (dst + bounds[n_runs - 1], src + bounds[n_runs - 1],
+                (bounds[n_runs] - bounds[n_runs - 1]) * sizeof (guint));
+
+      work_pool_run (n_runs / 2, merge_pair, job);
+
+      guint merged = 0;
+
+      for (guint i = 0; i < n_runs; i += 2)
+        bounds[merged++] = bounds[i];
+
+      bounds[merged] = bounds[n_runs];
+      n_runs = merged;
+
+      guint *swap = src;
+
+      src = dst;
+      dst = swap;
+    }
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  if (src == job->order)
+    job->order = NULL;
+  else
+    job->scratch = NULL;
+
+  g_task_return_pointer (task, src, g_free);
+}
+
+void
+result_sort_async (ResultSet *set,
+                   int column,
+                   gboolean descending,
+                   GCancellable *cancellable,
+                   GAsyncReadyCallback callback,
+                   gpointer user_data)
+{
+  GTask *task = g_task_new (NULL, cancellable, callback, user_data);
+  SortJob *job = g_new0 (SortJob, 1);
+  guint n_rows = result_set_get_n_rows (set);
+  PgKind kind = result_set_get_column_kind (set, column);
+
+  job->set = result_set_ref (set);
+  job->column = column;
+  job->type = result_set_get_column_type (set, column);
+  job->native = kind != PG_KIND_TEXT;
+  job->descending = descending;
+  job->kind = sort_key_kind (kind, job->type);
+  job->utc = g_time_zone_new_utc ();
+
+  job->n_rows = n_rows;
+  job->keys = g_new0 (SortKey, n_rows);
+  job->nulls = g_new0 (guint8, n_rows);
+  job->order = g_new (guint, MAX (n_rows, 1));
+  job->scratch = g_new (guint, MAX (n_rows, 1));
+
+  job->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+
+  g_task_set_task_data (task, job, sort_job_free);
+  g_task_run_in_thread (task, sort_thread);
+  g_object_unref (task);
+}
+
+/* Returns the permutation, n_rows long */
+guint *
+result_sort_finish (GAsyncResult *result, guint *n_rows, GError **error)
+{
+  guint *order = g_task_propagate_pointer (G_TASK (result), error);
+
+  if (order && n_rows)
+    *n_rows = ((SortJob *) g_task_get_task_data (G_TASK (result)))->n_rows;
+
+  return order;
+}
\ No newline at end of file
@@ -0,0 +1,21 @@
+#ifndef RESULT_SORT_H
+#define RESULT_SORT_H
+
+#include "result_set.h"
+
+#include <gio/gio.h>
+#include <glib.h>
+
+/* Sorts the rows of a complete ResultSet by one column on a worker pool.
+ * The set must not grow while the sort runs. The result is a permutation:
+ * element i is the set row shown at position i. Nulls sort last, or first
+ * when descending, as in Postgres. */
+void result_sort_async (ResultSet *set,
+                        int column,
+                        gboolean descending,
+                        GCancellable *cancellable,
+                        GAsyncReadyCallback callback,
+                        gpointer user_data);
+guint *result_sort_finish (GAsyncResult *result, guint *n_rows, GError **error);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "sql_text.h"
+
+#include <string.h>
+
+static gboolean
+is_ident_char (char c)
+{
+  return g_ascii_isalnum (c) || c == '_' || c == '$' || (guchar) c >= 0x80;
+}
+
+/* Length of the $tag$ opening a dollar quoted string at p, or 0 */
+static gsize
+dollar_tag_length (const char *p)
+{
+  gsize len = 1;
+
+  if (g_ascii_isdigit (p[1]))
+    return 0;
+
+  while (p[len] && (g_ascii_isalnum (p[len]) || p[len] == '_' || (guchar) p[len] >= 0x80))
+    len++;
+
+  return p[len] == '$' ? len + 1 : 0;
+}
+
+static gboolean
+is_comment (const char *p)
+{
+  return (p[0] == '-' && p[1] == '-') || (p[0] == '/' && p[1] == '*');
+}
+
+/* Length of the token at p within sql: a whole comment, quoted string or
+ * dollar quoted string, or else a single byte. Unterminated ones run to
+ * the end. */
+static gsize
+token_length (const char *sql, const char *p)
+{
+  if (p[0] == '-' && p[1] == '-')
+    return strcspn (p, "\n");
+
+  if (p[0] == '/' && p[1] == '*')
+    {
+      const char *end = strstr (p + 2, "*/");
+
+      return end ? (gsize) (end + 2 - p) : strlen (p);
+    }
+
+  if (*p == '\'' || *p == '"')
+    {
+      /* E'...' strings escape with backslashes */
+      gboolean escapes = *p == '\'' && p > sql && (p[-1] == 'e' || p[-1] == 'E')
+                         && (p - 1 == sql || !is_ident_char (p[-2]));
+      const char *q = p + 1;
+
+      while (*q && *q != *p)
+        q += escapes && *q == '\\' && q[1] ? 2 : 1;
+
+      return *q ? (gsize) (q + 1 - p) : (gsize) (q - p);
+    }
+
+  if (*p == '$' && (p == sql || !is_ident_char (p[-1])) && dollar_tag_length (p) > 0)
+    {
+      gsize tag = dollar_tag_length (p);
+      char *delimiter = g_strndup (p, tag);
+      const char *end = strstr (p + tag, delimiter);
+
+      g_free (delimiter);
+
+      return end ? (gsize) (end + tag - p) : strlen (p);
+    }
+
+  return 1;
+}
+
+/* The statement as the server would read it, so statements differing
+ * only in layout, comments or keyword case compare equal: whitespace runs
+ * become one space, comments go, everything outside quotes and literals
+ * is lowercased and trailing semicolons are dropped. */
+char *
+sql_text_normalize (const char *sql)
+{
+  GString *out = g_string_sized_new (strlen (sql));
+  const char *p = sql;
+  gboolean space = FALSE;
+
+  while (*p)
+    {
+      gsize len = token_length (sql, p);
+
+      if (g_ascii_isspace (*p) || is_comment (p))
+        {
+          p += len;
+          space = TRUE;
+          continue;
+        }
+
+      if (space && out->len > 0)
+        g_string_append_c (out, ' ');
+
+      space = FALSE;
+
+      if (len > 1)
+        g_string_append_len (out, p, len);
+      else
+        g_string_append_c (out, g_ascii_tolower (*p));
+
+      p += len;
+    }
+
+  while (out->len > 0 && (out->str[out->len - 1] == ';' || out->str[out->len - 1] == ' '))
+    g_string_truncate (out, out->len - 1);
+
+  return g_string_free (out, FALSE);
+}
+
+/* Statements in sql, not counting empty ones between semicolons */
+guint
+sql_text_count_statements (const char *sql)
+{
+  guint count = 0;
+  gboolean content = FALSE;
+
+  for (const char *p = sql; *p; p += token_length (sql, p))
+    {
+      if (*p == ';')
+        {
+          count += content;
+          content = FALSE;
+        }
+      else if (!g_ascii_isspace (*p) && !is_comment (p))
+        {
+          content = TRUE;
+        }
+    }
+
+  return count + content;
+}
+
+/* A copy of sql without the whitespace, comments and semicolons that end
+ * it, so it can be embedded in another statement */
+char *
+sql_text_strip_end (const char *sql)
+{
+  const char *end = sql;
+
+  for (const char *p = sql; *p;)
+    {
+      gsize len = token_length (sql, p);
+
+      if (*p != ';' && !g_ascii_isspace (*p) && !is_comment (p))
+        end = p + len;
+
+      p += len;
+    }
+
+  return g_strndup (sql, end - sql);
+}
\ No newline at end of file
@@ -0,0 +1,13 @@
+#ifndef SQL_TEXT_H
+#define SQL_TEXT_H
+
+#include <glib.h>
+
+/* SQL text read the way the server splits it: semicolons, comments and
+ * case only count outside string constants, quoted identifiers and
+ * dollar quoted strings */
+char *sql_text_normalize (const char *sql);
+guint sql_text_count_statements (const char *sql);
+char *sql_text_strip_end (const char *sql);
+
+#endif
\ No newline at end of file
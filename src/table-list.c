@@ -0,0 +1,278 @@
+#include "table-list.h"
+#include "table-row.h"
+#include "table_index.h"
+
+/* GListModel of the catalog's tables, as TableRow items made only for the
+ * rows a view shows. A filter narrows and ranks the names through a
+ * TableIndex built when the catalog changes; a sort then reorders what
+ * is left by name or by one of the table's figures. */
+struct _TableList
+{
+  GObject parent_instance;
+
+  char **names;
+  Oid *oids;
+  guint n_names;
+  TableIndex *index;
+
+  /* Oid to TableStats, and each name's entry in it or NULL */
+  GHashTable *stats;
+  const TableStats **name_stats;
+
+  char *query;
+  TableListSort sort;
+  gboolean descending;
+
+  /* Name shown at each position, NULL when showing every name in order */
+  guint *positions;
+  guint n_positions;
+};
+
+static void table_list_list_model_init (GListModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (TableList,
+                         table_list,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (G_TYPE_LIST_MODEL, table_list_list_model_init))
+
+static GType
+table_list_get_item_type (GListModel *model)
+{
+  (void) model;
+
+  return TYPE_TABLE_ROW;
+}
+
+static guint
+table_list_get_n_items (GListModel *model)
+{
+  TableList *list = TABLE_LIST (model);
+
+  return list->positions ? list->n_positions : list->n_names;
+}
+
+static gpointer
+table_list_get_item (GListModel *model, guint position)
+{
+  TableList *list = TABLE_LIST (model);
+
+  if (position >= table_list_get_n_items (model))
+    return NULL;
+
+  guint name = list->positions ? list->positions[position] : position;
+
+  return table_row_new (list->names[name], list->name_stats[name]);
+}
+
+static void
+table_list_list_model_init (GListModelInterface *iface)
+{
+  iface->get_item_type = table_list_get_item_type;
+  iface->get_n_items = table_list_get_n_items;
+  iface->get_item = table_list_get_item;
+}
+
+static void
+table_list_finalize (GObject *object)
+{
+  TableList *list = TABLE_LIST (object);
+
+  g_strfreev (list->names);
+  g_free (list->oids);
+  table_index_free (list->index);
+  g_clear_pointer (&list->stats, g_hash_table_unref);
+  g_free (list->name_stats);
+  g_free (list->query);
+  g_free (list->positions);
+
+  G_OBJECT_CLASS (table_list_parent_class)->finalize (object);
+}
+
+static void
+table_list_class_init (TableListClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = table_list_finalize;
+}
+
+static void
+table_list_init (TableList *self)
+{
+  self->names = g_new0 (char *, 1);
+  self->name_stats = g_new0 (const TableStats *, 1);
+}
+
+TableList *
+table_list_new (void)
+{
+  return g_object_new (TYPE_TABLE_LIST, NULL);
+}
+
+/* Tables without figures, such as views, sort below every other */
+static gint64
+table_list_sort_key (TableList *list, guint name)
+{
+  const TableStats *stats = list->name_stats[name];
+
+  if (!stats)
+    return G_MININT64;
+
+  switch (list->sort)
+    {
+    case TABLE_LIST_SORT_ROWS:
+      return stats->estimated_rows;
+    case TABLE_LIST_SORT_SIZE:
+      return stats->total_bytes;
+    case TABLE_LIST_SORT_VACUUMED:
+      return stats->last_vacuum;
+    case TABLE_LIST_SORT_ANALYZED:
+      return stats->last_analyze;
+    default:
+      return 0;
+    }
+}
+
+/* Names are in catalog order, so by name is by index. Stable, so equal
+ * keys keep their search rank. */
+static gint
+compare_names (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+  TableList *list = user_data;
+  guint na = *(const guint *) a;
+  guint nb = *(const guint *) b;
+  int cmp;
+
+  if (list->sort == TABLE_LIST_SORT_NAME)
+    {
+      cmp = (na > nb) - (na < nb);
+    }
+  else
+    {
+      gint64 ka = table_list_sort_key (list, na);
+      gint64 kb = table_list_sort_key (list, nb);
+
+      cmp = (ka > kb) - (ka < kb);
+    }
+
+  return list->descending ? -cmp : cmp;
+}
+
+/* Recomputes what is shown and replaces every row in one change */
+static void
+table_list_update (TableList *list, guint old_n_items)
+{
+  g_clear_pointer (&list->positions, g_free);
+  list->n_positions = 0;
+
+  if (list->index && list->query && list->query[0])
+    list->positions = table_index_search (list->index, list->query, &list->n_positions);
+
+  if (list->sort != TABLE_LIST_SORT_NONE)
+    {
+      if (!list->positions)
+        {
+          list->positions = g_new (guint, MAX (list->n_names, 1));
+          list->n_positions = list->n_names;
+
+          for (guint i = 0; i < list->n_names; i++)
+            list->positions[i] = i;
+        }
+
+      g_qsort_with_data (list->positions, list->n_positions, sizeof (guint), compare_names,
+                         list);
+    }
+
+  g_list_model_items_changed (G_LIST_MODEL (list), 0, old_n_items,
+                              table_list_get_n_items (G_LIST_MODEL (list)));
+}
+
+static void
+table_list_match_stats (TableList *list)
+{
+  for (guint i = 0; i < list->n_names; i++)
+    list->name_stats[i] =
+        list->stats ? g_hash_table_lookup (list->stats, GUINT_TO_POINTER (list->oids[i])) : NULL;
+}
+
+/* Takes the names of every table in catalog, which may be NULL. The
+ * filter, sort and figures stay and apply to the new tables. */
+void
+table_list_set_catalog (TableList *list, Catalog *catalog)
+{
+  guint old_n_items = table_list_get_n_items (G_LIST_MODEL (list));
+  guint n = catalog ? catalog_get_n_tables (catalog) : 0;
+
+  g_strfreev (list->names);
+  g_free (list->oids);
+  g_free (list->name_stats);
+  table_index_free (list->index);
+
+  list->names = g_new (char *, n + 1);
+  list->oids = g_new (Oid, MAX (n, 1));
+  list->name_stats = g_new0 (const TableStats *, MAX (n, 1));
+  list->n_names = n;
+
+  for (guint i = 0; i < n; i++)
+    {
+      const CatalogTable *table = catalog_get_table (catalog, i);
+
+      list->names[i] = g_strdup (table->full_name);
+      list->oids[i] = table->oid;
+    }
+
+  list->names[n] = NULL;
+  list->index = table_index_new ((const char *const *) list->names, n);
+
+  table_list_match_stats (list);
+  table_list_update (list, old_n_items);
+}
+
+/* Takes a reference on stats, a table of TableStats by oid */
+void
+table_list_set_stats (TableList *list, GHashTable *stats)
+{
+  g_clear_pointer (&list->stats, g_hash_table_unref);
+  list->stats = stats ? g_hash_table_ref (stats) : NULL;
+
+  table_list_match_stats (list);
+  table_list_update (list, table_list_get_n_items (G_LIST_MODEL (list)));
+}
+
+/* Shows only the names matching query, best first; empty shows them all */
+void
+table_list_set_filter (TableList *list, const char *query)
+{
+  if (g_strcmp0 (query, list->query) == 0)
+    return;
+
+  guint old_n_items = table_list_get_n_items (G_LIST_MODEL (list));
+
+  g_free (list->query);
+  list->query = g_strdup (query);
+
+  table_list_update (list, old_n_items);
+}
+
+/* TABLE_LIST_SORT_NONE leaves matches in rank order and the rest in
+ * catalog order */
+void
+table_list_set_sort (TableList *list, TableListSort sort, gboolean descending)
+{
+  if (sort == list->sort && descending == list->descending)
+    return;
+
+  list->sort = sort;
+  list->descending = descending;
+
+  table_list_update (list, table_list_get_n_items (G_LIST_MODEL (list)));
+}
+
+const char *
+table_list_get_name (TableList *list, guint position)
+{
+  if (position >= table_list_get_n_items (G_LIST_MODEL (list)))
+    return NULL;
+
+  return list->names[list->positions ? list->positions[position] : position];
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#ifndef TABLE_LIST_H
+#define TABLE_LIST_H
+
+#include "catalog.h"
+
+#include <gio/gio.h>
+
+#define TYPE_TABLE_LIST (table_list_get_type ())
+G_DECLARE_FINAL_TYPE (TableList, table_list, TABLE, LIST, GObject)
+
+typedef enum
+{
+  TABLE_LIST_SORT_NONE,
+  TABLE_LIST_SORT_NAME,
+  TABLE_LIST_SORT_ROWS,
+  TABLE_LIST_SORT_SIZE,
+  TABLE_LIST_SORT_VACUUMED,
+  TABLE_LIST_SORT_ANALYZED
+} TableListSort;
+
+TableList *table_list_new (void);
+
+void table_list_set_catalog (TableList *list, Catalog *catalog);
+void table_list_set_stats (TableList *list, GHashTable *stats);
+void table_list_set_filter (TableList *list, const char *query);
+void table_list_set_sort (TableList *list, TableListSort sort, gboolean descending);
+
+const char *table_list_get_name (TableList *list, guint position);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include "table-row.h"
+
+struct _TableRow
+{
+  GObject parent_instance;
+
+  char *name;
+  TableStats stats;
+  gboolean has_stats;
+};
+
+G_DEFINE_TYPE (TableRow, table_row, G_TYPE_OBJECT)
+
+static void
+table_row_dispose (GObject *object)
+{
+  TableRow *row = TABLE_ROW (object);
+
+  g_clear_pointer (&row->name, g_free);
+
+  G_OBJECT_CLASS (table_row_parent_class)->dispose (object);
+}
+
+static void
+table_row_class_init (TableRowClass *klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->dispose = table_row_dispose;
+}
+
+static void
+table_row_init (TableRow *self)
+{
+  (void) self;
+}
+
+/* stats is NULL for views and while the figures are being fetched */
+TableRow *
+table_row_new (const char *name, const TableStats *stats)
+{
+  TableRow *row = g_object_new (TYPE_TABLE_ROW, NULL);
+
+  row->name = g_strdup (name);
+
+  if (stats)
+    {
+      row->stats = *stats;
+      row->has_stats = TRUE;
+    }
+
+  return row;
+}
+
+const char *
+table_row_get_name (TableRow *row)
+{
+  return row->name;
+}
+
+const TableStats *
+table_row_get_stats (TableRow *row)
+{
+  return row->has_stats ? &row->stats : NULL;
+}
\ No newline at end of file
@@ -0,0 +1,16 @@
+#ifndef TABLE_ROW_H
+#define TABLE_ROW_H
+
+#include "catalog.h"
+
+#include <glib-object.h>
+
+#define TYPE_TABLE_ROW (table_row_get_type ())
+G_DECLARE_FINAL_TYPE (TableRow, table_row, TABLE, ROW, GObject)
+
+TableRow *table_row_new (const char *name, const TableStats *stats);
+
+const char *table_row_get_name (TableRow *row);
+const TableStats *table_row_get_stats (TableRow *row);
+
+#endif
\ No newline at end of file
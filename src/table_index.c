@@ -0,0 +1,269 @@
+#include "table_index.h"
+
+#include <string.h>
+
+/* Names are indexed lowercased by their trigrams, every run of three
+ * bytes. The index is a sorted list of the distinct trigrams, each with
+ * the names containing it, so a query looks up its own trigrams and counts
+ * how many each name shares. Names sharing at least a third of them
+ * match, which lets typos through. Matches containing the query as it is
+ * rank first, then the ones sharing the most trigrams. Queries shorter
+ * than a trigram scan the names instead. */
+
+typedef struct
+{
+  guint32 trigram;
+  guint32 name;
+} Posting;
+
+typedef struct
+{
+  guint name;
+  /* 0 for a substring at a word start, 1 elsewhere, 2 for fuzzy matches */
+  guint rank;
+  guint shared;
+  guint length;
+} Match;
+
+struct _TableIndex
+{
+  guint n_names;
+  char **lower;
+
+  guint n_trigrams;
+  guint32 *trigrams;
+  /* Names of trigram i are postings[starts[i]] to postings[starts[i + 1]] */
+  guint *starts;
+  guint32 *postings;
+};
+
+static guint32
+trigram_at (const char *s)
+{
+  return ((guint32) (guchar) s[0] << 16) | ((guint32) (guchar) s[1] << 8) | (guchar) s[2];
+}
+
+static int
+compare_postings (gconstpointer a, gconstpointer b)
+{
+  const Posting *pa = a;
+  const Posting *pb = b;
+
+  if (pa->trigram != pb->trigram)
+    return pa->trigram < pb->trigram ? -1 : 1;
+
+  return (pa->name > pb->name) - (pa->name < pb->name);
+}
+
+TableIndex *
+table_index_new (const char *const *names, guint n_names)
+{
+  TableIndex *index = g_new0 (TableIndex, 1);
+  GArray *postings = g_array_new (FALSE, FALSE, sizeof (Posting));
+
+  index->n_names = n_names;
+  index->lower = g_new0 (char *, n_names + 1);
+
+  for (guint i = 0; i < n_names; i++)
+    {
+      index->lower[i] = g_ascii_strdown (names[i], -1);
+
+      gsize len = strlen (index->lower[i]);
+
+      for (gsize j = 0; j + 3 <= len; j++)
+        {
+          Posting posting = { trigram_at (index->lower[i] + j), i };
+
+          g_array_append_val (postings, posting);
+        }
+    }
+
+  g_array_sort (postings, compare_postings);
+
+  index->trigrams = g_new (guint32, MAX (postings->len, 1));
+  index->starts = g_new (guint, postings->len + 1);
+  index->postings = g_new (guint32, MAX (postings->len, 1));
+
+  guint n = 0;
+
+  for (guint i = 0; i < postings->len; i++)
+    {
+      const Posting *posting = &g_array_index (postings, Posting, i);
+
+      /* A name repeating a trigram is listed once */
+      if (i > 0 && compare_postings (posting, posting - 1) == 0)
+        continue;
+
+      if (index->n_trigrams == 0 || index->trigrams[index->n_trigrams - 1] != posting->trigram)
+        {
+          index->trigrams[index->n_trigrams] = posting->trigram;
+          index->starts[index->n_trigrams++] = n;
+        }
+
+      index->postings[n++] = posting->name;
+    }
+
+  index->starts[index->n_trigrams] = n;
+
+  g_array_unref (postings);
+
+  return index;
+}
+
+void
+table_index_free (TableIndex *index)
+{
+  if (!index)
+    return;
+
+  g_strfreev (index->lower);
+  g_free (index->trigrams);
+  g_free (index->starts);
+  g_free (index->postings);
+  g_free (index);
+}
+
+/* Position of trigram in the index, or -1 */
+static int
+table_index_find (TableIndex *index, guint32 trigram)
+{
+  int lo = 0;
+  int hi = (int) index->n_trigrams - 1;
+
+  while (lo <= hi)
+    {
+      int mid = lo + (hi - lo) / 2;
+
+      if (index->trigrams[mid] == trigram)
+        return mid;
+
+      if (index->trigrams[mid] < trigram)
+        lo = mid + 1;
+      else
+        hi = mid - 1;
+    }
+
+  return -1;
+}
+
+static gboolean
+is_word_start (const char *name, const char *at)
+{
+  return at == name || at[-1] == '.' || at[-1] == '_' || at[-1] == ' ';
+}
+
+static void
+add_match (GArray *matches, TableIndex *index, guint name, const char *query, guint shared)
+{
+  const char *lower = index->lower[name];
+  const char *at = strstr (lower, query);
+  Match match = { name, 2, shared, strlen (lower) };
+
+  if (at)
+    match.rank = is_word_start (lower, at) ? 0 : 1;
+
+  g_array_append_val (matches, match);
+}
+
+/* Ties keep the order the names were given in */
+static int
+compare_matches (gconstpointer a, gconstpointer b)
+{
+  const Match *ma = a;
+  const Match *mb = b;
+
+  if (ma->rank != mb->rank)
+    return ma->rank < mb->rank ? -1 : 1;
+
+  if (ma->shared != mb->shared)
+    return ma->shared > mb->shared ? -1 : 1;
+
+  if (ma->length != mb->length)
+    return ma->length < mb->length ? -1 : 1;
+
+  return (ma->name > mb->name) - (ma->name < mb->name);
+}
+
+/* Names matching query, best first, as indices into the names the index
+ * was built from. An empty query matches every name in order. */
+guint *
+table_index_search (TableIndex *index, const char *query, guint *n_matches)
+{
+  char *lower = g_ascii_strdown (query, -1);
+  gsize len = strlen (lower);
+  GArray *matches = g_array_new (FALSE, FALSE, sizeof (Match));
+
+  if (len == 0)
+    {
+      for (guint i = 0; i < index->n_names; i++)
+        {
+          Match match = { i, 0, 0, 0 };
+
+          g_array_append_val (matches, match);
+        }
+    }
+  else if (len < 3)
+    {
+      for (guint i = 0; i < index->n_names; i++)
+        if (strstr (index->lower[i], lower))
+          add_match (matches, index, i, lower, 0);
+    }
+  else
+    {
+      guint16 *shared = g_new0 (guint16, MAX (index->n_names, 1));
+      GArray *touched = g_array_new (FALSE, FALSE, sizeof (guint32));
+      guint n_query = 0;
+
+      for (gsize j = 0; j + 3 <= len; j++)
+        {
+          /* A trigram the query repeats counts once */
+          gsize k = 0;
+
+          while (k < j && memcmp (lower + k, lower + j, 3) != 0)
+            k++;
+
+          if (k < j)
+            continue;
+
+          n_query++;
+
+          int t = table_index_find (index, trigram_at (lower + j));
+
+          if (t < 0)
+            continue;
+
+          for (guint p = index->starts[t]; p < index->starts[t + 1]; p++)
+            {
+              guint32 name = index->postings[p];
+
+              if (shared[name]++ == 0)
+                g_array_append_val (touched, name);
+            }
+        }
+
+      for (guint i = 0; i < touched->len; i++)
+        {
+          guint32 name = g_array_index (touched, guint32, i);
+
+          if (3 * shared[name] >= n_query)
+            add_match (matches, index, name, lower, shared[name]);
+        }
+
+      g_array_unref (touched);
+      g_free (shared);
+    }
+
+  g_array_sort (matches, compare_matches);
+
+  guint *result = g_new (guint, MAX (matches->len, 1));
+
+  for (guint i = 0; i < matches->len; i++)
+    result[i] = g_array_index (matches, Match, i).name;
+
+  *n_matches = matches->len;
+
+  g_array_unref (matches);
+  g_free (lower);
+
+  return result;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#ifndef TABLE_INDEX_H
+#define TABLE_INDEX_H
+
+#include <glib.h>
+
+/* Fuzzy search over table names, built once per catalog so each query
+ * only touches the names that share part of it */
+typedef struct _TableIndex TableIndex;
+
+TableIndex *table_index_new (const char *const *names, guint n_names);
+void table_index_free (TableIndex *index);
+
+guint *table_index_search (TableIndex *index, const char *query, guint *n_matches);
+
+#endif
\ No newline at end of file
@@ -1,8 +1,18 @@
 #include "ui.h"
+#include "catalog.h"
+#include "data-grid.h"
 #include "db.h"
 #include "generic-row.h"
+#include "paged-model.h"
+#include "plan-row.h"
+#include "query_stats.h"
+#include "result-model.h"
+#include "result_filter.h"
+#include "result_sort.h"
 #include "gtk/gtkshortcut.h"
 #include "schema-row.h"
+#include "table-list.h"
+#include "table-row.h"
 
 #include <gtk/gtk.h>
 #include <stdio.h>
@@ -13,292 +23,1946 @@ typedef struct
   GtkWidget *data_view;
 
   GListStore *schema_store;
-  GListStore *data_store;
+  PagedModel *browse_model;
 
-  GListStore *query_store;
+  ResultModel *query_model;
   GtkWidget *query_view;
   GtkWidget *sql_view;
+  GtkWidget *query_stack;
+  GtkWidget *plan_view;
+  GtkWidget *plan_summary;
+
+  TableList *table_list;
+  GtkWidget *table_search;
+
+  GtkWidget *fetch_rows_label;
+  GtkWidget *fetch_cache_label;
+  GtkWidget *sample_check;
+  GtkWidget *sample_method;
+  GtkWidget *sample_percent;
+  GtkWidget *sample_seed;
+  GtkWidget *fetch_reload_btn;
+  GtkWidget *query_cache_label;
+  GtkWidget *query_reload_btn;
+  GtkWidget *fetch_spinner;
+  GtkWidget *fetch_cancel_btn;
+  GtkWidget *query_spinner;
+  GtkWidget *query_cancel_btn;
+  GtkWidget *status_label;
+  GtkWidget *query_filter_entry;
+  GtkWidget *query_filter_label;
+  GtkWidget *transfer_spinner;
+  GtkWidget *transfer_label;
+  GtkWidget *transfer_cancel_btn;
+  GtkWidget *detail_box;
+  GtkWidget *detail_label;
+  GtkWidget *detail_view;
+
+  GCancellable *catalog_cancellable;
+  GCancellable *stats_cancellable;
+  GCancellable *fetch_cancellable;
+  GCancellable *query_cancellable;
+  GCancellable *explain_cancellable;
+  GCancellable *sort_cancellable;
+  GCancellable *filter_cancellable;
+  /* Shared by exports and imports, one of which runs at a time */
+  GCancellable *transfer_cancellable;
+  GCancellable *detail_cancellable;
+
+  Catalog *catalog;
+  char *catalog_fingerprint;
+  gboolean catalog_force;
+  gboolean query_changes_catalog;
+
+  QueryStats query_stats;
+  char *query_filter;
+  char *query_filter_pending;
+  char *query_text;
+  char *query_error;
+  /* Last plan shown, the statement it is of and the one being explained */
+  ExplainPlan *plan;
+  char *plan_query;
+  char *explain_query;
+  GdkFrameClock *paint_clock;
+
+  /* Table name or query the next chosen export file is for */
+  char *export_source;
+  gboolean export_is_table;
+  char *export_path;
+  char *import_table;
+  gint64 import_started;
 
   char *current_table;
+  char *detail_column;
+  char *browse_order;
+  gboolean browse_descending;
+  gboolean browse_sampled;
+  guint sample_timeout_id;
 } AppWidgets;
 
 static void
-clear_column_view (GtkColumnView *view)
+label_setup (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  GtkWidget *label = gtk_label_new (NULL);
+
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+
+  gtk_widget_set_margin_start (label, 8);
+  gtk_widget_set_margin_end (label, 8);
+  gtk_widget_set_margin_top (label, 2);
+  gtk_widget_set_margin_bottom (label, 2);
+
+  gtk_list_item_set_child (item, label);
+}
+
+static void
+schema_name_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  GtkWidget *label = gtk_list_item_get_child (item);
+  SchemaRow *row = gtk_list_item_get_item (item);
+
+  gtk_label_set_text (GTK_LABEL (label), schema_row_get_name (row));
+}
+
+static void
+schema_type_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  GtkWidget *label = gtk_list_item_get_child (item);
+  SchemaRow *row = gtk_list_item_get_item (item);
+
+  gtk_label_set_text (GTK_LABEL (label), schema_row_get_type_str (row));
+}
+
+static void
+schema_nullable_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  GtkWidget *label = gtk_list_item_get_child (item);
+  SchemaRow *row = gtk_list_item_get_item (item);
+
+  gtk_label_set_text (GTK_LABEL (label), schema_row_get_nullable (row));
+}
+
+static void
+append_schema_columns (GtkColumnView *view)
+{
+  const char *titles[] = { "Name", "Type", "Nullable" };
+
+  GCallback binds[] = { G_CALLBACK (schema_name_bind), G_CALLBACK (schema_type_bind),
+                        G_CALLBACK (schema_nullable_bind) };
+
+  for (int i = 0; i < 3; i++)
+    {
+      GtkListItemFactory *factory = gtk_signal_list_item_factory_new ();
+
+      g_signal_connect (factory, "setup", G_CALLBACK (label_setup), NULL);
+
+      g_signal_connect (factory, "bind", binds[i], NULL);
+
+      GtkColumnViewColumn *col = gtk_column_view_column_new (titles[i], factory);
+
+      gtk_column_view_append_column (view, col);
+    }
+}
+
+static void
+set_running (GtkWidget *spinner, GtkWidget *cancel_btn, gboolean running)
+{
+  gtk_spinner_set_spinning (GTK_SPINNER (spinner), running);
+  gtk_widget_set_visible (spinner, running);
+  gtk_widget_set_visible (cancel_btn, running);
+}
+
+static GCancellable *
+restart_cancellable (GCancellable **cancellable)
+{
+  if (*cancellable)
+    {
+      g_cancellable_cancel (*cancellable);
+      g_object_unref (*cancellable);
+    }
+
+  *cancellable = g_cancellable_new ();
+
+  return *cancellable;
+}
+
+static gboolean
+is_cancelled (GError *error)
+{
+  if (!error || !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return FALSE;
+
+  g_error_free (error);
+  return TRUE;
+}
+
+static gboolean
+report_error (const char *what, GError *error)
+{
+  if (!error)
+    return FALSE;
+
+  g_printerr ("%s failed: %s\n", what, g_strchomp (error->message));
+
+  g_error_free (error);
+  return TRUE;
+}
+
+/* Marks results served from the cache with their age, next to a button
+ * that fetches them again. cached_at 0 hides both. */
+static void
+show_cache_marker (GtkWidget *label, GtkWidget *reload_btn, gint64 cached_at)
+{
+  if (cached_at)
+    {
+      char *text = g_strdup_printf ("cached, %" G_GINT64_FORMAT " s old",
+                                    (g_get_monotonic_time () - cached_at) / G_USEC_PER_SEC);
+
+      gtk_label_set_text (GTK_LABEL (label), text);
+      g_free (text);
+    }
+
+  gtk_widget_set_visible (label, cached_at != 0);
+  gtk_widget_set_visible (reload_btn, cached_at != 0);
+}
+
+static void
+close_browse_model (AppWidgets *app)
+{
+  data_grid_set_model (DATA_GRID (app->data_view), NULL);
+  gtk_label_set_text (GTK_LABEL (app->fetch_rows_label), "");
+  show_cache_marker (app->fetch_cache_label, app->fetch_reload_btn, 0);
+
+  if (!app->browse_model)
+    return;
+
+  paged_model_close (app->browse_model);
+  g_clear_object (&app->browse_model);
+}
+
+/* Replaces the schema rows in one splice, so the view updates once */
+static void
+show_schema (AppWidgets *app)
+{
+  const CatalogTable *table = NULL;
+  guint old = g_list_model_get_n_items (G_LIST_MODEL (app->schema_store));
+
+  if (app->catalog && app->current_table)
+    table = catalog_lookup (app->catalog, app->current_table);
+
+  guint n = table ? table->n_columns : 0;
+  gpointer *rows = g_new (gpointer, MAX (n, 1));
+
+  for (guint i = 0; i < n; i++)
+    {
+      const CatalogColumn *column = &table->columns[i];
+
+      rows[i] = schema_row_new (column->name, column->type, column->not_null ? "NO" : "YES");
+    }
+
+  g_list_store_splice (app->schema_store, 0, old, rows, n);
+
+  for (guint i = 0; i < n; i++)
+    g_object_unref (rows[i]);
+
+  g_free (rows);
+}
+
+static void
+close_detail (AppWidgets *app)
+{
+  if (app->detail_cancellable)
+    g_cancellable_cancel (app->detail_cancellable);
+
+  g_clear_object (&app->detail_cancellable);
+
+  /* Drops a possibly huge value instead of keeping it hidden */
+  gtk_text_buffer_set_text (gtk_text_view_get_buffer (GTK_TEXT_VIEW (app->detail_view)), "", 0);
+  gtk_widget_set_visible (app->detail_box, FALSE);
+}
+
+static void
+show_detail (AppWidgets *app, const char *value, const char *note)
+{
+  char *text = g_strdup_printf ("%s: %s", app->detail_column, note);
+
+  gtk_label_set_text (GTK_LABEL (app->detail_label), text);
+  gtk_text_buffer_set_text (gtk_text_view_get_buffer (GTK_TEXT_VIEW (app->detail_view)),
+                            value ? value : "", -1);
+  g_free (text);
+}
+
+static void
+on_value_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+
+  char *value = db_fetch_value_finish (result, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  g_clear_object (&app->detail_cancellable);
+
+  if (report_error ("Loading value", error))
+    {
+      show_detail (app, NULL, "could not be loaded");
+      return;
+    }
+
+  if (!value)
+    {
+      show_detail (app, NULL, "the row no longer exists");
+      return;
+    }
+
+  char *size = g_format_size (strlen (value));
+
+  show_detail (app, value, size);
+  g_free (size);
+  g_free (value);
+}
+
+/* The grid only holds the start of wide values, so an opened cell is
+ * read again in full by the row's id */
+static void
+on_data_cell_activated (DataGrid *grid, guint position, int column, gpointer user_data)
+{
+  (void) grid;
+
+  AppWidgets *app = user_data;
+
+  if (!app->browse_model)
+    return;
+
+  const char *const *names = paged_model_get_column_names (app->browse_model);
+  char *row_id = paged_model_dup_row_id (app->browse_model, position);
+
+  g_free (app->detail_column);
+  app->detail_column = g_strdup (names[column]);
+  gtk_widget_set_visible (app->detail_box, TRUE);
+
+  if (!row_id)
+    {
+      GenericRow *row = g_list_model_get_item (G_LIST_MODEL (app->browse_model), position);
+
+      show_detail (app, generic_row_get_value (row, column),
+                   "as shown, rows of views can't be read again");
+      g_object_unref (row);
+      return;
+    }
+
+  const CatalogTable *table = catalog_lookup (app->catalog, app->current_table);
+
+  if (!table)
+    {
+      show_detail (app, NULL, "the table no longer exists");
+      g_free (row_id);
+      return;
+    }
+
+  show_detail (app, NULL, "loading");
+
+  db_fetch_value_async (table, app->detail_column, row_id,
+                        restart_cancellable (&app->detail_cancellable), on_value_ready, app);
+  g_free (row_id);
+}
+
+static void
+on_detail_close_clicked (GtkWidget *button, gpointer user_data)
+{
+  (void) button;
+
+  close_detail (user_data);
+}
+
+static void
+select_table (AppWidgets *app, const char *table_name)
+{
+  if (app->current_table && strcmp (table_name, app->current_table) == 0)
+    return;
+
+  close_browse_model (app);
+  close_detail (app);
+  data_grid_set_columns (DATA_GRID (app->data_view), NULL, NULL);
+
+  g_free (app->current_table);
+  app->current_table = g_strdup (table_name);
+  g_clear_pointer (&app->browse_order, g_free);
+
+  show_schema (app);
+}
+
+static void
+on_table_activated (GtkColumnView *view, guint position, gpointer user_data)
+{
+  (void) view;
+
+  AppWidgets *app = user_data;
+  const char *name = table_list_get_name (app->table_list, position);
+
+  if (name)
+    select_table (app, name);
+}
+
+static void
+on_table_search_changed (GtkSearchEntry *entry, gpointer user_data)
+{
+  AppWidgets *app = user_data;
+
+  table_list_set_filter (app->table_list, gtk_editable_get_text (GTK_EDITABLE (entry)));
+}
+
+/* Enter opens the best match */
+static void
+on_table_search_activate (GtkSearchEntry *entry, gpointer user_data)
+{
+  (void) entry;
+
+  AppWidgets *app = user_data;
+  const char *name = table_list_get_name (app->table_list, 0);
+
+  if (name)
+    select_table (app, name);
+}
+
+static void
+number_setup (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  label_setup (factory, item, user_data);
+
+  gtk_label_set_xalign (GTK_LABEL (gtk_list_item_get_child (item)), 1.0f);
+}
+
+static void
+table_name_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  GtkWidget *label = gtk_list_item_get_child (item);
+  TableRow *row = gtk_list_item_get_item (item);
+
+  gtk_label_set_text (GTK_LABEL (label), table_row_get_name (row));
+}
+
+/* Planner estimates are rough, so they are shown rounded */
+static void
+table_rows_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  GtkWidget *label = gtk_list_item_get_child (item);
+  const TableStats *stats = table_row_get_stats (gtk_list_item_get_item (item));
+  char text[32] = "";
+
+  if (!stats)
+    ;
+  else if (stats->estimated_rows < 0)
+    g_strlcpy (text, "?", sizeof (text));
+  else if (stats->estimated_rows < 10000)
+    g_snprintf (text, sizeof (text), "%" G_GINT64_FORMAT, stats->estimated_rows);
+  else if (stats->estimated_rows < 10000000)
+    g_snprintf (text, sizeof (text), "%" G_GINT64_FORMAT "k", stats->estimated_rows / 1000);
+  else if (stats->estimated_rows < G_GINT64_CONSTANT (10000000000))
+    g_snprintf (text, sizeof (text), "%" G_GINT64_FORMAT "M", stats->estimated_rows / 1000000);
+  else
+    g_snprintf (text, sizeof (text), "%" G_GINT64_FORMAT "B", stats->estimated_rows / 1000000000);
+
+  gtk_label_set_text (GTK_LABEL (label), text);
+}
+
+static void
+table_size_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  GtkWidget *label = gtk_list_item_get_child (item);
+  const TableStats *stats = table_row_get_stats (gtk_list_item_get_item (item));
+  char *size = stats ? g_format_size (stats->total_bytes) : NULL;
+
+  gtk_label_set_text (GTK_LABEL (label), size ? size : "");
+
+  g_free (size);
+}
+
+static void
+set_time_label (GtkWidget *label, const TableStats *stats, gint64 unix_time)
+{
+  if (!stats)
+    {
+      gtk_label_set_text (GTK_LABEL (label), "");
+      return;
+    }
+
+  if (unix_time == 0)
+    {
+      gtk_label_set_text (GTK_LABEL (label), "never");
+      return;
+    }
+
+  GDateTime *time = g_date_time_new_from_unix_local (unix_time);
+  char *text = g_date_time_format (time, "%Y-%m-%d %H:%M");
+
+  gtk_label_set_text (GTK_LABEL (label), text);
+
+  g_free (text);
+  g_date_time_unref (time);
+}
+
+static void
+table_vacuumed_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  const TableStats *stats = table_row_get_stats (gtk_list_item_get_item (item));
+
+  set_time_label (gtk_list_item_get_child (item), stats, stats ? stats->last_vacuum : 0);
+}
+
+static void
+table_analyzed_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  const TableStats *stats = table_row_get_stats (gtk_list_item_get_item (item));
+
+  set_time_label (gtk_list_item_get_child (item), stats, stats ? stats->last_analyze : 0);
+}
+
+/* The list sorts itself, so the column sorters only track which header
+ * was clicked and which way */
+static void
+on_table_sort_changed (GtkSorter *sorter, GtkSorterChange change, gpointer user_data)
+{
+  (void) change;
+
+  AppWidgets *app = user_data;
+  GtkColumnViewSorter *view_sorter = GTK_COLUMN_VIEW_SORTER (sorter);
+  GtkColumnViewColumn *column = gtk_column_view_sorter_get_primary_sort_column (view_sorter);
+  TableListSort sort = TABLE_LIST_SORT_NONE;
+
+  if (column)
+    sort = GPOINTER_TO_INT (g_object_get_data (G_OBJECT (column), "table-list-sort"));
+
+  table_list_set_sort (app->table_list, sort,
+                       gtk_column_view_sorter_get_primary_sort_order (view_sorter)
+                           == GTK_SORT_DESCENDING);
+}
+
+static void
+on_stats_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+
+  GHashTable *stats = db_fetch_table_stats_finish (result, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  g_clear_object (&app->stats_cancellable);
+
+  if (report_error ("Table statistics query", error))
+    return;
+
+  table_list_set_stats (app->table_list, stats);
+  g_hash_table_unref (stats);
+}
+
+static void
+set_catalog (AppWidgets *app, Catalog *catalog)
+{
+  g_clear_pointer (&app->catalog, catalog_free);
+  app->catalog = catalog;
+
+  table_list_set_catalog (app->table_list, catalog);
+  show_schema (app);
+}
+
+static void
+on_catalog_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+
+  Catalog *catalog = db_fetch_catalog_finish (result, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  g_clear_object (&app->catalog_cancellable);
+
+  if (report_error ("Catalog query", error))
+    return;
+
+  /* The fingerprint was taken first, so a change in between only makes
+   * the next start refetch */
+  catalog_set_fingerprint (catalog, app->catalog_fingerprint);
+
+  char *path = db_catalog_cache_path ();
+
+  if (!catalog_save (catalog, path, &error))
+    report_error ("Saving catalog cache", error);
+
+  g_free (path);
+
+  set_catalog (app, catalog);
+}
+
+static void
+on_fingerprint_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+
+  char *fingerprint = db_fetch_catalog_fingerprint_finish (result, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  if (report_error ("Catalog fingerprint query", error))
+    {
+      g_clear_object (&app->catalog_cancellable);
+      return;
+    }
+
+  g_free (app->catalog_fingerprint);
+  app->catalog_fingerprint = fingerprint;
+
+  if (!app->catalog_force && app->catalog
+      && g_strcmp0 (catalog_get_fingerprint (app->catalog), fingerprint) == 0)
+    {
+      g_clear_object (&app->catalog_cancellable);
+      return;
+    }
+
+  db_fetch_catalog_async (app->catalog_cancellable, on_catalog_ready, app);
+}
+
+/* Reloads the catalog if it changed on the server, or always when forced,
+ * and the table statistics */
+static void
+refresh_catalog (AppWidgets *app, gboolean force)
+{
+  app->catalog_force = force;
+
+  db_fetch_catalog_fingerprint_async (restart_cancellable (&app->catalog_cancellable),
+                                      on_fingerprint_ready, app);
+
+  /* Sizes and estimates change with every write, so they are always
+   * fetched again and never cached */
+  db_fetch_table_stats_async (restart_cancellable (&app->stats_cancellable), on_stats_ready, app);
+}
+
+/* Shows the catalog cached by the last session right away, then checks
+ * it against the server in the background */
+static void
+load_catalog (AppWidgets *app)
+{
+  char *path = db_catalog_cache_path ();
+  Catalog *cached = catalog_load (path);
+
+  g_free (path);
+
+  if (cached)
+    set_catalog (app, cached);
+
+  refresh_catalog (app, FALSE);
+}
+
+static void
+on_refresh_clicked (GtkWidget *button, gpointer user_data)
+{
+  (void) button;
+
+  refresh_catalog (user_data, TRUE);
+}
+
+/* Editor statements that may add, drop or rename tables and columns */
+static gboolean
+changes_catalog (const char *sql)
+{
+  return g_regex_match_simple ("\\b(CREATE|ALTER|DROP|COMMENT)\\b", sql, G_REGEX_CASELESS, 0);
+}
+
+static void
+on_fetch_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  AppWidgets *app = user_data;
+  PagedModel *model = PAGED_MODEL (source);
+  GError *error = NULL;
+
+  paged_model_open_finish (model, result, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  g_clear_object (&app->fetch_cancellable);
+  set_running (app->fetch_spinner, app->fetch_cancel_btn, FALSE);
+
+  if (report_error ("Query", error))
+    {
+      close_browse_model (app);
+      return;
+    }
+
+  data_grid_set_columns (DATA_GRID (app->data_view), paged_model_get_column_names (model),
+                         paged_model_get_column_types (model));
+
+  gint64 estimate = paged_model_get_estimated_rows (model);
+  char *rows = estimate >= 0 ? g_strdup_printf ("About %" G_GINT64_FORMAT " rows%s", estimate,
+                                                app->browse_sampled ? " in the sample" : "")
+                             : NULL;
+
+  gtk_label_set_text (GTK_LABEL (app->fetch_rows_label), rows ? rows : "");
+  g_free (rows);
+
+  show_cache_marker (app->fetch_cache_label, app->fetch_reload_btn,
+                     paged_model_get_cached_at (model));
+
+  data_grid_set_model (DATA_GRID (app->data_view), G_LIST_MODEL (model));
+}
+
+static void
+on_browse_refreshed (PagedModel *model, gpointer user_data)
+{
+  AppWidgets *app = user_data;
+
+  if (model == app->browse_model)
+    show_cache_marker (app->fetch_cache_label, app->fetch_reload_btn, 0);
+}
+
+static void
+open_browse_model (AppWidgets *app, gboolean bypass_cache)
+{
+  const CatalogTable *table =
+      app->catalog && app->current_table ? catalog_lookup (app->catalog, app->current_table) : NULL;
+
+  if (!table)
+    return;
+
+  /* Columns stay until the new ones are known, so a refetch of the same
+   * table keeps them as they are */
+  close_browse_model (app);
+
+  app->browse_model = paged_model_new ();
+  g_signal_connect (app->browse_model, "refreshed", G_CALLBACK (on_browse_refreshed), app);
+
+  DbSample sample = {
+    .bernoulli = gtk_drop_down_get_selected (GTK_DROP_DOWN (app->sample_method)) == 1,
+    .percent = gtk_spin_button_get_value (GTK_SPIN_BUTTON (app->sample_percent)),
+    .seed = gtk_spin_button_get_value_as_int (GTK_SPIN_BUTTON (app->sample_seed)),
+  };
+
+  app->browse_sampled = gtk_check_button_get_active (GTK_CHECK_BUTTON (app->sample_check))
+                        && db_browse_can_sample (table);
+
+  set_running (app->fetch_spinner, app->fetch_cancel_btn, TRUE);
+
+  paged_model_open_async (app->browse_model, table, app->browse_sampled ? &sample : NULL,
+                          app->browse_order, app->browse_descending, bypass_cache,
+                          restart_cancellable (&app->fetch_cancellable), on_fetch_ready, app);
+}
+
+static void
+on_fetch_clicked (GtkWidget *button, gpointer user_data)
+{
+  (void) button;
+
+  open_browse_model (user_data, FALSE);
+}
+
+/* Quiet time after the last change to the sample before it is applied */
+#define SAMPLE_SETTLE_MS 300
+
+/* A table being browsed is reopened with the new sample, or whole once
+ * sampling is turned off */
+static gboolean
+on_sample_timeout (gpointer user_data)
+{
+  AppWidgets *app = user_data;
+
+  app->sample_timeout_id = 0;
+
+  if (!app->browse_model)
+    return G_SOURCE_REMOVE;
+
+  if (app->browse_sampled
+      || gtk_check_button_get_active (GTK_CHECK_BUTTON (app->sample_check)))
+    open_browse_model (app, FALSE);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Each reopen is a round trip, so a run of changes, such as holding a
+ * spin button's arrow, only applies once it settles */
+static void
+on_sample_changed (GObject *object, GParamSpec *pspec, gpointer user_data)
+{
+  (void) object;
+  (void) pspec;
+
+  AppWidgets *app = user_data;
+
+  if (app->sample_timeout_id)
+    g_source_remove (app->sample_timeout_id);
+
+  app->sample_timeout_id = g_timeout_add (SAMPLE_SETTLE_MS, on_sample_timeout, app);
+}
+
+static void
+on_fetch_reload_clicked (GtkWidget *button, gpointer user_data)
+{
+  (void) button;
+
+  open_browse_model (user_data, TRUE);
+}
+
+/* Only part of the table is ever fetched, so the cursor is reopened
+ * sorted by the server */
+static void
+on_data_sort_changed (DataGrid *grid, gpointer user_data)
+{
+  AppWidgets *app = user_data;
+  int column;
+
+  data_grid_get_sort (grid, &column, &app->browse_descending);
+
+  const char *const *names =
+      app->browse_model ? paged_model_get_column_names (app->browse_model) : NULL;
+
+  g_clear_pointer (&app->browse_order, g_free);
+
+  if (column >= 0 && names)
+    app->browse_order = g_strdup (names[column]);
+  else if (column >= 0)
+    data_grid_set_sort (grid, -1, FALSE);
+
+  open_browse_model (app, FALSE);
+}
+
+static void
+on_data_scrolled (GtkAdjustment *adjustment, gpointer user_data)
+{
+  AppWidgets *app = user_data;
+
+  if (!app->browse_model)
+    return;
+
+  double value = gtk_adjustment_get_value (adjustment);
+  double page = gtk_adjustment_get_page_size (adjustment);
+  double upper = gtk_adjustment_get_upper (adjustment);
+  guint first, last;
+
+  if (upper <= 0 || g_list_model_get_n_items (G_LIST_MODEL (app->browse_model)) == 0)
+    return;
+
+  data_grid_get_visible_rows (DATA_GRID (app->data_view), &first, &last);
+
+  paged_model_set_visible_range (app->browse_model, first, last);
+
+  if (value + 2 * page >= upper)
+    paged_model_load_more (app->browse_model);
+}
+
+static void
+on_fetch_cancel_clicked (GtkWidget *button, gpointer user_data)
+{
+  (void) button;
+
+  AppWidgets *app = user_data;
+
+  if (app->fetch_cancellable)
+    g_cancellable_cancel (app->fetch_cancellable);
+
+  g_clear_object (&app->fetch_cancellable);
+  set_running (app->fetch_spinner, app->fetch_cancel_btn, FALSE);
+
+  close_browse_model (app);
+}
+
+/* The browse cursor is closed while another tab is shown, and opened
+ * again by the next page fetch */
+static void
+on_notebook_switch_page (GtkNotebook *notebook, GtkWidget *page, guint page_num, gpointer user_data)
+{
+  (void) notebook;
+  (void) page;
+  (void) user_data;
+
+  if (page_num != 0)
+    db_browse_close ();
+}
+
+static void
+close_query_model (AppWidgets *app)
+{
+  data_grid_set_model (DATA_GRID (app->query_view), NULL);
+  show_cache_marker (app->query_cache_label, app->query_reload_btn, 0);
+
+  if (app->sort_cancellable)
+    g_cancellable_cancel (app->sort_cancellable);
+
+  if (app->filter_cancellable)
+    g_cancellable_cancel (app->filter_cancellable);
+
+  g_clear_object (&app->sort_cancellable);
+  g_clear_object (&app->filter_cancellable);
+  g_clear_pointer (&app->query_filter, g_free);
+  gtk_label_set_text (GTK_LABEL (app->query_filter_label), "");
+
+  if (!app->query_model)
+    return;
+
+  g_signal_handlers_disconnect_by_data (app->query_model, app);
+  g_clear_object (&app->query_model);
+}
+
+static void
+on_query_columns_changed (ResultModel *model, gpointer user_data)
+{
+  AppWidgets *app = user_data;
+
+  ResultSet *set = result_model_get_result_set (model);
+  char **names = result_set_dup_column_names (set);
+  Oid *types = result_set_dup_column_types (set);
+
+  data_grid_set_columns (DATA_GRID (app->query_view), (const char *const *) names, types);
+  g_strfreev (names);
+  g_free (types);
+}
+
+static void
+on_sort_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+  guint n_rows = 0;
+
+  guint *order = result_sort_finish (result, &n_rows, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  g_clear_object (&app->sort_cancellable);
+
+  if (report_error ("Sort", error))
+    return;
+
+  result_model_set_order (app->query_model, order, n_rows);
+}
+
+/* The whole result is on hand, so it is sorted here on the worker pool
+ * while the grid keeps showing the old order */
+static void
+sort_query_model (AppWidgets *app)
+{
+  int column;
+  gboolean descending;
+
+  /* Rows are still arriving, the sort is applied once they are all in */
+  if (!app->query_model || app->query_cancellable)
+    return;
+
+  data_grid_get_sort (DATA_GRID (app->query_view), &column, &descending);
+
+  GCancellable *cancellable = restart_cancellable (&app->sort_cancellable);
+
+  if (column < 0)
+    {
+      g_clear_object (&app->sort_cancellable);
+      result_model_set_order (app->query_model, NULL, 0);
+      return;
+    }
+
+  result_sort_async (result_model_get_result_set (app->query_model), column, descending,
+                     cancellable, on_sort_ready, app);
+}
+
+static void
+on_query_sort_changed (DataGrid *grid, gpointer user_data)
+{
+  (void) grid;
+
+  sort_query_model (user_data);
+}
+
+static void
+update_filter_label (AppWidgets *app)
+{
+  guint n_matches = 0;
+
+  if (!app->query_model || !result_model_get_filter (app->query_model, &n_matches))
+    {
+      gtk_label_set_text (GTK_LABEL (app->query_filter_label), "");
+      return;
+    }
+
+  guint n_rows = result_set_get_n_rows (result_model_get_result_set (app->query_model));
+  char *text = g_strdup_printf ("%u of %u rows", n_matches, n_rows);
+
+  gtk_label_set_text (GTK_LABEL (app->query_filter_label), text);
+  g_free (text);
+}
+
+static void
+on_filter_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+  guint n_matches = 0;
+
+  guint *rows = result_filter_finish (result, &n_matches, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  g_clear_object (&app->filter_cancellable);
+
+  if (report_error ("Filter", error))
+    return;
+
+  g_free (app->query_filter);
+  app->query_filter = g_steal_pointer (&app->query_filter_pending);
+
+  result_model_set_filter (app->query_model, rows, n_matches);
+  update_filter_label (app);
+}
+
+/* Every match of a longer needle also matches the needle it extends */
+static gboolean
+refines_filter (const char *text, const char *previous)
+{
+  char *lower = g_ascii_strdown (text, -1);
+  char *old = g_ascii_strdown (previous, -1);
+  gboolean refines = strstr (lower, old) != NULL;
+
+  g_free (lower);
+  g_free (old);
+
+  return refines;
+}
+
+/* Scans the loaded rows on the worker pool. Typing on from the last
+ * applied filter only rescans the rows it matched. */
+static void
+filter_query_model (AppWidgets *app)
+{
+  /* Rows are still arriving, the filter is applied once they are all in */
+  if (!app->query_model || app->query_cancellable)
+    return;
+
+  const char *text = gtk_editable_get_text (GTK_EDITABLE (app->query_filter_entry));
+  GCancellable *cancellable = restart_cancellable (&app->filter_cancellable);
+
+  if (text[0] == '\0')
+    {
+      g_clear_object (&app->filter_cancellable);
+      g_clear_pointer (&app->query_filter, g_free);
+      result_model_set_filter (app->query_model, NULL, 0);
+      update_filter_label (app);
+      return;
+    }
+
+  const guint *candidates = NULL;
+  guint n_candidates = 0;
+
+  if (app->query_filter && refines_filter (text, app->query_filter))
+    candidates = result_model_get_filter (app->query_model, &n_candidates);
+
+  g_free (app->query_filter_pending);
+  app->query_filter_pending = g_strdup (text);
+
+  result_filter_async (result_model_get_result_set (app->query_model), text, candidates,
+                       n_candidates, cancellable, on_filter_ready, app);
+}
+
+static void
+on_query_filter_changed (GtkSearchEntry *entry, gpointer user_data)
+{
+  (void) entry;
+
+  filter_query_model (user_data);
+}
+
+static void
+report_query_stats (AppWidgets *app)
+{
+  char *text = query_stats_format (&app->query_stats);
+
+  gtk_label_set_text (GTK_LABEL (app->status_label), text);
+  g_free (text);
+
+  query_stats_append_trace (&app->query_stats, app->query_text, app->query_error,
+                            db_get_trace_file ());
+}
+
+static void
+stop_waiting_for_paint (AppWidgets *app)
+{
+  if (!app->paint_clock)
+    return;
+
+  g_signal_handlers_disconnect_by_data (app->paint_clock, app);
+  app->paint_clock = NULL;
+}
+
+static void
+on_query_painted (GdkFrameClock *clock, gpointer user_data)
+{
+  (void) clock;
+
+  AppWidgets *app = user_data;
+
+  stop_waiting_for_paint (app);
+
+  app->query_stats.painted = g_get_monotonic_time ();
+  report_query_stats (app);
+}
+
+/* The breakdown ends when the frame showing the result is painted */
+static void
+wait_for_paint (AppWidgets *app)
+{
+  GdkFrameClock *clock = gtk_widget_get_frame_clock (app->query_view);
+
+  if (!clock)
+    {
+      report_query_stats (app);
+      return;
+    }
+
+  app->paint_clock = clock;
+  g_signal_connect (clock, "after-paint", G_CALLBACK (on_query_painted), app);
+
+  gtk_widget_queue_draw (app->query_view);
+}
+
+static void
+on_query_ready (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  (void) source;
+
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+  QueryStats stats;
+
+  db_run_query_finish (result, &stats, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  g_clear_object (&app->query_cancellable);
+  set_running (app->query_spinner, app->query_cancel_btn, app->explain_cancellable != NULL);
+
+  app->query_stats = stats;
+  show_cache_marker (app->query_cache_label, app->query_reload_btn, stats.cached_at);
+
+  /* Commands without a result set never announce columns */
+  if (app->query_model && result_model_get_n_columns (app->query_model) == 0)
+    data_grid_set_columns (DATA_GRID (app->query_view), NULL, NULL);
+
+  g_free (app->query_error);
+  app->query_error = error ? g_strdup (g_strchomp (error->message)) : NULL;
+
+  wait_for_paint (app);
+
+  /* Earlier statements may have run even if a later one failed */
+  if (app->query_changes_catalog)
+    refresh_catalog (app, FALSE);
+
+  if (report_error ("Query", error))
+    {
+      close_query_model (app);
+      return;
+    }
+
+  /* A re-run with the same columns keeps its sort, and any re-run the
+   * filter text */
+  sort_query_model (app);
+  filter_query_model (app);
+}
+
+/* The editor text, or NULL when empty */
+static char *
+get_editor_text (AppWidgets *app)
+{
+  if (!app->sql_view)
+    return NULL;
+
+  GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (app->sql_view));
+
+  if (!buffer)
+    return NULL;
+
+  GtkTextIter start, end;
+  gtk_text_buffer_get_start_iter (buffer, &start);
+  gtk_text_buffer_get_end_iter (buffer, &end);
+
+  char *text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+
+  if (text && text[0] == '\0')
+    g_clear_pointer (&text, g_free);
+
+  return text;
+}
+
+static void
+run_query (AppWidgets *app, gboolean bypass_cache)
+{
+  char *text = get_editor_text (app);
+
+  if (!text)
+    return;
+
+  set_running (app->query_spinner, app->query_cancel_btn, TRUE);
+  gtk_stack_set_visible_child_name (GTK_STACK (app->query_stack), "results");
+
+  app->query_changes_catalog = changes_catalog (text);
+
+  stop_waiting_for_paint (app);
+  g_free (app->query_text);
+  app->query_text = g_strdup (text);
+
+  /* The old columns stay until the new result describes its own, so a
+   * re-run of the same query keeps them as they are */
+  close_query_model (app);
+
+  app->query_model = result_model_new ();
+
+  g_signal_connect (app->query_model, "columns-changed", G_CALLBACK (on_query_columns_changed),
+                    app);
+
+  data_grid_set_model (DATA_GRID (app->query_view), G_LIST_MODEL (app->query_model));
+
+  db_run_query_async (text, app->query_model, bypass_cache,
+                      restart_cancellable (&app->query_cancellable), on_query_ready, app);
+
+  g_free (text);
+}
+
+static void
+on_run_query_clicked (GtkWidget *button, gpointer user_data)
+{
+  (void) button;
+
+  run_query (user_data, FALSE);
+}
+
+static void
+on_query_reload_clicked (GtkWidget *button, gpointer user_data)
+{
+  (void) button;
+
+  run_query (user_data, TRUE);
+}
+
+typedef enum
+{
+  PLAN_COLUMN_NODE,
+  PLAN_COLUMN_SELF,
+  PLAN_COLUMN_TOTAL,
+  PLAN_COLUMN_ROWS,
+  PLAN_COLUMN_ESTIMATE,
+  PLAN_COLUMN_HIT,
+  PLAN_COLUMN_READ,
+  PLAN_COLUMN_CHANGE,
+  N_PLAN_COLUMNS
+} PlanColumn;
+
+/* Estimates this far off in either direction are flagged */
+#define PLAN_ESTIMATE_WARN 10.0
+
+static GListModel *
+plan_tree_children (gpointer item, gpointer user_data)
+{
+  (void) user_data;
+
+  return plan_row_get_children (item);
+}
+
+static void
+plan_node_setup (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+  (void) user_data;
+
+  GtkWidget *expander = gtk_tree_expander_new ();
+  GtkWidget *label = gtk_label_new (NULL);
+
+  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+  gtk_tree_expander_set_child (GTK_TREE_EXPANDER (expander), label);
+
+  gtk_list_item_set_child (item, expander);
+}
+
+static void
+set_label_class (GtkWidget *label, const char *css_class, gboolean set)
+{
+  if (set)
+    gtk_widget_add_css_class (label, css_class);
+  else
+    gtk_widget_remove_css_class (label, css_class);
+}
+
+static char *
+format_plan_cell (const PlanNode *node, PlanColumn column)
+{
+  if (node->never_executed && column != PLAN_COLUMN_ROWS)
+    return g_strdup (column == PLAN_COLUMN_SELF ? "never executed" : "");
+
+  switch (column)
+    {
+    case PLAN_COLUMN_SELF:
+      return g_strdup_printf ("%.2f ms", node->self_ms);
+    case PLAN_COLUMN_TOTAL:
+      return g_strdup_printf ("%.2f ms", node->total_ms);
+    case PLAN_COLUMN_ROWS:
+      return g_strdup_printf ("%.0f / %.0f", node->actual_rows, node->estimated_rows);
+    case PLAN_COLUMN_ESTIMATE:
+      {
+        double error = plan_node_estimate_error (node);
+
+        if (error >= 1)
+          return g_strdup_printf ("%.1f× under", error);
+
+        return g_strdup_printf ("%.1f× over", 1 / error);
+      }
+    case PLAN_COLUMN_HIT:
+      return g_strdup_printf ("%" G_GINT64_FORMAT, node->hit_blocks);
+    case PLAN_COLUMN_READ:
+      return g_strdup_printf ("%" G_GINT64_FORMAT, node->read_blocks);
+    case PLAN_COLUMN_CHANGE:
+      if (!node->baseline || node->baseline->never_executed)
+        return g_strdup ("");
+
+      return g_strdup_printf ("%+.2f ms", node->self_ms - node->baseline->self_ms);
+    default:
+      return g_strdup ("");
+    }
+}
+
+/* A self time change counts once it is a tenth of the old one and more
+ * than timing noise */
+static int
+plan_node_change (const PlanNode *node)
+{
+  if (!node->baseline || node->never_executed || node->baseline->never_executed)
+    return 0;
+
+  double change = node->self_ms - node->baseline->self_ms;
+
+  if (ABS (change) < 0.1 || ABS (change) < 0.1 * node->baseline->self_ms)
+    return 0;
+
+  return change > 0 ? 1 : -1;
+}
+
+static void
+plan_cell_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+{
+  (void) factory;
+
+  PlanColumn column = GPOINTER_TO_INT (user_data);
+  GtkTreeListRow *tree_row = gtk_list_item_get_item (item);
+  PlanRow *row = gtk_tree_list_row_get_item (tree_row);
+  const PlanNode *node = plan_row_get_node (row);
+  GtkWidget *label = gtk_list_item_get_child (item);
+
+  if (column == PLAN_COLUMN_NODE)
+    {
+      gtk_tree_expander_set_list_row (GTK_TREE_EXPANDER (label), tree_row);
+      label = gtk_tree_expander_get_child (GTK_TREE_EXPANDER (label));
+
+      gtk_label_set_text (GTK_LABEL (label), node->label);
+      gtk_widget_set_tooltip_text (label, node->detail);
+    }
+  else
+    {
+      char *text = format_plan_cell (node, column);
+
+      gtk_label_set_text (GTK_LABEL (label), text);
+      g_free (text);
+    }
+
+  gboolean hot = node->hot && (column == PLAN_COLUMN_NODE || column == PLAN_COLUMN_SELF);
+  gboolean misestimated = column == PLAN_COLUMN_ESTIMATE && !node->never_executed
+                          && (plan_node_estimate_error (node) >= PLAN_ESTIMATE_WARN
+                              || plan_node_estimate_error (node) <= 1 / PLAN_ESTIMATE_WARN);
+  int change = column == PLAN_COLUMN_CHANGE ? plan_node_change (node) : 0;
+
+  /* Rows are recycled, so every class is set either way */
+  set_label_class (label, "error", hot || change > 0);
+  set_label_class (label, "warning", misestimated);
+  set_label_class (label, "success", change < 0);
+
+  g_object_unref (row);
+}
+
+static void
+show_plan_summary (AppWidgets *app)
+{
+  ExplainPlan *baseline = explain_plan_get_baseline (app->plan);
+  GString *text = g_string_new (NULL);
+
+  g_string_append_printf (text, "Planning %.2f ms, execution %.2f ms",
+                          explain_plan_get_planning_ms (app->plan),
+                          explain_plan_get_execution_ms (app->plan));
+
+  if (baseline)
+    g_string_append_printf (text, " (was %.2f ms)", explain_plan_get_execution_ms (baseline));
+
+  gtk_label_set_text (GTK_LABEL (app->plan_summary), text->str);
+  g_string_free (text, TRUE);
+}
+
+static void
+show_plan (AppWidgets *app)
+{
+  GListStore *root = g_list_store_new (TYPE_PLAN_ROW);
+  PlanRow *row = plan_row_new (app->plan, explain_plan_get_root (app->plan));
+
+  g_list_store_append (root, row);
+  g_object_unref (row);
+
+  GtkTreeListModel *tree =
+      gtk_tree_list_model_new (G_LIST_MODEL (root), FALSE, TRUE, plan_tree_children, NULL, NULL);
+  GtkSingleSelection *selection = gtk_single_selection_new (G_LIST_MODEL (tree));
+
+  gtk_column_view_set_model (GTK_COLUMN_VIEW (app->plan_view), GTK_SELECTION_MODEL (selection));
+  g_object_unref (selection);
+
+  show_plan_summary (app);
+}
+
+static void
+on_explain_ready (GObject *source, GAsyncResult *result, gpointer user_data)
 {
-  GListModel *columns = gtk_column_view_get_columns (view);
+  (void) source;
+
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+
+  ExplainPlan *plan = db_explain_finish (result, &error);
+
+  if (is_cancelled (error))
+    return;
+
+  g_clear_object (&app->explain_cancellable);
+  set_running (app->query_spinner, app->query_cancel_btn, app->query_cancellable != NULL);
+
+  if (report_error ("Explain", error))
+    return;
+
+  /* Runs of the same statement are compared with the one before */
+  if (app->plan && g_strcmp0 (app->plan_query, app->explain_query) == 0)
+    explain_plan_set_baseline (plan, app->plan);
+
+  g_clear_pointer (&app->plan, explain_plan_unref);
+  app->plan = plan;
 
-  while (g_list_model_get_n_items (columns) > 0)
-    {
-      GtkColumnViewColumn *col = g_list_model_get_item (columns, 0);
+  g_free (app->plan_query);
+  app->plan_query = g_steal_pointer (&app->explain_query);
 
-      gtk_column_view_remove_column (view, col);
-      g_object_unref (col);
-    }
+  show_plan (app);
 }
 
 static void
-label_setup (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+on_explain_clicked (GtkWidget *button, gpointer user_data)
 {
-  (void) factory;
-  (void) user_data;
+  (void) button;
 
-  GtkWidget *label = gtk_label_new (NULL);
+  AppWidgets *app = user_data;
+  char *text = get_editor_text (app);
 
-  gtk_label_set_xalign (GTK_LABEL (label), 0.0f);
+  if (!text)
+    return;
 
-  gtk_widget_set_margin_start (label, 8);
-  gtk_widget_set_margin_end (label, 8);
-  gtk_widget_set_margin_top (label, 2);
-  gtk_widget_set_margin_bottom (label, 2);
+  set_running (app->query_spinner, app->query_cancel_btn, TRUE);
 
-  gtk_list_item_set_child (item, label);
+  g_free (app->explain_query);
+  app->explain_query = text;
+
+  gtk_stack_set_visible_child_name (GTK_STACK (app->query_stack), "plan");
+
+  /* A query still running keeps going, its rows just aren't shown */
+  db_explain_async (text, restart_cancellable (&app->explain_cancellable), on_explain_ready, app);
 }
 
 static void
-schema_name_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+on_query_cancel_clicked (GtkWidget *button, gpointer user_data)
 {
-  (void) factory;
-  (void) user_data;
+  (void) button;
 
-  GtkWidget *label = gtk_list_item_get_child (item);
-  SchemaRow *row = gtk_list_item_get_item (item);
+  AppWidgets *app = user_data;
 
-  gtk_label_set_text (GTK_LABEL (label), schema_row_get_name (row));
+  if (app->query_cancellable)
+    g_cancellable_cancel (app->query_cancellable);
+
+  if (app->explain_cancellable)
+    g_cancellable_cancel (app->explain_cancellable);
+
+  g_clear_object (&app->query_cancellable);
+  g_clear_object (&app->explain_cancellable);
+  set_running (app->query_spinner, app->query_cancel_btn, FALSE);
+
+  close_query_model (app);
 }
 
 static void
-schema_type_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+on_export_progress (guint64 rows, guint64 bytes, gpointer user_data)
 {
-  (void) factory;
-  (void) user_data;
+  AppWidgets *app = user_data;
 
-  GtkWidget *label = gtk_list_item_get_child (item);
-  SchemaRow *row = gtk_list_item_get_item (item);
+  /* Progress posted just before the export ended */
+  if (!app->transfer_cancellable)
+    return;
 
-  gtk_label_set_text (GTK_LABEL (label), schema_row_get_type_str (row));
+  char *size = g_format_size (bytes);
+  char *text = g_strdup_printf ("Exporting: %" G_GUINT64_FORMAT " rows, %s", rows, size);
+
+  gtk_label_set_text (GTK_LABEL (app->transfer_label), text);
+  g_free (text);
+  g_free (size);
 }
 
 static void
-schema_nullable_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+on_export_ready (GObject *source, GAsyncResult *result, gpointer user_data)
 {
-  (void) factory;
-  (void) user_data;
+  (void) source;
 
-  GtkWidget *label = gtk_list_item_get_child (item);
-  SchemaRow *row = gtk_list_item_get_item (item);
+  AppWidgets *app = user_data;
+  GError *error = NULL;
+  guint64 rows = 0;
+  char *text;
 
-  gtk_label_set_text (GTK_LABEL (label), schema_row_get_nullable (row));
+  db_export_finish (result, &rows, &error);
+
+  g_clear_object (&app->transfer_cancellable);
+  set_running (app->transfer_spinner, app->transfer_cancel_btn, FALSE);
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    text = g_strdup ("Export cancelled");
+  else if (error)
+    text = g_strdup_printf ("Export failed: %s", g_strchomp (error->message));
+  else
+    text = g_strdup_printf ("Exported %" G_GUINT64_FORMAT " rows to %s", rows, app->export_path);
+
+  gtk_label_set_text (GTK_LABEL (app->transfer_label), text);
+  g_free (text);
+
+  if (!is_cancelled (error))
+    report_error ("Export", error);
 }
 
 static void
-data_bind (GtkListItemFactory *factory, GtkListItem *item, gpointer user_data)
+on_export_file_chosen (GObject *source, GAsyncResult *result, gpointer user_data)
 {
-  (void) factory;
+  AppWidgets *app = user_data;
+  GError *error = NULL;
 
-  int column_index = GPOINTER_TO_INT (user_data);
+  GFile *file = gtk_file_dialog_save_finish (GTK_FILE_DIALOG (source), result, &error);
 
-  GtkWidget *label = gtk_list_item_get_child (item);
-  GenericRow *row = gtk_list_item_get_item (item);
+  if (!file)
+    {
+      if (!g_error_matches (error, GTK_DIALOG_ERROR, GTK_DIALOG_ERROR_DISMISSED))
+        report_error ("Choosing export file", error);
+      else
+        g_error_free (error);
+
+      return;
+    }
+
+  const CatalogTable *table =
+      app->export_is_table ? catalog_lookup (app->catalog, app->export_source) : NULL;
+
+  /* An import may have started, or the catalog dropped the table, while
+   * the dialog was open */
+  if (app->transfer_cancellable || (app->export_is_table && !table))
+    {
+      g_object_unref (file);
+      return;
+    }
+
+  g_free (app->export_path);
+  app->export_path = g_file_get_path (file);
+  g_object_unref (file);
 
-  gtk_label_set_text (GTK_LABEL (label), generic_row_get_value (row, column_index));
+  GCancellable *cancellable = restart_cancellable (&app->transfer_cancellable);
+
+  gtk_label_set_text (GTK_LABEL (app->transfer_label), "Exporting");
+  set_running (app->transfer_spinner, app->transfer_cancel_btn, TRUE);
+
+  if (app->export_is_table)
+    db_export_table_async (table, app->export_path, on_export_progress, app, cancellable,
+                           on_export_ready, app);
+  else
+    db_export_query_async (app->export_source, app->export_path, on_export_progress, app,
+                           cancellable, on_export_ready, app);
 }
 
 static void
-append_schema_columns (GtkColumnView *view)
+choose_export_file (AppWidgets *app, GtkWidget *button, char *source, gboolean is_table)
 {
-  const char *titles[] = { "Name", "Type", "Nullable" };
+  /* One transfer at a time */
+  if (app->transfer_cancellable)
+    {
+      g_free (source);
+      return;
+    }
 
-  GCallback binds[] = { G_CALLBACK (schema_name_bind), G_CALLBACK (schema_type_bind),
-                        G_CALLBACK (schema_nullable_bind) };
+  g_free (app->export_source);
+  app->export_source = source;
+  app->export_is_table = is_table;
 
-  for (int i = 0; i < 3; i++)
-    {
-      GtkListItemFactory *factory = gtk_signal_list_item_factory_new ();
+  char *name = g_strdup_printf ("%s.csv", is_table ? source : "query");
+  GtkFileDialog *dialog = gtk_file_dialog_new ();
 
-      g_signal_connect (factory, "setup", G_CALLBACK (label_setup), NULL);
+  gtk_file_dialog_set_title (dialog, "Export as CSV or TSV");
+  gtk_file_dialog_set_initial_name (dialog, name);
+  gtk_file_dialog_save (dialog, GTK_WINDOW (gtk_widget_get_root (button)), NULL,
+                        on_export_file_chosen, app);
 
-      g_signal_connect (factory, "bind", binds[i], NULL);
+  g_object_unref (dialog);
+  g_free (name);
+}
 
-      GtkColumnViewColumn *col = gtk_column_view_column_new (titles[i], factory);
+static void
+on_export_table_clicked (GtkWidget *button, gpointer user_data)
+{
+  AppWidgets *app = user_data;
 
-      gtk_column_view_append_column (view, col);
-    }
+  if (!app->current_table)
+    return;
+
+  choose_export_file (app, button, g_strdup (app->current_table), TRUE);
 }
 
 static void
-append_data_columns (GtkColumnView *view, GListStore *data_store, GListStore *schema_store)
+on_export_query_clicked (GtkWidget *button, gpointer user_data)
 {
-  guint rows = g_list_model_get_n_items (G_LIST_MODEL (data_store));
-  if (rows == 0)
+  AppWidgets *app = user_data;
+  char *text = get_editor_text (app);
+
+  if (!text)
     return;
 
-  GenericRow *first = g_list_model_get_item (G_LIST_MODEL (data_store), 0);
+  choose_export_file (app, button, text, FALSE);
+}
+
+/* Column names of the table shown in the schema pane, NULL if unknown */
+static char **
+get_schema_columns (AppWidgets *app)
+{
+  GListModel *model = G_LIST_MODEL (app->schema_store);
+  guint n = g_list_model_get_n_items (model);
+
+  if (n == 0)
+    return NULL;
 
-  int cols = generic_row_get_n_columns (first);
-  g_object_unref (first);
+  char **columns = g_new (char *, n + 1);
 
-  for (int c = 0; c < cols; c++)
+  for (guint i = 0; i < n; i++)
     {
-      GtkListItemFactory *factory = gtk_signal_list_item_factory_new ();
+      SchemaRow *row = g_list_model_get_item (model, i);
 
-      g_signal_connect (factory, "setup", G_CALLBACK (label_setup), NULL);
+      columns[i] = g_strdup (schema_row_get_name (row));
+      g_object_unref (row);
+    }
 
-      g_signal_connect (factory, "bind", G_CALLBACK (data_bind), GINT_TO_POINTER (c));
+  columns[n] = NULL;
 
-      const char *col_name = NULL;
+  return columns;
+}
 
-      if (schema_store && g_list_model_get_n_items (G_LIST_MODEL (schema_store)) > (guint) c)
-        {
-          SchemaRow *schema_row = g_list_model_get_item (G_LIST_MODEL (schema_store), c);
+static void
+on_import_progress (guint64 rows, guint64 bytes, gpointer user_data)
+{
+  AppWidgets *app = user_data;
 
-          col_name = schema_row_get_name (schema_row);
-          g_object_unref (schema_row);
-        }
+  if (!app->transfer_cancellable)
+    return;
 
-      GtkColumnViewColumn *column = gtk_column_view_column_new (col_name, factory);
+  double seconds = (g_get_monotonic_time () - app->import_started) / (double) G_USEC_PER_SEC;
+  char *size = g_format_size (bytes);
+  char *text = g_strdup_printf ("Importing: %" G_GUINT64_FORMAT " rows, %s, %.0f rows/s", rows,
+                                size, seconds > 0 ? rows / seconds : 0);
 
-      gtk_column_view_append_column (view, column);
-    }
+  gtk_label_set_text (GTK_LABEL (app->transfer_label), text);
+  g_free (text);
+  g_free (size);
 }
 
 static void
-on_table_clicked (GtkWidget *button, gpointer user_data)
+on_import_ready (GObject *source, GAsyncResult *result, gpointer user_data)
 {
+  (void) source;
+
   AppWidgets *app = user_data;
+  GError *error = NULL;
+  guint64 rows = 0;
+  char *text;
+
+  gboolean ok = db_import_finish (result, &rows, &error);
+  double seconds = (g_get_monotonic_time () - app->import_started) / (double) G_USEC_PER_SEC;
+
+  g_clear_object (&app->transfer_cancellable);
+  set_running (app->transfer_spinner, app->transfer_cancel_btn, FALSE);
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    text = g_strdup ("Import cancelled, no rows were added");
+  else if (error)
+    text = g_strdup_printf ("Import failed, no rows were added: %s", g_strchomp (error->message));
+  else
+    text = g_strdup_printf ("Imported %" G_GUINT64_FORMAT " rows into %s in %.1f s (%.0f rows/s)",
+                            rows, app->import_table, seconds,
+                            seconds > 0 ? rows / seconds : 0);
+
+  gtk_label_set_text (GTK_LABEL (app->transfer_label), text);
+  g_free (text);
 
-  const char *table_name = gtk_button_get_label (GTK_BUTTON (button));
+  if (!is_cancelled (error))
+    report_error ("Import", error);
 
-  if (app->current_table && strcmp (table_name, app->current_table) == 0)
-    return;
+  /* Show the new rows if the table is still on screen */
+  if (ok)
+    db_clear_cache ();
 
-  g_list_store_remove_all (app->data_store);
-  clear_column_view (GTK_COLUMN_VIEW (app->data_view));
+  if (ok && app->browse_model && g_strcmp0 (app->current_table, app->import_table) == 0)
+    open_browse_model (app, FALSE);
+}
 
-  g_free (app->current_table);
-  app->current_table = g_strdup (table_name);
+static void
+on_import_file_chosen (GObject *source, GAsyncResult *result, gpointer user_data)
+{
+  AppWidgets *app = user_data;
+  GError *error = NULL;
 
-  GListStore *new_schema = db_fetch_schema (table_name);
+  GFile *file = gtk_file_dialog_open_finish (GTK_FILE_DIALOG (source), result, &error);
 
-  if (!new_schema)
-    return;
+  if (!file)
+    {
+      if (!g_error_matches (error, GTK_DIALOG_ERROR, GTK_DIALOG_ERROR_DISMISSED))
+        report_error ("Choosing import file", error);
+      else
+        g_error_free (error);
 
-  g_list_store_remove_all (app->schema_store);
+      return;
+    }
 
-  guint n = g_list_model_get_n_items (G_LIST_MODEL (new_schema));
+  const CatalogTable *table = catalog_lookup (app->catalog, app->import_table);
 
-  for (guint i = 0; i < n; i++)
+  /* Another transfer may have started, or the table changed, while the
+   * dialog was open */
+  if (app->transfer_cancellable || !table
+      || g_strcmp0 (app->current_table, app->import_table) != 0)
     {
-      gpointer item = g_list_model_get_item (G_LIST_MODEL (new_schema), i);
-
-      g_list_store_append (app->schema_store, item);
-      g_object_unref (item);
+      g_object_unref (file);
+      return;
     }
 
-  g_object_unref (new_schema);
+  char *path = g_file_get_path (file);
+  GCancellable *cancellable = restart_cancellable (&app->transfer_cancellable);
+  char **columns = get_schema_columns (app);
+
+  app->import_started = g_get_monotonic_time ();
+  gtk_label_set_text (GTK_LABEL (app->transfer_label), "Importing");
+  set_running (app->transfer_spinner, app->transfer_cancel_btn, TRUE);
+
+  db_import_table_async (table, (const char *const *) columns, path, on_import_progress, app,
+                         cancellable, on_import_ready, app);
+
+  g_strfreev (columns);
+  g_free (path);
+  g_object_unref (file);
 }
 
 static void
-populate_table_buttons (GtkWidget *left_box, AppWidgets *widgets)
+on_import_table_clicked (GtkWidget *button, gpointer user_data)
 {
-  GPtrArray *tables = db_fetch_table_names ();
-  if (!tables)
+  AppWidgets *app = user_data;
+
+  if (!app->current_table || app->transfer_cancellable)
     return;
 
-  for (guint i = 0; i < tables->len; i++)
-    {
-      const char *name = g_ptr_array_index (tables, i);
-      GtkWidget *btn = gtk_button_new_with_label (name);
+  g_free (app->import_table);
+  app->import_table = g_strdup (app->current_table);
 
-      g_signal_connect (btn, "clicked", G_CALLBACK (on_table_clicked), widgets);
-      gtk_box_append (GTK_BOX (left_box), btn);
-    }
+  GtkFileDialog *dialog = gtk_file_dialog_new ();
+
+  gtk_file_dialog_set_title (dialog, "Import CSV or TSV");
+  gtk_file_dialog_open (dialog, GTK_WINDOW (gtk_widget_get_root (button)), NULL,
+                        on_import_file_chosen, app);
 
-  g_ptr_array_free (tables, TRUE);
+  g_object_unref (dialog);
 }
 
 static void
-on_fetch_clicked (GtkWidget *button, gpointer user_data)
+on_transfer_cancel_clicked (GtkWidget *button, gpointer user_data)
 {
   (void) button;
 
   AppWidgets *app = user_data;
 
-  if (!app->current_table)
-    return;
+  /* The ready callback reports the cancellation */
+  if (app->transfer_cancellable)
+    g_cancellable_cancel (app->transfer_cancellable);
+}
+
+static GtkWidget *
+build_transfer_bar (AppWidgets *widgets)
+{
+  GtkWidget *bar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 8);
 
-  GListStore *new_data = db_fetch_top_100 (app->current_table);
+  widgets->transfer_spinner = gtk_spinner_new ();
+  widgets->transfer_label = gtk_label_new (NULL);
+  widgets->transfer_cancel_btn = gtk_button_new_with_label ("Cancel");
 
-  if (!new_data)
-    return;
+  g_signal_connect (widgets->transfer_cancel_btn, "clicked",
+                    G_CALLBACK (on_transfer_cancel_clicked), widgets);
 
-  g_list_store_remove_all (app->data_store);
-  clear_column_view (GTK_COLUMN_VIEW (app->data_view));
+  gtk_box_append (GTK_BOX (bar), widgets->transfer_spinner);
+  gtk_box_append (GTK_BOX (bar), widgets->transfer_label);
+  gtk_box_append (GTK_BOX (bar), widgets->transfer_cancel_btn);
 
-  append_data_columns (GTK_COLUMN_VIEW (app->data_view), new_data, app->data_store);
+  set_running (widgets->transfer_spinner, widgets->transfer_cancel_btn, FALSE);
 
-  guint rows = g_list_model_get_n_items (G_LIST_MODEL (new_data));
+  return bar;
+}
 
-  for (guint i = 0; i < rows; i++)
-    {
-      gpointer item = g_list_model_get_item (G_LIST_MODEL (new_data), i);
+static GtkWidget *
+build_run_bar (GtkWidget *run_btn, GtkWidget **spinner, GtkWidget **cancel_btn)
+{
+  GtkWidget *bar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 8);
 
-      g_list_store_append (app->data_store, item);
-      g_object_unref (item);
-    }
+  *spinner = gtk_spinner_new ();
+  *cancel_btn = gtk_button_new_with_label ("Cancel");
+
+  gtk_box_append (GTK_BOX (bar), run_btn);
+  gtk_box_append (GTK_BOX (bar), *spinner);
+  gtk_box_append (GTK_BOX (bar), *cancel_btn);
 
-  g_object_unref (new_data);
+  set_running (*spinner, *cancel_btn, FALSE);
+
+  return bar;
 }
 
 static void
-on_run_query_clicked (GtkWidget *button, gpointer user_data)
+build_cache_marker (GtkWidget *bar, GtkWidget **label, GtkWidget **reload_btn, GCallback reload,
+                    AppWidgets *widgets)
 {
-  (void) button;
+  *label = gtk_label_new (NULL);
+  *reload_btn = gtk_button_new_with_label ("Reload");
 
-  AppWidgets *app = user_data;
+  g_signal_connect (*reload_btn, "clicked", reload, widgets);
 
-  if (!app->sql_view)
-    return;
+  gtk_box_append (GTK_BOX (bar), *label);
+  gtk_box_append (GTK_BOX (bar), *reload_btn);
 
-  GtkTextBuffer *buffer = gtk_text_view_get_buffer (GTK_TEXT_VIEW (app->sql_view));
+  show_cache_marker (*label, *reload_btn, 0);
+}
 
-  if (!buffer)
-    return;
+/* Only the visible rows get widgets, so thousands of tables cost nothing
+ * to show */
+static GtkWidget *
+build_table_list (AppWidgets *widgets)
+{
+  widgets->table_search = gtk_search_entry_new ();
+  gtk_search_entry_set_placeholder_text (GTK_SEARCH_ENTRY (widgets->table_search),
+                                         "Find table");
 
-  GtkTextIter start, end;
-  gtk_text_buffer_get_start_iter (buffer, &start);
-  gtk_text_buffer_get_end_iter (buffer, &end);
+  g_signal_connect (widgets->table_search, "search-changed",
+                    G_CALLBACK (on_table_search_changed), widgets);
+  g_signal_connect (widgets->table_search, "activate", G_CALLBACK (on_table_search_activate),
+                    widgets);
 
-  char *text = gtk_text_buffer_get_text (buffer, &start, &end, FALSE);
+  GtkSingleSelection *selection =
+      gtk_single_selection_new (G_LIST_MODEL (widgets->table_list));
 
-  if (!text || text[0] == '\0')
-    {
-      g_free (text);
-      return;
-    }
+  gtk_single_selection_set_autoselect (selection, FALSE);
+  gtk_single_selection_set_can_unselect (selection, TRUE);
 
-  GListStore *new_data = db_run_query (text);
+  GtkWidget *view = gtk_column_view_new (GTK_SELECTION_MODEL (selection));
 
-  g_free (text);
+  gtk_column_view_set_single_click_activate (GTK_COLUMN_VIEW (view), TRUE);
+  g_signal_connect (view, "activate", G_CALLBACK (on_table_activated), widgets);
 
-  if (!new_data)
-    return;
+  const char *titles[] = { "Name", "Rows", "Size", "Vacuumed", "Analyzed" };
+  GCallback binds[] = { G_CALLBACK (table_name_bind), G_CALLBACK (table_rows_bind),
+                        G_CALLBACK (table_size_bind), G_CALLBACK (table_vacuumed_bind),
+                        G_CALLBACK (table_analyzed_bind) };
+  TableListSort sorts[] = { TABLE_LIST_SORT_NAME, TABLE_LIST_SORT_ROWS, TABLE_LIST_SORT_SIZE,
+                            TABLE_LIST_SORT_VACUUMED, TABLE_LIST_SORT_ANALYZED };
 
-  g_list_store_remove_all (app->query_store);
-  clear_column_view (GTK_COLUMN_VIEW (app->query_view));
+  for (int i = 0; i < 5; i++)
+    {
+      GtkListItemFactory *factory = gtk_signal_list_item_factory_new ();
 
-  append_data_columns (GTK_COLUMN_VIEW (app->query_view), new_data, app->query_store);
+      g_signal_connect (factory, "setup", i == 0 ? G_CALLBACK (label_setup)
+                                                 : G_CALLBACK (number_setup), NULL);
+      g_signal_connect (factory, "bind", binds[i], NULL);
 
-  guint rows = g_list_model_get_n_items (G_LIST_MODEL (new_data));
+      GtkColumnViewColumn *col = gtk_column_view_column_new (titles[i], factory);
+      /* Never called, the list does the sorting */
+      GtkCustomSorter *sorter = gtk_custom_sorter_new (NULL, NULL, NULL);
 
-  for (guint i = 0; i < rows; i++)
-    {
-      gpointer item = g_list_model_get_item (G_LIST_MODEL (new_data), i);
+      gtk_column_view_column_set_sorter (col, GTK_SORTER (sorter));
+      g_object_unref (sorter);
+      g_object_set_data (G_OBJECT (col), "table-list-sort", GINT_TO_POINTER (sorts[i]));
+      gtk_column_view_column_set_expand (col, i == 0);
 
-      g_list_store_append (app->query_store, item);
-      g_object_unref (item);
+      gtk_column_view_append_column (GTK_COLUMN_VIEW (view), col);
+      g_object_unref (col);
     }
 
-  g_object_unref (new_data);
+  g_signal_connect (gtk_column_view_get_sorter (GTK_COLUMN_VIEW (view)), "changed",
+                    G_CALLBACK (on_table_sort_changed), widgets);
+
+  GtkWidget *scroll = gtk_scrolled_window_new ();
+
+  gtk_widget_set_vexpand (scroll, TRUE);
+  gtk_scrolled_window_set_policy (GTK_SCROLLED_WINDOW (scroll), GTK_POLICY_AUTOMATIC,
+                                  GTK_POLICY_AUTOMATIC);
+  gtk_scrolled_window_set_min_content_width (GTK_SCROLLED_WINDOW (scroll), 320);
+  gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (scroll), view);
+
+  GtkWidget *box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
+
+  gtk_widget_set_vexpand (box, TRUE);
+  gtk_box_append (GTK_BOX (box), widgets->table_search);
+  gtk_box_append (GTK_BOX (box), scroll);
+
+  return box;
 }
 
 static GtkWidget *
@@ -306,14 +1970,19 @@ build_left_sidebar (AppWidgets *widgets)
 {
   GtkWidget *left_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
 
-  GtkWidget *left_top_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
+  GtkWidget *left_top_box = build_table_list (widgets);
 
   GtkWidget *left_bottom_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
 
+  GtkWidget *refresh_btn = gtk_button_new_with_label ("Refresh");
+
+  g_signal_connect (refresh_btn, "clicked", G_CALLBACK (on_refresh_clicked), widgets);
+
+  gtk_box_append (GTK_BOX (left_box), refresh_btn);
   gtk_box_append (GTK_BOX (left_box), left_top_box);
   gtk_box_append (GTK_BOX (left_box), left_bottom_box);
 
-  populate_table_buttons (left_top_box, widgets);
+  load_catalog (widgets);
 
   GtkSelectionModel *schema_sel =
       GTK_SELECTION_MODEL (gtk_single_selection_new (G_LIST_MODEL (widgets->schema_store)));
@@ -331,30 +2000,178 @@ build_left_sidebar (AppWidgets *widgets)
   return left_box;
 }
 
+/* Full value of an opened cell, below the grid and hidden until then */
+static GtkWidget *
+build_detail_pane (AppWidgets *widgets, GtkWidget *grid_scroll)
+{
+  widgets->detail_label = gtk_label_new (NULL);
+  gtk_label_set_xalign (GTK_LABEL (widgets->detail_label), 0);
+  gtk_label_set_ellipsize (GTK_LABEL (widgets->detail_label), PANGO_ELLIPSIZE_END);
+  gtk_widget_set_hexpand (widgets->detail_label, TRUE);
+
+  GtkWidget *close_btn = gtk_button_new_with_label ("Close");
+
+  g_signal_connect (close_btn, "clicked", G_CALLBACK (on_detail_close_clicked), widgets);
+
+  GtkWidget *header = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 8);
+
+  gtk_box_append (GTK_BOX (header), widgets->detail_label);
+  gtk_box_append (GTK_BOX (header), close_btn);
+
+  widgets->detail_view = gtk_text_view_new ();
+  gtk_text_view_set_editable (GTK_TEXT_VIEW (widgets->detail_view), FALSE);
+  gtk_text_view_set_monospace (GTK_TEXT_VIEW (widgets->detail_view), TRUE);
+  gtk_text_view_set_wrap_mode (GTK_TEXT_VIEW (widgets->detail_view), GTK_WRAP_CHAR);
+
+  GtkWidget *detail_scroll = gtk_scrolled_window_new ();
+
+  gtk_widget_set_vexpand (detail_scroll, TRUE);
+  gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (detail_scroll), widgets->detail_view);
+
+  widgets->detail_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
+
+  gtk_box_append (GTK_BOX (widgets->detail_box), header);
+  gtk_box_append (GTK_BOX (widgets->detail_box), detail_scroll);
+  gtk_widget_set_visible (widgets->detail_box, FALSE);
+
+  GtkWidget *paned = gtk_paned_new (GTK_ORIENTATION_VERTICAL);
+
+  gtk_widget_set_vexpand (paned, TRUE);
+  gtk_paned_set_start_child (GTK_PANED (paned), grid_scroll);
+  gtk_paned_set_end_child (GTK_PANED (paned), widgets->detail_box);
+
+  return paned;
+}
+
+/* Browsing a TABLESAMPLE of the table shows rows from all over it
+ * instead of only the physically first ones */
 static GtkWidget *
-build_top100_tab (AppWidgets *widgets)
+build_sample_bar (AppWidgets *widgets)
 {
-  GtkSelectionModel *data_sel =
-      GTK_SELECTION_MODEL (gtk_single_selection_new (G_LIST_MODEL (widgets->data_store)));
+  const char *methods[] = { "SYSTEM", "BERNOULLI", NULL };
+
+  widgets->sample_check = gtk_check_button_new_with_label ("Sample");
+  widgets->sample_method = gtk_drop_down_new_from_strings (methods);
+  widgets->sample_percent = gtk_spin_button_new_with_range (0.001, 100, 0.1);
+  widgets->sample_seed = gtk_spin_button_new_with_range (0, G_MAXINT32, 1);
+
+  gtk_widget_set_tooltip_text (widgets->sample_method,
+                               "SYSTEM reads only the sampled pages; BERNOULLI picks rows "
+                               "evenly but reads the whole table");
+  gtk_spin_button_set_digits (GTK_SPIN_BUTTON (widgets->sample_percent), 3);
+  gtk_spin_button_set_value (GTK_SPIN_BUTTON (widgets->sample_percent), 1);
+
+  g_signal_connect (widgets->sample_check, "notify::active", G_CALLBACK (on_sample_changed),
+                    widgets);
+  g_signal_connect (widgets->sample_method, "notify::selected", G_CALLBACK (on_sample_changed),
+                    widgets);
+  g_signal_connect (widgets->sample_percent, "notify::value", G_CALLBACK (on_sample_changed),
+                    widgets);
+  g_signal_connect (widgets->sample_seed, "notify::value", G_CALLBACK (on_sample_changed),
+                    widgets);
+
+  GtkWidget *bar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 8);
+
+  gtk_box_append (GTK_BOX (bar), widgets->sample_check);
+  gtk_box_append (GTK_BOX (bar), widgets->sample_method);
+  gtk_box_append (GTK_BOX (bar), widgets->sample_percent);
+  gtk_box_append (GTK_BOX (bar), gtk_label_new ("% with seed"));
+  gtk_box_append (GTK_BOX (bar), widgets->sample_seed);
+
+  return bar;
+}
 
-  widgets->data_view = gtk_column_view_new (data_sel);
+static GtkWidget *
+build_browse_tab (AppWidgets *widgets)
+{
+  widgets->data_view = data_grid_new ();
 
   gtk_widget_set_vexpand (widgets->data_view, TRUE);
 
+  g_signal_connect (widgets->data_view, "sort-changed", G_CALLBACK (on_data_sort_changed),
+                    widgets);
+  g_signal_connect (widgets->data_view, "cell-activated", G_CALLBACK (on_data_cell_activated),
+                    widgets);
+
   GtkWidget *scroll = gtk_scrolled_window_new ();
   gtk_widget_set_vexpand (scroll, TRUE);
 
   gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (scroll), widgets->data_view);
 
-  GtkWidget *box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 8);
+  g_signal_connect (gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (scroll)),
+                    "value-changed", G_CALLBACK (on_data_scrolled), widgets);
 
-  GtkWidget *fetch_btn = gtk_button_new_with_label ("Fetch Top 100");
+  GtkWidget *box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 8);
 
-  gtk_widget_set_halign (fetch_btn, GTK_ALIGN_START);
+  GtkWidget *fetch_btn = gtk_button_new_with_label ("Browse Table");
 
   g_signal_connect (fetch_btn, "clicked", G_CALLBACK (on_fetch_clicked), widgets);
 
-  gtk_box_append (GTK_BOX (box), fetch_btn);
+  GtkWidget *fetch_bar =
+      build_run_bar (fetch_btn, &widgets->fetch_spinner, &widgets->fetch_cancel_btn);
+
+  g_signal_connect (widgets->fetch_cancel_btn, "clicked", G_CALLBACK (on_fetch_cancel_clicked),
+                    widgets);
+
+  widgets->fetch_rows_label = gtk_label_new (NULL);
+  gtk_box_append (GTK_BOX (fetch_bar), widgets->fetch_rows_label);
+
+  build_cache_marker (fetch_bar, &widgets->fetch_cache_label, &widgets->fetch_reload_btn,
+                      G_CALLBACK (on_fetch_reload_clicked), widgets);
+
+  GtkWidget *export_btn = gtk_button_new_with_label ("Export Table");
+
+  g_signal_connect (export_btn, "clicked", G_CALLBACK (on_export_table_clicked), widgets);
+  gtk_box_append (GTK_BOX (fetch_bar), export_btn);
+
+  GtkWidget *import_btn = gtk_button_new_with_label ("Import CSV");
+
+  g_signal_connect (import_btn, "clicked", G_CALLBACK (on_import_table_clicked), widgets);
+  gtk_box_append (GTK_BOX (fetch_bar), import_btn);
+
+  gtk_box_append (GTK_BOX (box), fetch_bar);
+  gtk_box_append (GTK_BOX (box), build_sample_bar (widgets));
+  gtk_box_append (GTK_BOX (box), build_detail_pane (widgets, scroll));
+
+  return box;
+}
+
+/* Plan nodes as a tree, each with its own share of the cost */
+static GtkWidget *
+build_plan_view (AppWidgets *widgets)
+{
+  widgets->plan_view = gtk_column_view_new (NULL);
+  widgets->plan_summary = gtk_label_new (NULL);
+
+  gtk_label_set_xalign (GTK_LABEL (widgets->plan_summary), 0);
+
+  const char *titles[] = { "Node", "Self", "Total", "Rows (actual / est.)",
+                           "Estimate", "Hit", "Read", "Self change" };
+
+  for (int i = 0; i < N_PLAN_COLUMNS; i++)
+    {
+      GtkListItemFactory *factory = gtk_signal_list_item_factory_new ();
+
+      g_signal_connect (factory, "setup", i == PLAN_COLUMN_NODE ? G_CALLBACK (plan_node_setup)
+                                                                : G_CALLBACK (number_setup),
+                        NULL);
+      g_signal_connect (factory, "bind", G_CALLBACK (plan_cell_bind), GINT_TO_POINTER (i));
+
+      GtkColumnViewColumn *col = gtk_column_view_column_new (titles[i], factory);
+
+      gtk_column_view_column_set_expand (col, i == PLAN_COLUMN_NODE);
+      gtk_column_view_append_column (GTK_COLUMN_VIEW (widgets->plan_view), col);
+      g_object_unref (col);
+    }
+
+  GtkWidget *scroll = gtk_scrolled_window_new ();
+
+  gtk_widget_set_vexpand (scroll, TRUE);
+  gtk_scrolled_window_set_child (GTK_SCROLLED_WINDOW (scroll), widgets->plan_view);
+
+  GtkWidget *box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 4);
+
+  gtk_box_append (GTK_BOX (box), widgets->plan_summary);
   gtk_box_append (GTK_BOX (box), scroll);
 
   return box;
@@ -363,13 +2180,13 @@ build_top100_tab (AppWidgets *widgets)
 static GtkWidget *
 build_query_tab (AppWidgets *widgets)
 {
-  GtkSelectionModel *query_sel =
-      GTK_SELECTION_MODEL (gtk_single_selection_new (G_LIST_MODEL (widgets->query_store)));
-
-  widgets->query_view = gtk_column_view_new (query_sel);
+  widgets->query_view = data_grid_new ();
 
   gtk_widget_set_vexpand (widgets->query_view, TRUE);
 
+  g_signal_connect (widgets->query_view, "sort-changed", G_CALLBACK (on_query_sort_changed),
+                    widgets);
+
   /* SQL editor */
   widgets->sql_view = gtk_text_view_new ();
   gtk_text_view_set_monospace (GTK_TEXT_VIEW (widgets->sql_view), TRUE);
@@ -387,14 +2204,52 @@ build_query_tab (AppWidgets *widgets)
 
   GtkWidget *run_btn = gtk_button_new_with_label ("Run Query");
 
-  gtk_widget_set_halign (run_btn, GTK_ALIGN_START);
-
   g_signal_connect (run_btn, "clicked", G_CALLBACK (on_run_query_clicked), widgets);
 
+  GtkWidget *run_bar =
+      build_run_bar (run_btn, &widgets->query_spinner, &widgets->query_cancel_btn);
+
+  g_signal_connect (widgets->query_cancel_btn, "clicked", G_CALLBACK (on_query_cancel_clicked),
+                    widgets);
+
+  GtkWidget *explain_btn = gtk_button_new_with_label ("Explain");
+
+  g_signal_connect (explain_btn, "clicked", G_CALLBACK (on_explain_clicked), widgets);
+  gtk_box_insert_child_after (GTK_BOX (run_bar), explain_btn, run_btn);
+
+  GtkWidget *export_btn = gtk_button_new_with_label ("Export Query");
+
+  g_signal_connect (export_btn, "clicked", G_CALLBACK (on_export_query_clicked), widgets);
+  gtk_box_append (GTK_BOX (run_bar), export_btn);
+
+  build_cache_marker (run_bar, &widgets->query_cache_label, &widgets->query_reload_btn,
+                      G_CALLBACK (on_query_reload_clicked), widgets);
+
+  /* Filter over the loaded rows */
+  widgets->query_filter_entry = gtk_search_entry_new ();
+  gtk_widget_set_hexpand (widgets->query_filter_entry, TRUE);
+
+  g_signal_connect (widgets->query_filter_entry, "search-changed",
+                    G_CALLBACK (on_query_filter_changed), widgets);
+
+  widgets->query_filter_label = gtk_label_new (NULL);
+
+  GtkWidget *filter_bar = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 8);
+
+  gtk_box_append (GTK_BOX (filter_bar), widgets->query_filter_entry);
+  gtk_box_append (GTK_BOX (filter_bar), widgets->query_filter_label);
+
   GtkWidget *bottom_box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 8);
 
-  gtk_box_append (GTK_BOX (bottom_box), run_btn);
-  gtk_box_append (GTK_BOX (bottom_box), results_scroll);
+  gtk_box_append (GTK_BOX (bottom_box), run_bar);
+  gtk_box_append (GTK_BOX (bottom_box), filter_bar);
+  /* Results and plans take turns below the editor */
+  widgets->query_stack = gtk_stack_new ();
+
+  gtk_stack_add_named (GTK_STACK (widgets->query_stack), results_scroll, "results");
+  gtk_stack_add_named (GTK_STACK (widgets->query_stack), build_plan_view (widgets), "plan");
+
+  gtk_box_append (GTK_BOX (bottom_box), widgets->query_stack);
 
   GtkWidget *paned = gtk_paned_new (GTK_ORIENTATION_VERTICAL);
 
@@ -420,8 +2275,7 @@ ui_activate (GtkApplication *app, gpointer user_data)
   AppWidgets *widgets = g_new0 (AppWidgets, 1);
 
   widgets->schema_store = g_list_store_new (TYPE_SCHEMA_ROW);
-  widgets->data_store = g_list_store_new (TYPE_GENERIC_ROW);
-  widgets->query_store = g_list_store_new (TYPE_GENERIC_ROW);
+  widgets->table_list = table_list_new ();
 
   GtkWidget *main_box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 8);
 
@@ -435,14 +2289,20 @@ ui_activate (GtkApplication *app, gpointer user_data)
   /* Notebook */
   GtkWidget *notebook = gtk_notebook_new ();
 
-  gtk_notebook_append_page (GTK_NOTEBOOK (notebook), build_top100_tab (widgets),
-                            gtk_label_new ("Top 100"));
+  gtk_notebook_append_page (GTK_NOTEBOOK (notebook), build_browse_tab (widgets),
+                            gtk_label_new ("Browse"));
 
   gtk_notebook_append_page (GTK_NOTEBOOK (notebook), build_query_tab (widgets),
                             gtk_label_new ("Query Results"));
+  g_signal_connect (notebook, "switch-page", G_CALLBACK (on_notebook_switch_page), widgets);
 
   gtk_box_append (GTK_BOX (right), notebook);
 
+  widgets->status_label = gtk_label_new (NULL);
+  gtk_label_set_xalign (GTK_LABEL (widgets->status_label), 0);
+  gtk_box_append (GTK_BOX (right), widgets->status_label);
+  gtk_box_append (GTK_BOX (right), build_transfer_bar (widgets));
+
   gtk_box_append (GTK_BOX (main_box), left);
   gtk_box_append (GTK_BOX (main_box), right);
 
@@ -0,0 +1,100 @@
+#include "work_pool.h"
+
+typedef struct
+{
+  WorkFunc func;
+  gpointer user_data;
+
+  GMutex lock;
+  GCond done;
+  guint pending;
+} WorkBatch;
+
+typedef struct
+{
+  WorkBatch *batch;
+  guint index;
+} WorkItem;
+
+static void
+work_item_run (gpointer data, gpointer user_data)
+{
+  (void) user_data;
+
+  WorkItem *item = data;
+  WorkBatch *batch = item->batch;
+
+  batch->func (item->index, batch->user_data);
+  g_free (item);
+
+  g_mutex_lock (&batch->lock);
+
+  if (--batch->pending == 0)
+    g_cond_signal (&batch->done);
+
+  g_mutex_unlock (&batch->lock);
+}
+
+static GThreadPool *
+work_pool_get (void)
+{
+  static GThreadPool *pool;
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *new_pool =
+          g_thread_pool_new (work_item_run, NULL, work_pool_get_n_threads (), FALSE, NULL);
+
+      g_once_init_leave (&pool, new_pool);
+    }
+
+  return pool;
+}
+
+guint
+work_pool_get_n_threads (void)
+{
+  return g_get_num_processors ();
+}
+
+void
+work_pool_run (guint n, WorkFunc func, gpointer user_data)
+{
+  /* Not worth a handoff */
+  if (n <= 1)
+    {
+      if (n == 1)
+        func (0, user_data);
+
+      return;
+    }
+
+  WorkBatch batch;
+
+  batch.func = func;
+  batch.user_data = user_data;
+  batch.pending = n;
+
+  g_mutex_init (&batch.lock);
+  g_cond_init (&batch.done);
+
+  for (guint i = 0; i < n; i++)
+    {
+      WorkItem *item = g_new (WorkItem, 1);
+
+      item->batch = &batch;
+      item->index = i;
+
+      g_thread_pool_push (work_pool_get (), item, NULL);
+    }
+
+  g_mutex_lock (&batch.lock);
+
+  while (batch.pending > 0)
+    g_cond_wait (&batch.done, &batch.lock);
+
+  g_mutex_unlock (&batch.lock);
+
+  g_mutex_clear (&batch.lock);
+  g_cond_clear (&batch.done);
+}
\ No newline at end of file
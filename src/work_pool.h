@@ -0,0 +1,14 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <glib.h>
+
+/* Runs func (index, user_data) for every index below n on a shared pool
+ * of one thread per core and returns once all calls are done. It blocks,
+ * so call it from a GTask thread and never from the main loop. */
+typedef void (*WorkFunc) (guint index, gpointer user_data);
+
+guint work_pool_get_n_threads (void);
+void work_pool_run (guint n, WorkFunc func, gpointer user_data);
+
+#endif
\ No newline at end of file